@@ -64,7 +64,7 @@ if args.log == 'mine':
                     throughput = float(throughput)
                     throughputs[block_size] = throughput
 
-            m = re.compile(r'^SHA1 sum: count = (\d+), length = (\d+), digest = (\w+).$').match(line)
+            m = re.compile(r'^(?:SHA1 sum|\w+ digest): count = (\d+), length = (\d+), digest = (\w+)').match(line)
             if m:
                 (count, length, digest) = m.groups()
                 length = int(length)
@@ -77,7 +77,7 @@ if args.log == 'mine':
             if m:
                 block_size = int(m.group(1))
                 continue
-            m = re.compile(r'^SHA1 sum: count = (\d+), length = (\d+), digest = (\w+).$').match(line)
+            m = re.compile(r'^(?:SHA1 sum|\w+ digest): count = (\d+), length = (\d+), digest = (\w+)').match(line)
             if m:
                 (count, length, digest) = m.groups()
                 length = int(length)
@@ -0,0 +1,21 @@
+#!/usr/bin/env bash
+
+if [[ $# -gt 2 ]]; then
+    echo "$0 [<server ip>]"
+fi
+
+source ./config
+
+# <tos>:<length>:<count>:<mode> per class; latency traffic on TOS 4 as in
+# the Opera scripts, bulk traffic on the default class.
+classes="4:64:100000:latency,0:1048576:1000:throughput"
+verb="write"
+repeat=1
+
+server="$1"
+execpath=$RDMA_BENCH_EXECPATH
+execflags=""
+execflags+="-v $verb -r $repeat --classes=$classes "
+
+set -x
+$execpath $execflags $server
@@ -0,0 +1,25 @@
+#!/usr/bin/env bash
+
+if [[ $# -gt 1 ]]; then
+    echo "$0 [<rank count>]"
+fi
+
+source ./config
+
+# All ranks on this host, over shared memory
+np=${1:-8}
+collectives="alltoall,allreduce,bcast"
+length=$((1024*1024))
+count=1000
+warmup=100
+
+execpath=$MPI_BENCH_EXECPATH
+execflags=""
+execflags+="-b $length -c $count -w $warmup --collective=$collectives "
+
+FLAGS=""
+FLAGS+="--allow-run-as-root --oversubscribe "
+FLAGS+="-mca pml ob1 --mca btl self,vader "
+
+set -x
+mpirun -np $np $FLAGS $execpath $execflags
@@ -6,8 +6,9 @@ fi
 
 source ./config
 
-count=8
-length=6
+count=1
+peers=8
+length=64
 mode="latency"
 verb="write"
 repeat=1000000
@@ -20,7 +21,7 @@ server="$1"
 execpath=$CONTROL_SIGNAL_EXECPATH
 execflags=""
 execflags+="-b $length -c $count -v $verb -m $mode -r $repeat -i $index "
-execflags+="-w $warmup --mr_count=$mr_count --tos=$tos "
+execflags+="-w $warmup --mr_count=$mr_count --tos=$tos --peers=$peers "
 execflags+="--verbose "
 
 set -x
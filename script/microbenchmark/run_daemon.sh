@@ -0,0 +1,28 @@
+#!/usr/bin/env bash
+
+if [[ $# -lt 1 || $# -gt 2 ]]; then
+    echo "$0 verbs|mpi [<server ip>]"
+    exit 2
+fi
+
+source ./config
+
+# One transport daemon per host; applications attach to the shared memory
+# segment it names. With verbs, start the server daemon without a server
+# argument first; with mpi, mpirun starts both, rank 0 being the server.
+# Stop the daemons with SIGINT or SIGTERM to get their report.
+backend="$1"
+server="$2"
+length=65536
+shm=/dccs_transport
+
+execpath=$TRANSPORT_DAEMON_EXECPATH
+execflags=""
+execflags+="--backend=$backend -b $length --shm=$shm "
+
+set -x
+if [[ $backend = mpi ]]; then
+    mpirun -np 2 --host $server,localhost $execpath $execflags
+else
+    $execpath $execflags $server
+fi
@@ -0,0 +1,32 @@
+#!/usr/bin/env bash
+
+if [[ $# -lt 1 || $# -gt 2 ]]; then
+    echo "$0 verbs|daemon [<server ip>]"
+    exit 2
+fi
+
+source ./config
+
+# Compares Send over raw verbs (rdma_exec) with libdccs on the same hosts,
+# for every mode and length. Run without a server on the server host first.
+# With the daemon backend, start run_daemon.sh on both hosts beforehand,
+# with a block size of at least the longest length here.
+backend="$1"
+server="$2"
+count=10000
+repeat=3
+window=128
+lengths="64 1024 4096 65536"
+
+for mode in latency throughput; do
+    for length in $lengths; do
+        echo "Mode = $mode, length = $length ..."
+        set -x
+        $RDMA_BENCH_EXECPATH -v send -m $mode -b $length -c $count -r $repeat $server
+        sleep 1
+        $LIBDCCS_BENCH_EXECPATH --backend=$backend -m $mode -b $length -c $count -r $repeat --window=$window $server
+        set +x
+        sleep 1
+        echo ""
+    done
+done
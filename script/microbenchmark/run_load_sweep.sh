@@ -0,0 +1,26 @@
+#!/usr/bin/env bash
+
+if [[ $# -gt 2 ]]; then
+    echo "$0 [<server ip>]"
+fi
+
+source ./config
+
+count=100000
+length=4096
+verb="write"
+mode="open"
+arrival="poisson"
+load="1,2,5,10,20,40,60,80,90"
+repeat=1
+mr_count=1
+tos=32
+
+server="$1"
+execpath=$RDMA_BENCH_EXECPATH
+execflags=""
+execflags+="-b $length -c $count -v $verb -m $mode -r $repeat --mr_count=$mr_count --tos=$tos "
+execflags+="--arrival=$arrival --load=$load "
+
+set -x
+$execpath $execflags $server
@@ -0,0 +1,38 @@
+#!/usr/bin/env bash
+
+if [[ $# -gt 1 ]]; then
+    echo "$0 [<server ip>]"
+    exit 2
+fi
+
+source ./config
+
+# Compares the RDMA WRITE byte stream with SENDs into posted receives, for
+# every mode and length. Run without a server on the server host first; each
+# run serves one connection, and the client waits for the server to restart.
+server="$1"
+count=10000
+repeat=3
+window=128
+l=8
+limit=$((1024*1024))
+
+execpath=$STREAM_BENCH_EXECPATH
+
+set -x
+for mode in latency throughput; do
+    l=8
+    while [[ $l -le $limit ]]; do
+        for verb in send write; do
+            echo "Mode = $mode, verb = $verb, length = $l ..."
+            [[ -n $server ]] && sleep 1
+            if [[ $verb = write ]]; then
+                $execpath -v write -m $mode -b $l -c $count -r $repeat $server
+            else
+                $execpath -m $mode -b $l -c $count -r $repeat --window=$window $server
+            fi
+            echo ""
+        done
+        (( l *= 4 ))
+    done
+done
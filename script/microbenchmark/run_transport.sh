@@ -0,0 +1,30 @@
+#!/usr/bin/env bash
+
+if [[ $# -lt 1 || $# -gt 2 ]]; then
+    echo "$0 verbs|mpi [<server ip>]"
+    exit 2
+fi
+
+source ./config
+
+# Same workload over either backend. With verbs, run once without a server
+# (the server) and once with it (the client); with mpi, mpirun starts both,
+# rank 0 being the server.
+backend="$1"
+server="$2"
+mode="throughput"
+length=4096
+count=100000
+window=128
+repeat=3
+
+execpath=$TRANSPORT_BENCH_EXECPATH
+execflags=""
+execflags+="--backend=$backend -m $mode -b $length -c $count --window=$window -r $repeat "
+
+set -x
+if [[ $backend = mpi ]]; then
+    mpirun -np 2 --host $server,localhost $execpath $execflags
+else
+    $execpath $execflags $server
+fi
@@ -1,13 +1,18 @@
 // Control signal testing program
 // Server is the control host, client(s) is/are the end hosts to be synchronized.
 // Both sides use RDMA writes and busy looping to check receipt of data.
+// The server holds a connection to each of --peers clients and fans every
+// signal out to all of them; clients poll their mailbox, timestamp each
+// signal and acknowledge it with a write back into the server's mailbox.
+// The server estimates each client's clock offset at setup and keeps
+// refining it from signal/ack round trips, so that client timestamps can be
+// reported in the server's time base.
 
 
 #define _GNU_SOURCE
 
 #define MAGIC 0xd1cefa11
 #define SIGNAL_INTERVAL 1000
-#define SLOT_NS 100000
 
 #include <assert.h>
 #include <stdio.h>
@@ -15,102 +20,326 @@
 #include "dccs_parameters.h"
 #include "dccs_utils.h"
 #include "dccs_rdma.h"
+#include "dccs_pacer.h"
+#include "dccs_clock.h"
+#include "dccs_digest.h"
 
 uint64_t clock_rate = 0;    // Clock ticks per second
 
-inline static void wait_until(uint64_t target) {
-    while (get_cycles() < target);
+/**
+ * Signal and acknowledgement, written into a cache-line mailbox.
+ * Sequence numbers start at 1 so an empty mailbox never matches, and the
+ * canary repeats the sequence number in the last word: the NIC writes in
+ * ascending address order, so a canary matching the header means the whole
+ * message has landed.
+ */
+struct control_signal {
+    uint32_t magic;
+    uint16_t index;         // Index of the writer
+    uint16_t reserved;
+    uint32_t seq;
+    uint32_t reserved2;
+    uint64_t timestamp;     // Ack: arrival time of the signal at the receiver
+    uint32_t canary;
+} __attribute__((packed));
+
+#define CONTROL_MAILBOX_LENGTH CACHE_LINE_SIZE
+
+/**
+ * Whether a complete message with the given sequence number is in the mailbox.
+ */
+static inline bool mailbox_holds(volatile struct control_signal *mailbox, uint32_t seq) {
+    uint32_t canary = mailbox->canary;
+    return canary == htonl(seq) && mailbox->seq == canary && mailbox->magic == htonl(MAGIC);
 }
 
-int run(struct dccs_parameters params) {
-    struct rdma_cm_id *listen_id = NULL, *id;
-    struct ibv_wc *wc = NULL;
-    struct dccs_request *requests_out, *requests_in;
-    uint64_t *start = NULL, *end = NULL;
-    int rv = 0;
-
-    Role role = params.server == NULL ? ROLE_SERVER : ROLE_CLIENT;
-    if (role == ROLE_CLIENT)
-        log_info("Running in client mode ...\n");
-    else
-        log_info("Running in server mode ...\n");
-
-    assert(params.count == 1);
-    assert(params.length == 6);
-    assert(params.verb == Write);
-
-    if (role == ROLE_CLIENT) {
-        if ((rv = dccs_connect(&id, params.server, params.port, params.tos)) != 0)
-            goto end;
-    } else {    // role == ROLE_SERVER
-        if ((rv = dccs_listen(&listen_id, &id, params.port)) != 0)
-            goto end;
-    }
+/**
+ * One end of a control connection: the server has one per client.
+ */
+struct control_peer {
+    struct rdma_cm_id *id;
+    struct dccs_request *requests_in;
+    struct dccs_request *requests_out;
+
+    // Signal write, built once and reposted every slot
+    struct ibv_sge sge;
+    struct ibv_send_wr wr;
+
+    uint64_t *arrivals;     // Arrival time of every signal, on the receiver's clock
+    uint64_t *acks;         // Server: when the ack of every signal was seen
+    struct dccs_clock clock;    // Server: receiver's clock relative to ours
+    size_t posted;          // Writes posted, to signal one in SIGNAL_INTERVAL
+};
+
+/**
+ * Allocate the signal buffers of a connection, exchange them, and build the
+ * write that carries a signal to the other end.
+ */
+int setup_peer(struct control_peer *peer, struct dccs_parameters params, Role role) {
+    struct rdma_cm_id *id = peer->id;
+    int rv;
 
     log_debug("Allocating buffer ...\n");
-    requests_in = calloc(params.count, sizeof(struct dccs_request));
-    if ((rv = allocate_buffer(id, requests_in, params)) != 0) {
+    peer->requests_in = calloc(params.count, sizeof(struct dccs_request));
+    if ((rv = allocate_buffer(id, peer->requests_in, params)) != 0) {
         log_error("Failed to allocate buffers.\n");
-        goto out_disconnect;
+        return rv;
     }
-    requests_out = calloc(params.count, sizeof(struct dccs_request));
-    if ((rv = allocate_buffer(id, requests_out, params)) != 0) {
+    peer->requests_out = calloc(params.count, sizeof(struct dccs_request));
+    if ((rv = allocate_buffer(id, peer->requests_out, params)) != 0) {
         log_error("Failed to allocate buffers.\n");
-        goto out_disconnect;
+        return rv;
     }
-    wc = calloc(params.count, sizeof(struct ibv_wc));
 
-    uint32_t magic = htonl(MAGIC);
-    uint16_t ts_index = htons(params.index);
     for (size_t n = 0; n < params.count; n++) {
-        struct dccs_request *request = requests_out + n;
-        if (role == ROLE_CLIENT) {
-            memcpy(request->buf, &magic, sizeof magic);
-            memcpy((char *)request->buf + sizeof magic, &ts_index, sizeof ts_index);
-        } else {    // Same for now
-            memcpy(request->buf, &magic, sizeof magic);
-            memcpy((char *)request->buf + sizeof magic, &ts_index, sizeof ts_index);
-        }
+        memset(peer->requests_in[n].buf, 0, params.length);
+        memset(peer->requests_out[n].buf, 0, params.length);
+
+        struct control_signal *signal = peer->requests_out[n].buf;
+        signal->magic = htonl(MAGIC);
+        signal->index = htons(params.index);
     }
 
     if (role == ROLE_SERVER) {
         log_debug("Getting remote MR info ...\n");
-        rv = get_remote_mr_info(id, requests_out, params.count);
+        rv = get_remote_mr_info(id, peer->requests_out, params.count);
         if (rv < 0) {
             log_debug("rv = %d.\n", rv);
             log_error("Failed to get remote MR info.\n");
-            goto out_deallocate_buffer;
+            return rv;
         }
 
         log_debug("Sending local MR info ...\n");
-        rv = send_local_mr_info(id, requests_in, params.count);
+        rv = send_local_mr_info(id, peer->requests_in, params.count);
         if (rv < 0) {
             log_error("Failed to send remote MR info.\n");
-            goto out_deallocate_buffer;
+            return rv;
         }
     } else {    // role == ROLE_CLIENT
         log_debug("Sending local MR info ...\n");
-        rv = send_local_mr_info(id, requests_in, params.count);
+        rv = send_local_mr_info(id, peer->requests_in, params.count);
         if (rv < 0) {
             log_error("Failed to send remote MR info.\n");
-            goto out_deallocate_buffer;
+            return rv;
         }
 
         log_debug("Getting remote MR info ...\n");
-        rv = get_remote_mr_info(id, requests_out, params.count);
+        rv = get_remote_mr_info(id, peer->requests_out, params.count);
         if (rv < 0) {
             log_debug("rv = %d.\n", rv);
             log_error("Failed to get remote MR info.\n");
-            goto out_deallocate_buffer;
+            return rv;
         }
     }
 
     for (size_t n = 0; n < params.count; n++) {
-        struct dccs_request *request = requests_out + n;
+        struct dccs_request *request = peer->requests_out + n;
         log_debug("out: remote addr = %#10x, in: addr = %#10x\n",
                 request->remote_addr, request->buf);
     }
 
+    struct dccs_request *request_out = peer->requests_out;
+    peer->sge.addr = (uint64_t)(uintptr_t)request_out->buf;
+    peer->sge.length = sizeof(struct control_signal);
+    peer->sge.lkey = request_out->mr->lkey;
+    memset(&peer->wr, 0, sizeof peer->wr);
+    peer->wr.sg_list = &peer->sge;
+    peer->wr.num_sge = 1;
+    peer->wr.opcode = IBV_WR_RDMA_WRITE;
+    peer->wr.wr.rdma.remote_addr = request_out->remote_addr;
+    peer->wr.wr.rdma.rkey = request_out->remote_rkey;
+
+    peer->arrivals = calloc(params.repeat, sizeof(uint64_t));
+    peer->acks = calloc(params.repeat, sizeof(uint64_t));
+    return 0;
+}
+
+/**
+ * Write a signal or an ack with the given sequence number to the other end.
+ * Only one write in SIGNAL_INTERVAL is signaled, and its completion is
+ * reaped right away, which keeps the send queue from filling up.
+ */
+int post_signal(struct control_peer *peer, uint32_t seq, uint64_t timestamp) {
+    struct control_signal *signal = peer->requests_out->buf;
+    struct ibv_send_wr *bad_wr;
+    struct ibv_wc wc;
+    bool signaled = ++peer->posted % SIGNAL_INTERVAL == 0;
+    int rv;
+
+    signal->seq = signal->canary = htonl(seq);
+    signal->timestamp = htonll(timestamp);
+    peer->wr.send_flags = signaled ? IBV_SEND_SIGNALED : 0;
+    if ((rv = ibv_post_send(peer->id->qp, &peer->wr, &bad_wr)) != 0) {
+        log_error("Failed to send write, error = %d.\n", rv);
+        return rv;
+    }
+
+    if (signaled) {
+        while ((rv = dccs_rdma_send_comp(peer->id, 1, &wc)) == 0);
+        if (rv < 0) {
+            log_error("Failed to send comp message.\n");
+            return rv;
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * Print, per receiver, how many signals arrived and were acknowledged in
+ * time, the one-way time in each direction, and the round trip until the
+ * ack was seen. Arrival times must already be in the server's time base.
+ */
+void print_control_delivery_report(struct control_peer *peers, size_t peer_count, uint64_t *start, size_t repeat) {
+    double *one_way = malloc(repeat * sizeof(double));
+    double *reverse = malloc(repeat * sizeof(double));
+    double *rtt = malloc(repeat * sizeof(double));
+
+    log_info("=====================\n");
+    log_info("Control Delivery Report\n");
+    log_info("receiver, delivered, lost, late acks, forward median (µsec), forward percent99 (µsec), "
+             "reverse median (µsec), reverse percent99 (µsec), ack median (µsec), ack percent99 (µsec)\n");
+    for (size_t i = 0; i < peer_count; i++) {
+        struct control_peer *peer = peers + i;
+        size_t delivered = 0, acked = 0;
+        for (size_t n = 0; n < repeat; n++) {
+            if (peer->arrivals[n] != 0)
+                one_way[delivered++] = (double)(int64_t)(peer->arrivals[n] - start[n]) * MILLION / (double)clock_rate;
+            if (peer->acks[n] != 0) {
+                reverse[acked] = (double)(int64_t)(peer->acks[n] - peer->arrivals[n]) * MILLION / (double)clock_rate;
+                rtt[acked++] = (double)(peer->acks[n] - start[n]) * MILLION / (double)clock_rate;
+            }
+        }
+
+        sort_latencies(one_way, delivered);
+        sort_latencies(reverse, acked);
+        sort_latencies(rtt, acked);
+        log_info("%zu, %zu, %zu, %zu, %.3f, %.3f, %.3f, %.3f, %.3f, %.3f\n", i, delivered, repeat - delivered, delivered - acked,
+                 delivered > 0 ? one_way[delivered / 2] : 0, delivered > 0 ? one_way[(size_t)((double)delivered * 0.99)] : 0,
+                 acked > 0 ? reverse[acked / 2] : 0, acked > 0 ? reverse[(size_t)((double)acked * 0.99)] : 0,
+                 acked > 0 ? rtt[acked / 2] : 0, acked > 0 ? rtt[(size_t)((double)acked * 0.99)] : 0);
+    }
+    log_info("=====================\n\n");
+
+    free(one_way);
+    free(reverse);
+    free(rtt);
+}
+
+/**
+ * Print the clock offset and drift of every receiver, as estimated at the
+ * end of the run; over loopback both should be close to 0.
+ */
+void print_clock_report(struct control_peer *peers, size_t peer_count) {
+    log_info("=====================\n");
+    log_info("Clock Offset Report\n");
+    log_info("receiver, samples, offset (µsec), drift (ppm), min rtt (µsec)\n");
+    for (size_t i = 0; i < peer_count; i++) {
+        struct dccs_clock *c = &peers[i].clock;
+        log_info("%zu, %zu, %.3f, %.3f, %.3f\n", i, c->samples, c->offset * MILLION / (double)clock_rate,
+                 c->drift * MILLION, c->rtt * MILLION / (double)clock_rate);
+    }
+    log_info("=====================\n\n");
+}
+
+/**
+ * Print, per signal, the spread between the first and the last receiver,
+ * with arrival times in the server's time base.
+ */
+void print_skew_report(struct control_peer *peers, size_t peer_count, size_t repeat) {
+    double *values = malloc(repeat * sizeof(double));
+    size_t length = 0;
+
+    // Only signals that reached every receiver
+    for (size_t n = 0; n < repeat; n++) {
+        uint64_t first = UINT64_MAX, last = 0;
+        for (size_t i = 0; i < peer_count; i++) {
+            uint64_t arrival = peers[i].arrivals[n];
+            if (arrival < first)
+                first = arrival;
+            if (arrival > last)
+                last = arrival;
+        }
+        if (first != 0)
+            values[length++] = (double)(last - first) * MILLION / (double)clock_rate;
+    }
+
+    if (length == 0) {
+        log_warning("No signal reached every receiver.\n");
+        free(values);
+        return;
+    }
+
+    sort_latencies(values, length);
+
+    log_info("=====================\n");
+    log_info("Receiver Skew Report\n");
+    log_info("receivers, signals, median (µsec), percent90 (µsec), percent99 (µsec), max (µsec)\n");
+    log_info("%zu, %zu, %.3f, %.3f, %.3f, %.3f\n", peer_count, length, values[length / 2],
+             values[(size_t)((double)length * 0.9)], values[(size_t)((double)length * 0.99)], values[length - 1]);
+    log_info("=====================\n\n");
+
+    free(values);
+}
+
+int run(struct dccs_parameters params) {
+    struct rdma_cm_id *listen_id = NULL;
+    struct control_peer *peers;
+    struct dccs_pacer pacer = {0};
+    uint64_t *start = NULL, *end = NULL;
+    size_t peer_count, connected = 0;
+    int rv = 0;
+
+    Role role = params.server == NULL ? ROLE_SERVER : ROLE_CLIENT;
+    if (role == ROLE_CLIENT)
+        log_info("Running in client mode ...\n");
+    else
+        log_info("Running in server mode ...\n");
+
+    assert(params.count == 1);
+    assert(params.verb == Write);
+    if (params.length != CONTROL_MAILBOX_LENGTH) {
+        log_warning("Signals use %d-byte mailboxes, ignoring block size %zu.\n",
+                    CONTROL_MAILBOX_LENGTH, params.length);
+        params.length = CONTROL_MAILBOX_LENGTH;
+    }
+
+    // A client only talks to the server; the server signals every client.
+    peer_count = role == ROLE_SERVER ? params.peers : 1;
+    peers = calloc(peer_count, sizeof(struct control_peer));
+
+    if (role == ROLE_CLIENT) {
+        if ((rv = dccs_connect(&peers[0].id, params.server, params.port, params.tos, 1)) != 0)
+            goto end;
+        connected = 1;
+    } else {    // role == ROLE_SERVER
+        if ((rv = dccs_listen(&listen_id, &peers[0].id, params.port, 1)) != 0)
+            goto end;
+        for (connected = 1; connected < peer_count; connected++) {
+            if ((rv = dccs_accept(listen_id, &peers[connected].id)) != 0)
+                goto out_disconnect;
+        }
+
+        log_info("Accepted %zu client(s).\n", peer_count);
+    }
+
+    for (size_t i = 0; i < peer_count; i++) {
+        if ((rv = setup_peer(peers + i, params, role)) != 0)
+            goto out_deallocate_buffer;
+    }
+
+    // Initial clock offsets; the server's clock is the reference.
+    for (size_t i = 0; i < peer_count; i++) {
+        if (role == ROLE_SERVER) {
+            dccs_clock_init(&peers[i].clock, CLOCK_SYNC_SAMPLES);
+            rv = dccs_clock_sync_initiator(peers[i].id, &peers[i].clock, CLOCK_SYNC_SAMPLES);
+        } else {    // role == ROLE_CLIENT
+            rv = dccs_clock_sync_responder(peers[i].id, CLOCK_SYNC_SAMPLES);
+        }
+        if (rv != 0)
+            goto out_deallocate_buffer;
+    }
+
     log_debug("Sending RDMA writes ...\n");
     if (role == ROLE_SERVER) {
         start = calloc(params.repeat, sizeof(uint64_t));
@@ -126,123 +355,134 @@ int run(struct dccs_parameters params) {
     }
 
     //uint32_t recvd = 0;
-    int flag;
-    uint64_t target = get_cycles();
+    // Send once per slot, on the slot grid.
+    dccs_pacer_init(&pacer, &params, role == ROLE_SERVER ? params.repeat : 0);
     //size_t requests_sent = 0;
     for (size_t n = 0; n < params.repeat; n++) {
         if (n % (params.repeat / 100) == 0)
         //if (n % 100 == 0)
             log_debug("n = %zu.\n", n);
 
-        // Note: this is not working!
-        //target = (get_cycles() - target) / SLOT_NS * SLOT_NS + SLOT_NS;
-        target += SLOT_NS;
-        wait_until(target);
-
-        // Note: we need to signal occasionally;
-        //  otherwise, with only unsignaled requests, WQ will be full,
-        //  as they won't generate CQE.
-        //bool signal = (requests_sent % SIGNAL_INTERVAL == 0);
-        bool signal = true;
-        flag = signal ? IBV_SEND_SIGNALED : 0;
-
-        for (size_t i = 0; i < params.count; i++) {
-            struct dccs_request *request_in = requests_in + i;
-            struct dccs_request *request_out = requests_out + i;
-            if (role == ROLE_SERVER) {
-                start[n] = get_cycles();
-                rv = dccs_rdma_write_with_flags(id,
-                        request_out->buf, request_out->length, request_out->mr,
-                        request_out->remote_addr, request_out->remote_rkey, flag);
-                //requests_sent++;
-                if (rv != 0) {
-                    log_error("Failed to send write.\n");
-                    break;
-                }
-            } else {    // role == ROLE_CLIENT
-                /*while (magic != recvd) {
-                    sleep(1);
-                    recvd = *((uint32_t *)request_in->buf);
-                    log_debug("recvd = %#010x\n", recvd);
-                }*/
-                /*
-                while (magic != *((volatile uint32_t *)request_in->buf));
-                rv = dccs_rdma_write_with_flags(id,
-                        request_out->buf, request_out->length, request_out->mr,
-                        request_out->remote_addr, request_out->remote_rkey, flag);
-                requests_sent++;
-                if (rv != 0) {
-                    log_error("Failed to send write.\n");
-                    break;
-                }
+        uint32_t seq = (uint32_t)n + 1;
 
-                memset(request_in->buf, 0, request_in->length);
-                */
+        if (role == ROLE_SERVER) {
+            // Fan the signal out with one prebuilt write per client.
+            dccs_pacer_wait(&pacer);
+            start[n] = get_cycles();
+            for (size_t i = 0; i < peer_count; i++) {
+                if ((rv = post_signal(peers + i, seq, 0)) != 0)
+                    break;
             }
-        }
-
-        if (role == ROLE_SERVER && signal) {
-            while ((rv = dccs_rdma_send_comp(id, (int)params.count, wc)) == 0);
-            if (rv < 0) {
-                log_error("Failed to send comp message.\n");
+            dccs_pacer_record(&pacer, get_cycles());
+            if (rv != 0)
                 break;
+
+            // Wait for acks until the next signal is due; late ones count as missing.
+            // Every ack is also a clock sample, with the receiver's arrival
+            // time standing in for both of its timestamps.
+            size_t acked = 0;
+            while (acked < peer_count && get_cycles() < pacer.deadline) {
+                for (size_t i = 0; i < peer_count; i++) {
+                    struct control_peer *peer = peers + i;
+                    volatile struct control_signal *ack = peer->requests_in->buf;
+                    if (peer->acks[n] == 0 && mailbox_holds(ack, seq)) {
+                        peer->acks[n] = get_cycles();
+                        peer->arrivals[n] = ntohll(ack->timestamp);
+                        dccs_clock_add_sample(&peer->clock, start[n], peer->arrivals[n], peer->arrivals[n], peer->acks[n]);
+                        acked++;
+                    }
+                }
             }
 
-            end[n] = get_cycles();
+            if (acked == peer_count)
+                end[n] = get_cycles();
+        } else {    // role == ROLE_CLIENT
+            // Take the newest complete signal; skipped sequence numbers were lost.
+            volatile struct control_signal *mailbox = peers[0].requests_in->buf;
+            uint32_t received;
+            do {
+                received = ntohl(mailbox->canary);
+            } while (received < seq || !mailbox_holds(mailbox, received));
+
+            uint64_t arrival = get_cycles();
+            peers[0].arrivals[received - 1] = arrival;
+            if ((rv = post_signal(peers, received, arrival)) != 0)
+                break;
+            n = received - 1;
         }
+    }
 
-/*
-        for (size_t i = 0; i < params.count; i++) {
-            if (role == ROLE_SERVER) {
-                struct dccs_request *request_in = requests_in + i;
-                *while (magic != recvd) {
-                    sleep(1);
-                    recvd = *((uint32_t *)request_in->buf);
-                    log_debug("recvd = %#010x\n", recvd);
-                }*
-                while (magic != *((volatile uint32_t *)request_in->buf));
-                end[n * params.count + i] = get_cycles();
-                memset(request_in->buf, 0, request_in->length);
+    // Synchronize end of a round, and collect arrival times.
+    for (size_t i = 0; i < peer_count; i++) {
+        struct control_peer *peer = peers + i;
+        if (role == ROLE_SERVER) {
+            log_debug("Sending terminating message ...\n");
+            char buf[SYNC_END_MESSAGE_LENGTH] = SYNC_END_MESSAGE;
+            if ((rv = send_message(peer->id, buf, SYNC_END_MESSAGE_LENGTH)) < 0) {
+                log_error("Failed to send terminating message.\n");
+                goto out_deallocate_buffer;
+            }
+            if ((rv = recv_message(peer->id, peer->arrivals, params.repeat * sizeof(uint64_t))) < 0) {
+                log_error("Failed to recv arrival times.\n");
+                goto out_deallocate_buffer;
+            }
+        } else {    // role == ROLE_CLIENT
+            log_debug("Waiting for end message ...\n");
+            char buf[SYNC_END_MESSAGE_LENGTH] = {0};
+            if ((rv = recv_message(peer->id, buf, SYNC_END_MESSAGE_LENGTH)) < 0) {
+                log_error("Failed to recv terminating message.\n");
+                goto out_deallocate_buffer;
+            }
+            if ((rv = send_message(peer->id, peer->arrivals, params.repeat * sizeof(uint64_t))) < 0) {
+                log_error("Failed to send arrival times.\n");
+                goto out_deallocate_buffer;
             }
         }
-*/
     }
 
-    // Synchronize end of a round
     if (role == ROLE_SERVER) {
-        log_debug("Sending terminating message ...\n");
-        char buf[SYNC_END_MESSAGE_LENGTH] = SYNC_END_MESSAGE;
-        if ((rv = send_message(id, buf, SYNC_END_MESSAGE_LENGTH)) < 0) {
-            log_error("Failed to send terminating message.\n");
-            goto out_deallocate_buffer;
+        for (size_t i = 0; i < peer_count; i++) {
+            for (size_t n = 0; n < params.repeat; n++) {
+                if (peers[i].arrivals[n] != 0)
+                    peers[i].arrivals[n] = dccs_clock_to_local(&peers[i].clock, peers[i].arrivals[n]);
+            }
         }
-    } else {    // role == ROLE_CLIENT
-        log_debug("Waiting for end message ...\n");
-        char buf[SYNC_END_MESSAGE_LENGTH] = {0};
-        if ((rv = recv_message(id, buf, SYNC_END_MESSAGE_LENGTH)) < 0) {
-            log_error("Failed to recv terminating message.\n");
-            goto out_deallocate_buffer;
+
+        print_clock_report(peers, peer_count);
+        print_control_delivery_report(peers, peer_count, start, params.repeat);
+        print_skew_report(peers, peer_count, params.repeat);
+        print_pacer_report(&pacer);
+
+        // Latency from the post to the last ack, for signals acked by every client
+        size_t complete = 0;
+        for (size_t n = 0; n < params.repeat; n++) {
+            if (end[n] != 0) {
+                start[complete] = start[n];
+                end[complete++] = end[n];
+            }
         }
-    }
 
-    if (role == ROLE_SERVER) {
-        print_latency_report_raw(start, end, params.repeat, start[0], params.verbose, params.count, params.length);
+        if (complete > 0)
+            print_latency_report_raw(start, end, complete, start[0], params.verbose, params.count, params.length);
     }
 
     // Print stats
-    if (role == ROLE_SERVER) {
-        log_info("Server sent:\n");
-        print_sha1sum(requests_out, params.count);
-        log_info("Server received:\n");
-        print_sha1sum(requests_in, params.count);
-    } else {
-        log_info("Client received:\n");
-        print_sha1sum(requests_in, params.count);
-        log_info("Client sent:\n");
-        print_sha1sum(requests_out, params.count);
+    for (size_t i = 0; i < peer_count; i++) {
+        if (role == ROLE_SERVER) {
+            log_info("Server sent to client %zu:\n", i);
+            print_digest(&params, peers[i].requests_out, params.count);
+            log_info("Server received from client %zu:\n", i);
+            print_digest(&params, peers[i].requests_in, params.count);
+        } else {
+            log_info("Client received:\n");
+            print_digest(&params, peers[i].requests_in, params.count);
+            log_info("Client sent:\n");
+            print_digest(&params, peers[i].requests_out, params.count);
+        }
     }
 
 out_deallocate_buffer:
+    dccs_pacer_free(&pacer);
     if (role == ROLE_SERVER) {
         if (start != NULL)
             free(start);
@@ -251,17 +491,28 @@ out_deallocate_buffer:
     }
 
     log_debug("de-allocating buffer\n");
-    deallocate_buffer(requests_in, params);
-    deallocate_buffer(requests_out, params);
-    if (wc != NULL)
-        free(wc);
+    for (size_t i = 0; i < peer_count; i++) {
+        struct control_peer *peer = peers + i;
+        if (peer->requests_in != NULL && peer->requests_in->mr != NULL)
+            deallocate_buffer(peer->requests_in, params);
+        if (peer->requests_out != NULL && peer->requests_out->mr != NULL)
+            deallocate_buffer(peer->requests_out, params);
+        free(peer->requests_in);
+        free(peer->requests_out);
+        free(peer->arrivals);
+        free(peer->acks);
+    }
 out_disconnect:
     log_debug("Disconnecting\n");
-    if (role == ROLE_CLIENT)
-        dccs_client_disconnect(id);
-    else    // role == ROLE_SERVER
-        dccs_server_disconnect(id, listen_id);
+    if (role == ROLE_CLIENT) {
+        dccs_client_disconnect(peers[0].id);
+    } else {    // role == ROLE_SERVER
+        for (size_t i = 1; i < connected; i++)
+            dccs_client_disconnect(peers[i].id);
+        dccs_server_disconnect(peers[0].id, listen_id);
+    }
 end:
+    free(peers);
     return rv;
 }
 
@@ -274,4 +525,3 @@ int main(int argc, char *argv[]) {
 
     return run(params);
 }
-
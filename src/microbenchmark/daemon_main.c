@@ -0,0 +1,575 @@
+// Transport daemon: owns the NIC through the transport interface and moves
+// messages for applications attached over shared memory (see dccs_shm.h)
+
+#define _GNU_SOURCE
+
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "dccs_parameters.h"
+#include "dccs_utils.h"
+#include "dccs_rdma.h"
+#include "dccs_shm.h"
+#include "dccs_transport.h"
+#include "dccs_transport_mpi.h"
+#include "dccs_transport_verbs.h"
+
+uint64_t clock_rate = 0;    // Clock ticks per second
+
+static volatile sig_atomic_t stopping = 0;
+
+struct daemon_slot {
+    uint64_t cookie;
+    uint64_t length;
+    int32_t peer;
+};
+
+/**
+ * FIFO of indices: the slots of receives an application posted, or the
+ * receive buffers holding messages no receive has taken yet.
+ */
+struct daemon_queue {
+    uint32_t *items;
+    uint32_t head;
+    uint32_t count;
+    uint32_t capacity;
+};
+
+struct daemon {
+    struct dccs_transport *t;
+    struct dccs_shm shm;
+    struct daemon_slot *slots;      // Per channel and slot, indexed by work request ID
+    uint8_t *bufs;                  // Receive buffers, SHM_RECV_DEPTH per peer
+    size_t *buf_lengths;            // Bytes held by each receive buffer
+    uint64_t buf_wr_id;             // Work request ID of receive buffer 0
+    struct daemon_queue *pending;   // Per channel and peer: slots waiting for a message
+    struct daemon_queue *arrived;   // Per channel and peer: buffers waiting for a receive
+    size_t in_flight[SHM_MAX_APPS]; // Sends taken and not complete, per channel
+    size_t *posted;                 // Per peer: sends on its send queue
+    struct daemon_queue *backlog;   // Per peer: sends waiting for room on it, by work request ID
+
+    // Credits, per channel and peer: messages the channel may still send
+    size_t *credits;
+    struct daemon_queue *uncredited;    // Sends waiting for a credit, by work request ID
+    uint32_t *credit_msgs;              // Credits to return, as sent; one message in flight each
+    size_t *returned;                   // Credits to return, not yet sent
+    bool *credit_busy;
+    uint64_t credit_wr_id;              // Work request ID of the first credit message
+
+    size_t sends;
+    size_t receives;
+    size_t send_bytes;
+    size_t recv_bytes;
+    size_t dropped;
+    size_t failures;
+};
+
+static void daemon_stop(int signum) {
+    (void)signum;
+    stopping = 1;
+}
+
+static void daemon_queue_init(struct daemon_queue *q, uint32_t capacity) {
+    q->items = calloc(capacity, sizeof(uint32_t));
+    q->capacity = capacity;
+}
+
+// Never full: a queue is as deep as the slots or buffers it can hold.
+static void daemon_queue_push(struct daemon_queue *q, uint32_t item) {
+    q->items[(q->head + q->count++) % q->capacity] = item;
+}
+
+static bool daemon_queue_pop(struct daemon_queue *q, uint32_t *item) {
+    if (q->count == 0)
+        return false;
+
+    *item = q->items[q->head];
+    q->head = (q->head + 1) % q->capacity;
+    q->count--;
+    return true;
+}
+
+static inline size_t daemon_queue_index(struct daemon *d, size_t channel, int peer) {
+    return channel * d->t->peer_count + (size_t)peer;
+}
+
+static inline uint32_t daemon_channel_state(struct daemon *d, size_t channel) {
+    return __atomic_load_n(&d->shm.header->channels[channel].state, __ATOMIC_ACQUIRE);
+}
+
+static void daemon_respond(struct daemon *d, size_t channel, struct dccs_shm_entry *entry) {
+    // Never full: every entry answers a request that left this channel's request ring.
+    if (!dccs_ring_push(&d->shm.header->channels[channel].responses, entry))
+        log_error("Response ring of channel %zu is full.\n", channel);
+}
+
+static int daemon_post_buffer(struct daemon *d, uint32_t buf) {
+    struct dccs_transport *t = d->t;
+    size_t slot_size = d->shm.header->slot_size;
+    int rv;
+
+    if ((rv = t->ops->irecv(t, (int)(buf / SHM_RECV_DEPTH), d->bufs + buf * slot_size, slot_size,
+                            d->buf_wr_id + buf)) != 0) {
+        log_error("Failed to post receive buffer %u.\n", buf);
+        d->failures++;
+    }
+
+    return rv;
+}
+
+/**
+ * Send the credits owed to a peer for a channel, unless a credit message for
+ * it is still in flight.
+ */
+static void daemon_send_credits(struct daemon *d, size_t q) {
+    struct dccs_transport *t = d->t;
+    size_t channel = q / t->peer_count;
+    int peer = (int)(q % t->peer_count);
+
+    if (d->credit_busy[q] || d->returned[q] == 0)
+        return;
+
+    d->credit_msgs[q] = htonl((uint32_t)d->returned[q]);
+    if (t->ops->isend_tag(t, peer, d->credit_msgs + q, sizeof(uint32_t), (uint32_t)(SHM_MAX_APPS + channel),
+                          d->credit_wr_id + q) != 0) {
+        d->failures++;
+        return;
+    }
+    d->credit_busy[q] = true;
+    d->returned[q] = 0;
+}
+
+/**
+ * A message of a channel from a peer left its receive buffer: owe the peer
+ * a credit, and return credits once half of them are owed.
+ */
+static void daemon_return_credit(struct daemon *d, size_t channel, int peer) {
+    size_t q = daemon_queue_index(d, channel, peer);
+
+    if (++d->returned[q] >= SHM_CREDITS / 2)
+        daemon_send_credits(d, q);
+}
+
+/**
+ * Copy a message from a receive buffer into the receive of an application,
+ * answer it and post the buffer again.
+ */
+static void daemon_deliver(struct daemon *d, size_t channel, uint32_t slot, uint32_t buf) {
+    struct daemon_slot *s = d->slots + channel * d->shm.header->slots + slot;
+    size_t length = d->buf_lengths[buf];
+    struct dccs_shm_entry entry = {
+        .op = SHM_OP_RECV,
+        .slot = slot,
+        .length = length < s->length ? length : s->length,
+        .cookie = s->cookie,
+        .peer = (int32_t)(buf / SHM_RECV_DEPTH),
+        .status = length > s->length ? -EMSGSIZE : 0,
+    };
+
+    memcpy(dccs_shm_buffer(&d->shm, channel, slot), d->bufs + buf * d->shm.header->slot_size, entry.length);
+    d->receives++;
+    d->recv_bytes += entry.length;
+    daemon_respond(d, channel, &entry);
+    daemon_post_buffer(d, buf);
+    daemon_return_credit(d, channel, entry.peer);
+}
+
+/**
+ * Post a send straight from the application's buffer, tagged with the
+ * channel, or fail it back to the application.
+ */
+static void daemon_send(struct daemon *d, uint64_t wr_id) {
+    struct dccs_transport *t = d->t;
+    size_t channel = wr_id / d->shm.header->slots;
+    struct daemon_slot *s = d->slots + wr_id;
+    struct dccs_shm_entry entry = {
+        .op = SHM_OP_SEND,
+        .slot = (uint32_t)(wr_id % d->shm.header->slots),
+        .length = 0,
+        .cookie = s->cookie,
+        .peer = s->peer,
+        .status = -EIO,
+    };
+
+    if (t->ops->isend_tag(t, s->peer, dccs_shm_buffer(&d->shm, channel, entry.slot), s->length,
+                          (uint32_t)channel, wr_id) == 0) {
+        d->posted[s->peer]++;
+        return;
+    }
+
+    d->failures++;
+    d->in_flight[channel]--;
+    if (daemon_channel_state(d, channel) == SHM_CHANNEL_ATTACHED)
+        daemon_respond(d, channel, &entry);
+}
+
+/**
+ * Post the sends waiting for a peer while its send queue has room; all
+ * channels share it, so sends beyond its MAX_WR wait in the daemon. Room is
+ * left for a credit message per channel.
+ */
+static void daemon_send_backlog(struct daemon *d, int peer) {
+    uint32_t wr_id;
+
+    while (d->posted[peer] < MAX_WR - SHM_MAX_APPS && daemon_queue_pop(d->backlog + peer, &wr_id))
+        daemon_send(d, wr_id);
+}
+
+/**
+ * Move the sends of a channel to a peer that have credits to the peer's
+ * backlog, and post what fits.
+ */
+static void daemon_send_credited(struct daemon *d, size_t channel, int peer) {
+    size_t q = daemon_queue_index(d, channel, peer);
+    uint32_t wr_id;
+
+    while (d->credits[q] > 0 && daemon_queue_pop(d->uncredited + q, &wr_id)) {
+        d->credits[q]--;
+        daemon_queue_push(d->backlog + peer, wr_id);
+    }
+    daemon_send_backlog(d, peer);
+}
+
+/**
+ * Post a request from an application: a send straight from its buffer,
+ * tagged with the channel, or a receive that takes the next message of the
+ * peer for the channel.
+ */
+static void daemon_post(struct daemon *d, size_t channel, struct dccs_shm_entry *entry) {
+    struct dccs_shm_header *h = d->shm.header;
+    struct dccs_transport *t = d->t;
+    uint32_t buf;
+
+    if ((entry->op != SHM_OP_SEND && entry->op != SHM_OP_RECV) || entry->slot >= h->slots ||
+            entry->length > h->slot_size || entry->peer < 0 || (size_t)entry->peer >= t->peer_count) {
+        entry->length = 0;
+        entry->status = -EINVAL;
+        daemon_respond(d, channel, entry);
+        return;
+    }
+
+    uint64_t wr_id = channel * h->slots + entry->slot;
+    d->slots[wr_id] = (struct daemon_slot){ entry->cookie, entry->length, entry->peer };
+    if (entry->op == SHM_OP_RECV) {
+        size_t q = daemon_queue_index(d, channel, entry->peer);
+        if (daemon_queue_pop(d->arrived + q, &buf))
+            daemon_deliver(d, channel, entry->slot, buf);
+        else
+            daemon_queue_push(d->pending + q, entry->slot);
+        return;
+    }
+
+    d->in_flight[channel]++;
+    daemon_queue_push(d->uncredited + daemon_queue_index(d, channel, entry->peer), (uint32_t)wr_id);
+    daemon_send_credited(d, channel, entry->peer);
+}
+
+/**
+ * A message landed in a receive buffer: hand it to the receive its tag's
+ * channel posted first, or hold it until that channel posts one.
+ *
+ * All channels share a peer's receive buffers, and a held buffer is not
+ * posted again, so a channel that falls behind its receives could take them
+ * all. Credits bound it instead: a daemon sends a channel's message only
+ * with one of its SHM_CREDITS credits for that peer, and the receiving
+ * daemon returns credits as messages leave their buffers. A channel thus
+ * holds at most SHM_CREDITS buffers of a peer, and SHM_RECV_DEPTH covers
+ * every channel's credits plus a credit message each. Credit messages carry
+ * tag SHM_MAX_APPS + channel.
+ */
+static void daemon_arrive(struct daemon *d, struct dccs_completion *c) {
+    uint32_t buf = (uint32_t)(c->wr_id - d->buf_wr_id), slot;
+
+    // The connection is broken; the buffer is not posted again.
+    if (!c->ok) {
+        d->failures++;
+        return;
+    }
+
+    if (c->tag >= SHM_MAX_APPS) {
+        size_t channel = c->tag - SHM_MAX_APPS;
+        if (channel < SHM_MAX_APPS && c->length == sizeof(uint32_t)) {
+            uint32_t *credits = (uint32_t *)(d->bufs + buf * d->shm.header->slot_size);
+            d->credits[daemon_queue_index(d, channel, c->peer)] += ntohl(*credits);
+            daemon_send_credited(d, channel, c->peer);
+        } else {
+            d->dropped++;
+        }
+        daemon_post_buffer(d, buf);
+        return;
+    }
+
+    if (daemon_channel_state(d, c->tag) != SHM_CHANNEL_ATTACHED) {
+        d->dropped++;
+        daemon_post_buffer(d, buf);
+        daemon_return_credit(d, c->tag, c->peer);
+        return;
+    }
+
+    size_t q = daemon_queue_index(d, c->tag, c->peer);
+    d->buf_lengths[buf] = c->length;
+    if (daemon_queue_pop(d->pending + q, &slot))
+        daemon_deliver(d, c->tag, slot, buf);
+    else
+        daemon_queue_push(d->arrived + q, buf);
+}
+
+static void daemon_complete(struct daemon *d, struct dccs_completion *c) {
+    if (c->wr_id >= d->credit_wr_id) {
+        size_t q = c->wr_id - d->credit_wr_id;
+        d->credit_busy[q] = false;
+        if (!c->ok)
+            d->failures++;
+        else if (d->returned[q] >= SHM_CREDITS / 2)
+            daemon_send_credits(d, q);
+        return;
+    }
+    if (c->wr_id >= d->buf_wr_id) {
+        daemon_arrive(d, c);
+        return;
+    }
+
+    struct dccs_shm_header *h = d->shm.header;
+    size_t channel = c->wr_id / h->slots;
+    struct daemon_slot *slot = d->slots + c->wr_id;
+    struct dccs_shm_entry entry = {
+        .op = SHM_OP_SEND,
+        .slot = (uint32_t)(c->wr_id % h->slots),
+        .length = c->ok ? slot->length : 0,
+        .cookie = slot->cookie,
+        .peer = c->peer,
+        .status = c->ok ? 0 : -EIO,
+    };
+
+    d->in_flight[channel]--;
+    d->posted[c->peer]--;
+    if (!c->ok) {
+        d->failures++;
+    } else {
+        d->sends++;
+        d->send_bytes += entry.length;
+    }
+
+    if (daemon_channel_state(d, channel) == SHM_CHANNEL_ATTACHED)
+        daemon_respond(d, channel, &entry);
+    daemon_send_backlog(d, c->peer);
+}
+
+/**
+ * Drop the work of a detaching channel and, once its posted sends have left
+ * the application's buffers, free it with both rings empty. Dropped
+ * messages still return their credits; the channel's credits carry over to
+ * its next application.
+ */
+static void daemon_release(struct daemon *d, size_t channel) {
+    struct dccs_shm_channel *ch = d->shm.header->channels + channel;
+    uint32_t buf, wr_id;
+
+    for (int p = 0; p < (int)d->t->peer_count; p++) {
+        size_t q = daemon_queue_index(d, channel, p);
+        d->pending[q].count = 0;
+        while (daemon_queue_pop(d->uncredited + q, &wr_id))
+            d->in_flight[channel]--;
+        while (daemon_queue_pop(d->arrived + q, &buf)) {
+            d->dropped++;
+            daemon_post_buffer(d, buf);
+            daemon_return_credit(d, channel, p);
+        }
+    }
+    if (d->in_flight[channel] > 0)
+        return;
+
+    ch->requests.head = ch->requests.tail = 0;
+    ch->responses.head = ch->responses.tail = 0;
+    __atomic_store_n(&ch->state, SHM_CHANNEL_FREE, __ATOMIC_RELEASE);
+}
+
+/**
+ * Poll every channel's request ring and the transport until stopped.
+ */
+static int daemon_serve(struct daemon *d) {
+    struct dccs_completion completions[TRANSPORT_POLL_BATCH];
+    struct dccs_shm_entry entry;
+    struct dccs_transport *t = d->t;
+
+    while (!stopping) {
+        for (size_t channel = 0; channel < SHM_MAX_APPS; channel++) {
+            struct dccs_ring *requests = &d->shm.header->channels[channel].requests;
+            uint32_t state = daemon_channel_state(d, channel);
+
+            if (state == SHM_CHANNEL_DETACHING)
+                daemon_release(d, channel);
+            for (int k = 0; state == SHM_CHANNEL_ATTACHED && k < SHM_BATCH && dccs_ring_pop(requests, &entry); k++)
+                daemon_post(d, channel, &entry);
+        }
+
+        int rv = t->ops->poll(t, completions, TRANSPORT_POLL_BATCH);
+        if (rv < 0)
+            return rv;
+        for (int k = 0; k < rv; k++)
+            daemon_complete(d, completions + k);
+    }
+
+    return 0;
+}
+
+static int daemon_connect(struct dccs_transport *t, struct dccs_parameters *params) {
+    if (!t->server)
+        return t->ops->connect(t, params->server, params->port) < 0 ? -1 : 0;
+
+    if (t->ops->listen(t, params->port) != 0)
+        return -1;
+    for (size_t p = 0; p < t->expected_peers; p++) {
+        if (t->ops->accept(t) < 0) {
+            log_error("Failed to accept peer %zu.\n", p);
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * Set up the receive buffers and the queues that match them with the
+ * receives of applications, and post every buffer.
+ */
+static int daemon_setup_receives(struct daemon *d) {
+    struct dccs_transport *t = d->t;
+    size_t slot_size = d->shm.header->slot_size, count = t->peer_count * SHM_RECV_DEPTH;
+    size_t queues = SHM_MAX_APPS * t->peer_count;
+
+    d->bufs = calloc(count, slot_size);
+    d->buf_lengths = calloc(count, sizeof(size_t));
+    d->buf_wr_id = (uint64_t)SHM_MAX_APPS * d->shm.header->slots;
+    if (t->ops->register_buffer != NULL && t->ops->register_buffer(t, d->bufs, count * slot_size) != 0) {
+        log_error("Failed to register the receive buffers.\n");
+        return -1;
+    }
+
+    d->pending = calloc(queues, sizeof(struct daemon_queue));
+    d->arrived = calloc(queues, sizeof(struct daemon_queue));
+    d->uncredited = calloc(queues, sizeof(struct daemon_queue));
+    d->credits = calloc(queues, sizeof(size_t));
+    d->returned = calloc(queues, sizeof(size_t));
+    d->credit_busy = calloc(queues, sizeof(bool));
+    d->credit_msgs = calloc(queues, sizeof(uint32_t));
+    d->credit_wr_id = d->buf_wr_id + count;
+    for (size_t q = 0; q < queues; q++) {
+        daemon_queue_init(d->pending + q, d->shm.header->slots);
+        daemon_queue_init(d->arrived + q, SHM_CREDITS);
+        daemon_queue_init(d->uncredited + q, d->shm.header->slots);
+        d->credits[q] = SHM_CREDITS;
+    }
+    if (t->ops->register_buffer != NULL && t->ops->register_buffer(t, d->credit_msgs, queues * sizeof(uint32_t)) != 0) {
+        log_error("Failed to register the credit messages.\n");
+        return -1;
+    }
+
+    for (uint32_t buf = 0; buf < count; buf++) {
+        if (daemon_post_buffer(d, buf) != 0)
+            return -1;
+    }
+
+    return 0;
+}
+
+int run(struct dccs_transport *t, struct dccs_parameters *params) {
+    struct dccs_shm_header *h;
+    struct sigaction action;
+    struct daemon d;
+    int rv;
+
+    memset(&d, 0, sizeof d);
+    d.t = t;
+    if (t->ops->isend_tag == NULL) {
+        log_error("The %s backend cannot tag messages with their channel.\n", t->ops->name);
+        return -1;
+    }
+    if ((rv = daemon_connect(t, params)) != 0)
+        return rv;
+    if ((rv = dccs_shm_create(&d.shm, params->shm_name, params->length)) != 0)
+        return rv;
+
+    h = d.shm.header;
+    if (t->ops->register_buffer != NULL &&
+            (rv = t->ops->register_buffer(t, (uint8_t *)h + h->buffer_offset, h->size - h->buffer_offset)) != 0) {
+        log_error("Failed to register the message buffers.\n");
+        goto out;
+    }
+    if ((rv = daemon_setup_receives(&d)) != 0)
+        goto out;
+
+    memset(&action, 0, sizeof action);
+    action.sa_handler = daemon_stop;
+    sigaction(SIGINT, &action, NULL);
+    sigaction(SIGTERM, &action, NULL);
+
+    d.slots = calloc((size_t)SHM_MAX_APPS * h->slots, sizeof(struct daemon_slot));
+    d.posted = calloc(t->peer_count, sizeof(size_t));
+    d.backlog = calloc(t->peer_count, sizeof(struct daemon_queue));
+    for (size_t p = 0; p < t->peer_count; p++)
+        daemon_queue_init(d.backlog + p, SHM_MAX_APPS * h->slots);
+    h->peer_count = (uint32_t)t->peer_count;
+    h->server = t->server;
+    __atomic_store_n(&h->ready, 1, __ATOMIC_RELEASE);
+    log_info("Serving %s over %s: %zu peer(s), %d channels of %u x %zu-byte buffers.\n",
+             params->shm_name, t->ops->name, t->peer_count, SHM_MAX_APPS, h->slots, h->slot_size);
+
+    rv = daemon_serve(&d);
+    __atomic_store_n(&h->ready, 0, __ATOMIC_RELEASE);
+
+    log_info("=====================\n");
+    log_info("Daemon Report\n");
+    log_info("sends, send bytes, receives, receive bytes, dropped, failures\n");
+    log_info("%zu, %zu, %zu, %zu, %zu, %zu\n", d.sends, d.send_bytes, d.receives, d.recv_bytes, d.dropped,
+             d.failures);
+
+out:
+    for (size_t q = 0; d.pending != NULL && q < SHM_MAX_APPS * t->peer_count; q++) {
+        free(d.pending[q].items);
+        free(d.arrived[q].items);
+        free(d.uncredited[q].items);
+    }
+    free(d.uncredited);
+    free(d.credits);
+    free(d.returned);
+    free(d.credit_busy);
+    free(d.credit_msgs);
+    for (size_t p = 0; d.backlog != NULL && p < t->peer_count; p++)
+        free(d.backlog[p].items);
+    free(d.backlog);
+    free(d.posted);
+    free(d.pending);
+    free(d.arrived);
+    free(d.buf_lengths);
+    free(d.bufs);
+    free(d.slots);
+    dccs_shm_destroy(&d.shm, params->shm_name);
+    return rv;
+}
+
+int main(int argc, char *argv[]) {
+    struct dccs_parameters params;
+    struct dccs_transport t;
+    int rv;
+
+    parse_args(argc, argv, &params);
+    print_parameters(&params);
+    dccs_init();
+    if (params.backend == BACKEND_DAEMON) {
+        log_error("The daemon runs over the verbs or mpi backend.\n");
+        return EXIT_FAILURE;
+    }
+
+    memset(&t, 0, sizeof t);
+    t.ops = params.backend == BACKEND_MPI ? &mpi_transport_ops : &verbs_transport_ops;
+    t.params = &params;
+    if ((rv = t.ops->init(&t, &argc, &argv)) == 0)
+        rv = run(&t, &params);
+
+    if (t.state != NULL)
+        t.ops->disconnect(&t);
+
+    return rv == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,264 @@
+/**
+ * Out-of-band bootstrap over a single TCP rendezvous.
+ *
+ * One coordinator (which can run anywhere, including locally as a stand-in)
+ * accepts a connection from every member. Each member uploads one fixed-size
+ * record per host, describing what that host needs to know about it; the
+ * coordinator then hands every member the records addressed to it by all
+ * hosts. The same connections double as a barrier.
+ */
+
+#ifndef DCCS_BOOTSTRAP_H
+#define DCCS_BOOTSTRAP_H
+
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+
+#include "dccs_utils.h"
+
+struct dccs_bootstrap_header {
+    uint32_t rank;
+    uint32_t hosts;
+    uint32_t record_length;
+};
+
+struct dccs_bootstrap {
+    int fd;             // Member: connection to the coordinator
+    int listen_fd;      // Coordinator: listening socket
+    int *member_fds;    // Coordinator: connection of each rank
+    size_t hosts;
+    size_t record_length;
+};
+
+/* Socket helpers */
+
+int dccs_write_full(int fd, const void *buf, size_t length) {
+    const uint8_t *p = buf;
+    while (length > 0) {
+        ssize_t rv = write(fd, p, length);
+        if (rv < 0) {
+            log_perror("write");
+            return -1;
+        }
+        p += rv;
+        length -= (size_t)rv;
+    }
+
+    return 0;
+}
+
+int dccs_read_full(int fd, void *buf, size_t length) {
+    uint8_t *p = buf;
+    while (length > 0) {
+        ssize_t rv = read(fd, p, length);
+        if (rv <= 0) {
+            if (rv < 0)
+                log_perror("read");
+            else
+                log_error("Bootstrap peer closed the connection.\n");
+            return -1;
+        }
+        p += rv;
+        length -= (size_t)rv;
+    }
+
+    return 0;
+}
+
+static inline void dccs_set_nodelay(int fd) {
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof one);
+}
+
+/* Coordinator */
+
+/**
+ * Accept every member and return once all of them have introduced themselves.
+ */
+int dccs_bootstrap_coordinate(struct dccs_bootstrap *bs, char *port, size_t hosts, size_t record_length) {
+    struct addrinfo hints, *res;
+    int one = 1;
+    int rv;
+
+    memset(bs, 0, sizeof *bs);
+    bs->fd = bs->listen_fd = -1;
+    bs->hosts = hosts;
+    bs->record_length = record_length;
+    bs->member_fds = malloc(hosts * sizeof(int));
+    for (size_t n = 0; n < hosts; n++)
+        bs->member_fds[n] = -1;
+
+    memset(&hints, 0, sizeof hints);
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = AI_PASSIVE;
+    if ((rv = getaddrinfo(NULL, port, &hints, &res)) != 0) {
+        log_error("getaddrinfo: %s.\n", gai_strerror(rv));
+        return -1;
+    }
+
+    bs->listen_fd = socket(res->ai_family, res->ai_socktype, res->ai_protocol);
+    setsockopt(bs->listen_fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof one);
+    rv = bind(bs->listen_fd, res->ai_addr, res->ai_addrlen);
+    freeaddrinfo(res);
+    if (rv != 0 || listen(bs->listen_fd, (int)hosts) != 0) {
+        log_perror("bind/listen");
+        return -1;
+    }
+
+    for (size_t n = 0; n < hosts; n++) {
+        struct dccs_bootstrap_header header;
+        int fd = accept(bs->listen_fd, NULL, NULL);
+        if (fd < 0) {
+            log_perror("accept");
+            return -1;
+        }
+
+        dccs_set_nodelay(fd);
+        if (dccs_read_full(fd, &header, sizeof header) != 0)
+            return -1;
+
+        uint32_t rank = ntohl(header.rank);
+        if (ntohl(header.hosts) != hosts || ntohl(header.record_length) != record_length ||
+                rank >= hosts || bs->member_fds[rank] >= 0) {
+            log_error("Inconsistent bootstrap member (rank = %u, hosts = %u).\n", rank, ntohl(header.hosts));
+            close(fd);
+            return -1;
+        }
+
+        bs->member_fds[rank] = fd;
+        log_debug("Bootstrap member %u joined (%zu / %zu).\n", rank, n + 1, hosts);
+    }
+
+    return 0;
+}
+
+/**
+ * Collect hosts records from every member, where record j of member i is
+ * addressed to j, and send member j the records addressed to it, in rank order.
+ */
+int dccs_bootstrap_route(struct dccs_bootstrap *bs) {
+    size_t table_length = bs->hosts * bs->record_length;
+    uint8_t *table = malloc(bs->hosts * table_length);
+    uint8_t *out = malloc(table_length);
+    int rv = -1;
+
+    for (size_t i = 0; i < bs->hosts; i++) {
+        if (dccs_read_full(bs->member_fds[i], table + i * table_length, table_length) != 0)
+            goto out;
+    }
+
+    for (size_t j = 0; j < bs->hosts; j++) {
+        for (size_t i = 0; i < bs->hosts; i++)
+            memcpy(out + i * bs->record_length, table + i * table_length + j * bs->record_length, bs->record_length);
+        if (dccs_write_full(bs->member_fds[j], out, table_length) != 0)
+            goto out;
+    }
+
+    rv = 0;
+out:
+    free(out);
+    free(table);
+    return rv;
+}
+
+/**
+ * Release all members once every one of them has reached the barrier.
+ */
+int dccs_bootstrap_coordinate_barrier(struct dccs_bootstrap *bs) {
+    uint8_t token;
+    for (size_t n = 0; n < bs->hosts; n++) {
+        if (dccs_read_full(bs->member_fds[n], &token, sizeof token) != 0)
+            return -1;
+    }
+
+    for (size_t n = 0; n < bs->hosts; n++) {
+        if (dccs_write_full(bs->member_fds[n], &token, sizeof token) != 0)
+            return -1;
+    }
+
+    return 0;
+}
+
+/* Member */
+
+/**
+ * Connect to the coordinator, retrying while it is not up yet, so hosts can
+ * be launched in any order.
+ */
+int dccs_bootstrap_join(struct dccs_bootstrap *bs, char *coordinator, char *port,
+                        size_t rank, size_t hosts, size_t record_length) {
+    struct addrinfo hints, *res;
+    struct dccs_bootstrap_header header;
+    int rv;
+
+    memset(bs, 0, sizeof *bs);
+    bs->listen_fd = -1;
+    bs->hosts = hosts;
+    bs->record_length = record_length;
+
+    memset(&hints, 0, sizeof hints);
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_STREAM;
+    if ((rv = getaddrinfo(coordinator, port, &hints, &res)) != 0) {
+        log_error("getaddrinfo: %s.\n", gai_strerror(rv));
+        return -1;
+    }
+
+    for (int attempt = 0; ; attempt++) {
+        bs->fd = socket(res->ai_family, res->ai_socktype, res->ai_protocol);
+        if (connect(bs->fd, res->ai_addr, res->ai_addrlen) == 0)
+            break;
+
+        close(bs->fd);
+        if (attempt == BOOTSTRAP_CONNECT_RETRIES) {
+            log_perror("connect");
+            freeaddrinfo(res);
+            return -1;
+        }
+        usleep(BOOTSTRAP_RETRY_INTERVAL_USEC);
+    }
+
+    freeaddrinfo(res);
+    dccs_set_nodelay(bs->fd);
+
+    header.rank = htonl((uint32_t)rank);
+    header.hosts = htonl((uint32_t)hosts);
+    header.record_length = htonl((uint32_t)record_length);
+    return dccs_write_full(bs->fd, &header, sizeof header);
+}
+
+/**
+ * Upload one record per host and receive the record every host addressed to us.
+ */
+int dccs_bootstrap_exchange(struct dccs_bootstrap *bs, const void *records_out, void *records_in) {
+    size_t table_length = bs->hosts * bs->record_length;
+    if (dccs_write_full(bs->fd, records_out, table_length) != 0)
+        return -1;
+    return dccs_read_full(bs->fd, records_in, table_length);
+}
+
+int dccs_bootstrap_barrier(struct dccs_bootstrap *bs) {
+    uint8_t token = 0;
+    if (dccs_write_full(bs->fd, &token, sizeof token) != 0)
+        return -1;
+    return dccs_read_full(bs->fd, &token, sizeof token);
+}
+
+void dccs_bootstrap_close(struct dccs_bootstrap *bs) {
+    if (bs->fd >= 0)
+        close(bs->fd);
+    if (bs->listen_fd >= 0)
+        close(bs->listen_fd);
+    if (bs->member_fds != NULL) {
+        for (size_t n = 0; n < bs->hosts; n++) {
+            if (bs->member_fds[n] >= 0)
+                close(bs->member_fds[n]);
+        }
+        free(bs->member_fds);
+    }
+}
+
+#endif // DCCS_BOOTSTRAP_H
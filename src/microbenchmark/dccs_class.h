@@ -0,0 +1,179 @@
+/**
+ * Several traffic classes between one pair of hosts.
+ *
+ * Every class has its own connection, and so its own QP, set up with the
+ * class TOS; the fabric maps TOS to a priority (RoCE) or an SL (IB), which
+ * is what the classes are meant to exercise. Classes are given as
+ * comma-separated tos:length:count:mode tuples, for example
+ *
+ *     --classes=4:64:100000:latency,0:1048576:1000:throughput
+ *
+ * and run concurrently, one thread each. Latency classes send their count
+ * requests one at a time once; throughput classes repeat batches of count
+ * requests for as long as a latency class is still running, so that small
+ * messages always compete with bulk traffic.
+ */
+
+#ifndef DCCS_CLASS_H
+#define DCCS_CLASS_H
+
+#include <pthread.h>
+
+#include "dccs_rdma.h"
+
+struct dccs_class {
+    struct dccs_parameters params;  // Run parameters, with the class tos, length, count and mode
+    struct rdma_cm_id *id;
+    struct dccs_request *requests;
+
+    // Last run
+    pthread_t thread;
+    pthread_barrier_t *barrier;
+    volatile size_t *running;       // Latency classes still running
+    size_t batches;
+    uint64_t begin, end;
+    int rv;
+};
+
+/**
+ * Parse the class list into classes, derived from params.
+ * Return the number of classes, or -1 if the list is malformed.
+ */
+int dccs_class_parse(const char *list, struct dccs_parameters *params, struct dccs_class **classes) {
+    size_t count = 1;
+    for (const char *p = list; *p != '\0'; p++) {
+        if (*p == ',')
+            count++;
+    }
+
+    *classes = calloc(count, sizeof(struct dccs_class));
+    const char *p = list;
+    for (size_t k = 0; k < count; k++) {
+        struct dccs_class *c = *classes + k;
+        unsigned int tos;
+        char mode[16];
+        int consumed = 0;
+
+        if (sscanf(p, "%u:%zu:%zu:%15[a-z]%n", &tos, &c->params.length, &c->params.count, mode, &consumed) != 4 ||
+                tos > UINT8_MAX || c->params.length == 0 || c->params.count == 0 ||
+                (p[consumed] != ',' && p[consumed] != '\0')) {
+            log_error("Invalid traffic class %zu in '%s'.\n", k, list);
+            goto invalid;
+        }
+
+        size_t length = c->params.length, requests = c->params.count;
+        c->params = *params;
+        c->params.tos = (uint8_t)tos;
+        c->params.length = length;
+        c->params.count = requests;
+        c->params.mr_count = 1;
+        c->params.warmup_count = 0;
+        c->params.sge = 1;
+        if (strcmp(mode, "latency") == 0) {
+            c->params.mode = MODE_LATENCY;
+        } else if (strcmp(mode, "throughput") == 0) {
+            c->params.mode = MODE_THROUGHPUT;
+        } else {
+            log_error("Traffic class %zu: mode must be 'latency' or 'throughput'.\n", k);
+            goto invalid;
+        }
+
+        p += consumed + 1;
+    }
+
+    return (int)count;
+
+invalid:
+    free(*classes);
+    *classes = NULL;
+    return -1;
+}
+
+static void *dccs_class_worker(void *arg) {
+    struct dccs_class *c = arg;
+    int rv;
+
+    c->rv = 0;
+    c->batches = 0;
+    pthread_barrier_wait(c->barrier);
+
+    c->begin = get_cycles();
+    do {
+        if ((rv = send_and_wait_requests(c->id, c->requests, &c->params)) < 0)
+            c->rv = rv;
+        c->batches++;
+    } while (c->params.mode == MODE_THROUGHPUT && *c->running > 0 && rv == 0);
+    c->end = get_cycles();
+
+    if (c->params.mode == MODE_LATENCY)
+        __sync_fetch_and_sub(c->running, 1);
+
+    return NULL;
+}
+
+/**
+ * Run every class concurrently, starting them together.
+ */
+int dccs_class_run(struct dccs_class *classes, size_t class_count) {
+    pthread_barrier_t barrier;
+    volatile size_t running = 0;
+    int failed_count = 0;
+
+    for (size_t k = 0; k < class_count; k++)
+        running += classes[k].params.mode == MODE_LATENCY;
+
+    pthread_barrier_init(&barrier, NULL, (unsigned int)class_count);
+    for (size_t k = 0; k < class_count; k++) {
+        classes[k].barrier = &barrier;
+        classes[k].running = &running;
+        if (pthread_create(&classes[k].thread, NULL, dccs_class_worker, classes + k) != 0) {
+            // The barrier can no longer be reached; this is unrecoverable.
+            log_perror("pthread_create");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    for (size_t k = 0; k < class_count; k++) {
+        pthread_join(classes[k].thread, NULL);
+        if (classes[k].rv < 0)
+            failed_count -= classes[k].rv;
+    }
+
+    pthread_barrier_destroy(&barrier);
+    return -failed_count;
+}
+
+/**
+ * Print latency per class (for latency classes) and goodput of every class
+ * over its whole run.
+ */
+void print_class_report(struct dccs_class *classes, size_t class_count) {
+    log_info("=====================\n");
+    log_info("Traffic Class Report\n");
+    log_info("class, tos, mode, length, messages, median (µsec), percent99 (µsec), max (µsec), goodput (Gbps)\n");
+    for (size_t k = 0; k < class_count; k++) {
+        struct dccs_class *c = classes + k;
+        size_t messages = c->batches * c->params.count;
+        double elapsed = (double)(c->end - c->begin) / (double)clock_rate;
+        double goodput = (double)(messages * c->params.length) * 8 / elapsed / BILLION;
+
+        if (c->params.mode == MODE_THROUGHPUT) {
+            log_info("%zu, %u, throughput, %zu, %zu, -, -, -, %.3f\n", k, c->params.tos, c->params.length,
+                     messages, goodput);
+            continue;
+        }
+
+        size_t count = c->params.count;
+        double *latencies = malloc(count * sizeof(double));
+        for (size_t n = 0; n < count; n++)
+            latencies[n] = (double)(c->requests[n].end - c->requests[n].start) * MILLION / (double)clock_rate;
+        sort_latencies(latencies, count);
+        log_info("%zu, %u, latency, %zu, %zu, %.3f, %.3f, %.3f, %.3f\n", k, c->params.tos, c->params.length,
+                 messages, latencies[count / 2], latencies[(size_t)((double)count * 0.99)], latencies[count - 1],
+                 goodput);
+        free(latencies);
+    }
+    log_info("=====================\n\n");
+}
+
+#endif // DCCS_CLASS_H
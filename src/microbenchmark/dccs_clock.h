@@ -0,0 +1,202 @@
+/**
+ * Clock offset estimation between two hosts.
+ *
+ * Each sample is an NTP-style exchange: t1 (local send), t2 (remote receive),
+ * t3 (remote reply) and t4 (local receive) give
+ *
+ *     offset = ((t2 - t1) + (t3 - t4)) / 2,   rtt = (t4 - t1) - (t3 - t2),
+ *
+ * with offset = remote clock minus local clock. Queueing only ever adds to a
+ * sample's RTT and skews its offset, so of every window of samples only the
+ * one with the smallest RTT is kept. Successive window minima are fitted
+ * with a line, whose slope tracks the drift between the two clocks.
+ *
+ * Over loopback both ends share one clock, so the estimate should be 0.
+ */
+
+#ifndef DCCS_CLOCK_H
+#define DCCS_CLOCK_H
+
+#include "dccs_rdma.h"
+
+struct dccs_clock {
+    // Current estimate: offset(t) = offset + drift * (t - base), in cycles
+    double offset;
+    double drift;
+    uint64_t base;
+    double rtt;             // RTT of the last window minimum
+    size_t samples;
+
+    // Window minimum
+    size_t window;
+    size_t in_window;
+    double best_rtt;
+    double best_offset;
+    uint64_t best_time;
+
+    // Least-squares fit over window minima, with time relative to base
+    size_t points;
+    double sum_t, sum_o, sum_tt, sum_to;
+};
+
+// Timestamps exchanged by the sync protocol
+struct dccs_clock_probe {
+    uint64_t t1;
+    uint64_t t2;
+    uint64_t t3;
+};
+
+void dccs_clock_init(struct dccs_clock *c, size_t window) {
+    memset(c, 0, sizeof *c);
+    c->window = window;
+    c->best_rtt = DBL_MAX;
+}
+
+/**
+ * Add one exchange; t1 and t4 are on the local clock, t2 and t3 on the remote one.
+ */
+void dccs_clock_add_sample(struct dccs_clock *c, uint64_t t1, uint64_t t2, uint64_t t3, uint64_t t4) {
+    double rtt = (double)(int64_t)(t4 - t1) - (double)(int64_t)(t3 - t2);
+    double offset = ((double)(int64_t)(t2 - t1) + (double)(int64_t)(t3 - t4)) / 2;
+
+    c->samples++;
+    if (rtt < c->best_rtt) {
+        c->best_rtt = rtt;
+        c->best_offset = offset;
+        c->best_time = t1 + (t4 - t1) / 2;
+    }
+
+    if (++c->in_window < c->window)
+        return;
+
+    if (c->points == 0)
+        c->base = c->best_time;
+
+    double t = (double)(int64_t)(c->best_time - c->base);
+    c->points++;
+    c->sum_t += t;
+    c->sum_o += c->best_offset;
+    c->sum_tt += t * t;
+    c->sum_to += t * c->best_offset;
+    c->rtt = c->best_rtt;
+
+    double n = (double)c->points;
+    double denominator = n * c->sum_tt - c->sum_t * c->sum_t;
+    if (c->points > 1 && denominator > 0) {
+        c->drift = (n * c->sum_to - c->sum_t * c->sum_o) / denominator;
+        c->offset = (c->sum_o - c->drift * c->sum_t) / n;
+    } else {
+        c->drift = 0;
+        c->offset = c->best_offset;
+    }
+
+    c->in_window = 0;
+    c->best_rtt = DBL_MAX;
+}
+
+static inline int64_t dccs_clock_offset_at(struct dccs_clock *c, uint64_t t) {
+    return (int64_t)(c->offset + c->drift * (double)(int64_t)(t - c->base));
+}
+
+/**
+ * Convert a remote timestamp into the local time base.
+ */
+static inline uint64_t dccs_clock_to_local(struct dccs_clock *c, uint64_t remote) {
+    return remote - (uint64_t)dccs_clock_offset_at(c, remote);
+}
+
+/**
+ * Run samples ping-pong exchanges as the side whose clock is the reference.
+ * The peer must run dccs_clock_sync_responder() with the same count.
+ */
+int dccs_clock_sync_initiator(struct rdma_cm_id *id, struct dccs_clock *c, size_t samples) {
+    struct dccs_clock_probe *probes = calloc(2, sizeof(struct dccs_clock_probe));
+    struct dccs_clock_probe *out = probes, *in = probes + 1;
+    struct ibv_mr *mr;
+    struct ibv_wc wc;
+    int rv = -1;
+
+    if ((mr = dccs_reg_msgs(id, probes, 2 * sizeof(struct dccs_clock_probe))) == NULL)
+        goto end;
+
+    for (size_t n = 0; n < samples; n++) {
+        if ((rv = dccs_rdma_recv(id, in, sizeof *in, mr)) != 0)
+            goto out_dereg_mr;
+
+        uint64_t t1 = get_cycles();
+        out->t1 = htonll(t1);
+        if ((rv = dccs_rdma_send(id, out, sizeof *out, mr)) != 0)
+            goto out_dereg_mr;
+        if ((rv = dccs_rdma_send_comp(id, 1, &wc)) < 0)
+            goto out_dereg_mr;
+        rv = dccs_rdma_recv_comp(id, &wc);
+        uint64_t t4 = get_cycles();
+        if (rv < 0)
+            goto out_dereg_mr;
+
+        dccs_clock_add_sample(c, t1, ntohll(in->t2), ntohll(in->t3), t4);
+    }
+
+    rv = 0;
+    log_debug("Clock offset = %.3f µsec, rtt = %.3f µsec over %zu samples.\n",
+              c->offset * MILLION / (double)clock_rate, c->rtt * MILLION / (double)clock_rate, samples);
+
+out_dereg_mr:
+    dccs_dereg_mr(mr);
+end:
+    if (rv != 0)
+        log_error("Failed to synchronize clocks.\n");
+    free(probes);
+    return rv;
+}
+
+/**
+ * Answer the exchanges of dccs_clock_sync_initiator() with our timestamps.
+ * The receive for the next probe is posted before replying, so the
+ * initiator never waits on an RNR retry.
+ */
+int dccs_clock_sync_responder(struct rdma_cm_id *id, size_t samples) {
+    struct dccs_clock_probe *probes = calloc(3, sizeof(struct dccs_clock_probe));
+    struct dccs_clock_probe *out = probes;
+    struct ibv_mr *mr;
+    struct ibv_wc wc;
+    int rv = -1;
+
+    if ((mr = dccs_reg_msgs(id, probes, 3 * sizeof(struct dccs_clock_probe))) == NULL)
+        goto end;
+    if ((rv = dccs_rdma_recv(id, probes + 1, sizeof *probes, mr)) != 0)
+        goto out_dereg_mr;
+
+    for (size_t n = 0; n < samples; n++) {
+        // Alternate receive buffers, one being filled while the other is read.
+        struct dccs_clock_probe *in = probes + 1 + n % 2;
+        struct dccs_clock_probe *next = probes + 1 + (n + 1) % 2;
+
+        rv = dccs_rdma_recv_comp(id, &wc);
+        uint64_t t2 = get_cycles();
+        if (rv < 0)
+            goto out_dereg_mr;
+        if (n + 1 < samples && (rv = dccs_rdma_recv(id, next, sizeof *next, mr)) != 0)
+            goto out_dereg_mr;
+
+        out->t1 = in->t1;
+        out->t2 = htonll(t2);
+        out->t3 = htonll(get_cycles());
+        if ((rv = dccs_rdma_send(id, out, sizeof *out, mr)) != 0)
+            goto out_dereg_mr;
+        if ((rv = dccs_rdma_send_comp(id, 1, &wc)) < 0)
+            goto out_dereg_mr;
+    }
+
+    rv = 0;
+
+out_dereg_mr:
+    dccs_dereg_mr(mr);
+end:
+    if (rv != 0)
+        log_error("Failed to synchronize clocks.\n");
+    free(probes);
+    return rv;
+}
+
+#endif // DCCS_CLOCK_H
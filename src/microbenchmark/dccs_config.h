@@ -19,6 +19,20 @@
 
 /* RDMA configuration */
 #define MAX_WR 1000
+#define ATOMIC_OPERAND_LENGTH 8     // RDMA atomics always operate on 64-bit words
+#define ATOMIC_ADD_VALUE 1
+#define IMM_RECV_RING_DEPTH MAX_WR  // Receives kept posted for write-with-immediate
+#define MAX_SGE 30                  // ConnectX-5 max_sge
+#define UD_RECV_RING_DEPTH MAX_WR
+#define UD_SIGNAL_INTERVAL 100      // Unsignaled UD sends between two signaled ones
+#define UD_RECV_TIMEOUT_USEC 1000000
+#define UD_HANDSHAKE_RETRIES 10
+#define MESH_PORT_NUM 1
+#define MESH_MIN_RNR_TIMER 12       // 0.64 ms
+#define MESH_TIMEOUT 14             // 4.096 µs * 2^14 = 67 ms
+#define MESH_HOP_LIMIT 64           // RoCEv2 router hops, as librdmacm sets
+#define BOOTSTRAP_CONNECT_RETRIES 300
+#define BOOTSTRAP_RETRY_INTERVAL_USEC 100000
 
 /* Protocol default values */
 #define DEFAULT_MESSAGE_COUNT 1000
@@ -30,13 +44,50 @@
 #define DEFAULT_DIRECTION DIR_OUT
 #define DEFAULT_INDEX 0
 #define DEFAULT_TOS 0
+#define DEFAULT_ATOMIC_WORDS 0      // 0 means one remote word per request
+#define DEFAULT_SGE_COUNT 1
+#define DEFAULT_TRANSPORT TRANSPORT_RC
+#define DEFAULT_PEER_COUNT 1
+#define DEFAULT_HOST_COUNT 2
+#define DEFAULT_THREAD_COUNT 0      // 0 means one per online CPU
+#define DEFAULT_GID_INDEX 0
+#define DEFAULT_SLOT_PERIOD (DCCS_CYCLE_UPTIME + DCCS_CYCLE_DOWNTIME)
+#define DEFAULT_SLOT_UPTIME DCCS_CYCLE_UPTIME
+#define DEFAULT_SLOT_GUARD 0
+#define DEFAULT_SLOT_PHASE 0
+#define DEFAULT_SLOT_COUNT 1
+#define DEFAULT_SLOT 0
+#define DEFAULT_PACE_SPIN 20     // µsec before a deadline to stop sleeping and spin
+#define DEFAULT_ARRIVAL ARRIVAL_POISSON
+#define DEFAULT_ON_TIME 100      // µsec
+#define DEFAULT_OFF_TIME 100     // µsec
+#define DEFAULT_FANIN 0          // Incast senders, 0 for every other rank
+#define DEFAULT_SEED 1
+#define DEFAULT_BURST 0          // Bytes, 0 for a single message
+#define DEFAULT_MPI_WINDOW 128   // MPI requests in flight per rank
+#define DEFAULT_DIGEST DIGEST_SHA1
+#define DEFAULT_BACKEND BACKEND_VERBS
+#define DEFAULT_SHM_NAME "/dccs_transport"
 
 /* Protocol configuration */
 #define DCCS_CYCLE_UPTIME 180   // Cycle up time, in µsec
 #define DCCS_CYCLE_DOWNTIME 20  // Cycle down time, in µsec
+#define PACER_HISTOGRAM_BINS 20
+#define PACER_HISTOGRAM_BIN_NSEC 100
+#define CLOCK_SYNC_SAMPLES 100    // Exchanges per offset estimate
+#define LOAD_START_DELAY 100    // µsec from scheduling arrivals to the first one
+#define COLLECTIVE_MIN_LENGTH 8 // Shortest collective message, in bytes
+#define DIGEST_CHUNK_SIZE (1024 * 1024)    // Bytes hashed per task by parallel digests
+#define SHM_MAX_APPS 16        // Applications attached to a transport daemon at once
+#define SHM_SLOTS 256          // Message buffers per application, also its ring depth
+#define SHM_BATCH 16           // Requests a daemon takes from one application per pass
+#define SHM_CREDITS 16         // Messages a channel may have unreceived at a peer's daemon
+#define SHM_RECV_DEPTH (SHM_MAX_APPS * (SHM_CREDITS + 1))  // Receive buffers a daemon keeps posted per peer
+#define STREAM_RING_SIZE (4 * 1024 * 1024)  // Bytes each end of a stream can hold unread
+#define STREAM_CREDIT_FRACTION 4   // Readers return credits every 1/4 of the ring consumed
+#define STREAM_SIGNAL_INTERVAL 64  // Unsignaled stream writes between two signaled ones
 #define SYNC_END_MESSAGE "End"
 #define SYNC_END_MESSAGE_LENGTH 4
-#define MPI_FIRE_AND_FORGET 1
 
 /* Math constants */
 #define MILLION 1000000UL
@@ -0,0 +1,251 @@
+/**
+ * Payload digests for integrity checks.
+ *
+ * SHA-1 hashes the payload on one core. CRC32C hashes it in parallel: the
+ * payload, seen as one byte stream whatever its segments, is cut into
+ * DIGEST_CHUNK_SIZE chunks whose CRCs are computed by one thread per online
+ * CPU (with the SSE4.2 crc32 instruction where available) and folded in
+ * order into 64 bits. Chunking does not depend on segments or thread count,
+ * so both ends of a transfer agree on the digest however they hold the data.
+ */
+
+#ifndef DCCS_DIGEST_H
+#define DCCS_DIGEST_H
+
+#include <pthread.h>
+#if defined(__x86_64__)
+#include <nmmintrin.h>
+#endif
+
+#include "dccs_rdma.h"
+
+#define CRC32C_POLY 0x82f63b78  // Castagnoli, reflected
+#define DIGEST_FOLD_BASIS 0xcbf29ce484222325UL
+#define DIGEST_FOLD_PRIME 0x100000001b3UL
+
+struct digest_worker {
+    const struct dccs_segment *segments;
+    const size_t *offsets;      // Stream offset of every segment, and the total
+    size_t count;
+    size_t first;               // Chunks [first, last)
+    size_t last;
+    uint32_t *crcs;
+    pthread_t thread;
+};
+
+static uint32_t crc32c_table[256];
+static bool crc32c_hardware;
+
+static const char *digest_name(Digest digest) {
+    return digest == DIGEST_SHA1 ? "sha1" : "crc32c";
+}
+
+static void crc32c_init() {
+    for (uint32_t k = 0; k < 256; k++) {
+        uint32_t crc = k;
+        for (int bit = 0; bit < 8; bit++)
+            crc = crc & 1 ? (crc >> 1) ^ CRC32C_POLY : crc >> 1;
+        crc32c_table[k] = crc;
+    }
+
+#if defined(__x86_64__)
+    crc32c_hardware = __builtin_cpu_supports("sse4.2");
+#endif
+}
+
+#if defined(__x86_64__)
+__attribute__((target("sse4.2")))
+static uint32_t crc32c_update_hw(uint32_t crc, const uint8_t *p, size_t length) {
+    uint64_t crc64 = crc;
+    for (; length >= sizeof(uint64_t); p += sizeof(uint64_t), length -= sizeof(uint64_t)) {
+        uint64_t word;
+        memcpy(&word, p, sizeof word);
+        crc64 = _mm_crc32_u64(crc64, word);
+    }
+
+    crc = (uint32_t)crc64;
+    for (; length > 0; p++, length--)
+        crc = _mm_crc32_u8(crc, *p);
+
+    return crc;
+}
+#endif
+
+static uint32_t crc32c_update(uint32_t crc, const uint8_t *p, size_t length) {
+#if defined(__x86_64__)
+    if (crc32c_hardware)
+        return crc32c_update_hw(crc, p, length);
+#endif
+
+    for (; length > 0; p++, length--)
+        crc = crc32c_table[(crc ^ *p) & 0xff] ^ (crc >> 8);
+
+    return crc;
+}
+
+static void *digest_worker_run(void *arg) {
+    struct digest_worker *w = arg;
+    size_t total = w->offsets[w->count];
+    size_t segment = 0;
+
+    for (size_t chunk = w->first; chunk < w->last; chunk++) {
+        size_t begin = chunk * DIGEST_CHUNK_SIZE;
+        size_t end = begin + DIGEST_CHUNK_SIZE < total ? begin + DIGEST_CHUNK_SIZE : total;
+        uint32_t crc = UINT32_MAX;
+
+        while (w->offsets[segment + 1] <= begin)
+            segment++;
+        for (size_t offset = begin; offset < end; segment++) {
+            size_t skip = offset - w->offsets[segment];
+            size_t length = w->segments[segment].length - skip;
+            if (length > end - offset)
+                length = end - offset;
+            crc = crc32c_update(crc, (const uint8_t *)w->segments[segment].addr + skip, length);
+            offset += length;
+            if (offset < w->offsets[segment + 1])
+                break;
+        }
+
+        w->crcs[chunk] = ~crc;
+    }
+
+    return NULL;
+}
+
+/**
+ * Entry of a spawned worker, which inherits the caller's pinning: let it
+ * spread out even if the process is pinned to one CPU. The caller keeps its
+ * own pinning.
+ */
+static void *digest_worker_thread(void *arg) {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (long cpu = 0; cpu < sysconf(_SC_NPROCESSORS_ONLN); cpu++)
+        CPU_SET((size_t)cpu, &set);
+    pthread_setaffinity_np(pthread_self(), sizeof set, &set);
+
+    return digest_worker_run(arg);
+}
+
+static uint64_t digest_crc32c(const struct dccs_segment *segments, size_t count) {
+    size_t *offsets = malloc((count + 1) * sizeof(size_t));
+    offsets[0] = 0;
+    for (size_t k = 0; k < count; k++)
+        offsets[k + 1] = offsets[k] + segments[k].length;
+
+    size_t total = offsets[count];
+    size_t chunks = (total + DIGEST_CHUNK_SIZE - 1) / DIGEST_CHUNK_SIZE;
+    size_t threads = (size_t)sysconf(_SC_NPROCESSORS_ONLN);
+    if (threads > chunks)
+        threads = chunks;
+    if (threads == 0)
+        threads = 1;
+
+    uint32_t *crcs = malloc((chunks + 1) * sizeof(uint32_t));
+    struct digest_worker *workers = calloc(threads, sizeof(struct digest_worker));
+    for (size_t t = 0; t < threads; t++) {
+        struct digest_worker *w = workers + t;
+        w->segments = segments;
+        w->offsets = offsets;
+        w->count = count;
+        w->first = chunks * t / threads;
+        w->last = chunks * (t + 1) / threads;
+        w->crcs = crcs;
+    }
+
+    // The calling thread takes the first share.
+    for (size_t t = 1; t < threads; t++) {
+        if (pthread_create(&workers[t].thread, NULL, digest_worker_thread, workers + t) != 0) {
+            log_perror("pthread_create");
+            digest_worker_run(workers + t);
+            workers[t].thread = 0;
+        }
+    }
+    digest_worker_run(workers);
+    for (size_t t = 1; t < threads; t++) {
+        if (workers[t].thread != 0)
+            pthread_join(workers[t].thread, NULL);
+    }
+
+    uint64_t digest = DIGEST_FOLD_BASIS;
+    for (size_t chunk = 0; chunk < chunks; chunk++)
+        digest = (digest ^ crcs[chunk]) * DIGEST_FOLD_PRIME;
+    digest = (digest ^ total) * DIGEST_FOLD_PRIME;
+
+    free(workers);
+    free(crcs);
+    free(offsets);
+    return digest;
+}
+
+/**
+ * Digest the concatenation of the segments into 64 bits; for SHA-1, its
+ * first 8 bytes.
+ */
+uint64_t dccs_digest(Digest kind, const struct dccs_segment *segments, size_t count) {
+    if (kind == DIGEST_SHA1) {
+        unsigned char sha[SHA_DIGEST_LENGTH];
+        uint64_t digest;
+
+        sha1sum_segments(segments, count, sha);
+        memcpy(&digest, sha, sizeof digest);
+        return digest;
+    }
+
+    if (crc32c_table[1] == 0)
+        crc32c_init();
+    return digest_crc32c(segments, count);
+}
+
+/**
+ * Digest a single buffer.
+ */
+uint64_t dccs_digest_buffer(Digest kind, const void *buf, size_t length) {
+    struct dccs_segment segment = { buf, length };
+    return dccs_digest(kind, &segment, 1);
+}
+
+/**
+ * Print the digest of the payload of count requests, in message order. SHA-1
+ * keeps the full print_sha1sum() output.
+ */
+void print_digest(struct dccs_parameters *params, struct dccs_request *requests, size_t count) {
+    if (params->digest == DIGEST_SHA1) {
+        print_sha1sum(requests, count);
+        return;
+    }
+
+    if (count == 0) {
+        log_error("Failed to calculate digest: empty request array.\n");
+        return;
+    }
+
+    size_t segment_count = 0;
+    for (size_t n = 0; n < count; n++)
+        segment_count += requests[n].num_sge > 1 ? (size_t)requests[n].num_sge : 1;
+
+    struct dccs_segment *segments = malloc(segment_count * sizeof(struct dccs_segment));
+    size_t k = 0;
+    for (size_t n = 0; n < count; n++) {
+        struct dccs_request *request = requests + n;
+        if (request->num_sge > 1) {
+            for (int s = 0; s < request->num_sge; s++) {
+                segments[k].addr = (void *)(uintptr_t)request->sg_list[s].addr;
+                segments[k++].length = request->sg_list[s].length;
+            }
+        } else {
+            segments[k].addr = request->buf;
+            segments[k++].length = request->length;
+        }
+    }
+
+    uint64_t start = get_cycles();
+    uint64_t digest = dccs_digest(params->digest, segments, segment_count);
+    double elapsed = (double)(get_cycles() - start) * 1e3 / (double)clock_rate;
+    log_info("%s digest: count = %zu, length = %zu, digest = %016lx, elapsed = %.3f ms.\n",
+             digest_name(params->digest), count, requests[0].length, digest, elapsed);
+
+    free(segments);
+}
+
+#endif // DCCS_DIGEST_H
@@ -0,0 +1,272 @@
+/**
+ * Open-loop load generation.
+ *
+ * Closed-loop modes post the next request only after the previous one
+ * completed, so a slow request delays the ones behind it and the delay
+ * never shows up in their latency (coordinated omission). Here every
+ * request gets an intended send time from an arrival process at a given
+ * offered load, independent of completions, and its latency runs from that
+ * intended time: time spent waiting behind a full send queue counts.
+ *
+ * Arrival processes:
+ *  - constant: one request every 1 / rate;
+ *  - poisson: exponential gaps with mean 1 / rate;
+ *  - on/off: Poisson arrivals during on periods only, at rate scaled up by
+ *    (on + off) / on so the average offered load is unchanged.
+ *
+ * A run sweeps the list of offered loads given with --load, one pass of
+ * count requests per load, and reports latency against load.
+ */
+
+#ifndef DCCS_LOAD_H
+#define DCCS_LOAD_H
+
+#include "dccs_rdma.h"
+
+#define LOAD_POLL_BATCH 16
+
+struct dccs_load_point {
+    double offered;         // In Gbps
+    double achieved;
+    size_t completed;
+    size_t failed;
+
+    // Latency from the intended send time, in µsec
+    double median;
+    double percent99;
+    double percent999;
+    double max;
+
+    // Latency from the actual post time, i.e. without the correction
+    double post_median;
+    double post_percent99;
+};
+
+/**
+ * Parse a comma-separated list of offered loads in Gbps.
+ * Return the number of loads, or -1 if the list is malformed.
+ */
+int dccs_load_parse(const char *list, double **loads) {
+    size_t count = 1;
+    for (const char *p = list; *p != '\0'; p++) {
+        if (*p == ',')
+            count++;
+    }
+
+    *loads = malloc(count * sizeof(double));
+    const char *p = list;
+    for (size_t n = 0; n < count; n++) {
+        char *end;
+        double load = strtod(p, &end);
+        if (end == p || load <= 0 || (*end != ',' && *end != '\0')) {
+            free(*loads);
+            *loads = NULL;
+            return -1;
+        }
+        (*loads)[n] = load;
+        p = end + 1;
+    }
+
+    return (int)count;
+}
+
+static inline double load_exponential(double mean) {
+    return -log(1 - drand48()) * mean;
+}
+
+/**
+ * Fill in the intended send time of every request for an offered load, with
+ * the first arrival at begin.
+ */
+void dccs_load_arrivals(uint64_t *intended, size_t count, struct dccs_parameters *params,
+                        double gbps, uint64_t begin) {
+    double gap = (double)(params->length * 8) * (double)clock_rate / (gbps * BILLION);  // In cycles
+    double on = (double)usec_to_cycles(params->on_time);
+    double off = (double)usec_to_cycles(params->off_time);
+    double t = 0;
+
+    for (size_t n = 0; n < count; n++) {
+        switch (params->arrival) {
+            case ARRIVAL_CONSTANT:
+                intended[n] = begin + (uint64_t)t;
+                t += gap;
+                break;
+            case ARRIVAL_POISSON:
+                intended[n] = begin + (uint64_t)t;
+                t += load_exponential(gap);
+                break;
+            case ARRIVAL_ON_OFF: {
+                // t runs on on-time only; map it onto the on/off cycle.
+                double period = floor(t / on);
+                intended[n] = begin + (uint64_t)(period * (on + off) + (t - period * on));
+                t += load_exponential(gap * on / (on + off));
+                break;
+            }
+        }
+    }
+}
+
+/**
+ * Post every request at its intended time, regardless of earlier
+ * completions, with up to MAX_WR in flight. Requests that find the send
+ * queue full go out as soon as it drains, late. Every request is signaled
+ * and RC completes them in posting order.
+ */
+int load_send_requests(struct rdma_cm_id *id, struct dccs_request *requests, uint64_t *intended,
+                       struct dccs_parameters *params) {
+    struct ibv_wc wc[LOAD_POLL_BATCH];
+    size_t inflight[MAX_WR];
+    size_t head = 0, inflight_count = 0;
+    size_t posted = 0, remaining = params->count;
+    int failed_count = 0;
+
+    for (size_t n = 0; n < params->count; n++)
+        requests[n].start = requests[n].end = 0;
+
+    while (remaining > 0) {
+        uint64_t now = get_cycles();
+        while (posted < params->count && inflight_count < MAX_WR && intended[posted] <= now) {
+            struct dccs_request *request = requests + posted;
+            if (dccs_post_request(id, request, posted, IBV_SEND_SIGNALED) != 0) {
+                failed_count++;
+                remaining--;
+                posted++;
+                continue;
+            }
+
+            request->start = get_cycles();
+            inflight[(head + inflight_count) % MAX_WR] = posted;
+            inflight_count++;
+            posted++;
+        }
+
+        if (inflight_count == 0)
+            continue;
+
+        int rv = ibv_poll_cq(id->send_cq, LOAD_POLL_BATCH, wc);
+        if (rv < 0) {
+            log_error("ibv_poll_cq() failed, error = %d.\n", rv);
+            failed_count += (int)remaining;
+            break;
+        }
+
+        uint64_t t = get_cycles();
+        for (int k = 0; k < rv; k++) {
+            size_t n = inflight[head];
+            head = (head + 1) % MAX_WR;
+            inflight_count--;
+            remaining--;
+
+            requests[n].end = t;
+            if (wc[k].status != IBV_WC_SUCCESS) {
+                log_error("Failed status %s (%d) for request %zu\n",
+                    ibv_wc_status_str(wc[k].status), wc[k].status, n);
+                requests[n].end = 0;
+                failed_count++;
+            }
+        }
+    }
+
+    return -failed_count;
+}
+
+/**
+ * Summarize the last pass at an offered load.
+ */
+void dccs_load_summarize(struct dccs_load_point *point, struct dccs_request *requests, uint64_t *intended,
+                         struct dccs_parameters *params, double gbps) {
+    double *latencies = malloc(params->count * sizeof(double));
+    double *posts = malloc(params->count * sizeof(double));
+    uint64_t last = intended[0];
+    size_t length = 0;
+
+    memset(point, 0, sizeof *point);
+    point->offered = gbps;
+    for (size_t n = 0; n < params->count; n++) {
+        struct dccs_request *request = requests + n;
+        if (request->end == 0)
+            continue;
+
+        latencies[length] = (double)(request->end - intended[n]) * MILLION / (double)clock_rate;
+        posts[length++] = (double)(request->end - request->start) * MILLION / (double)clock_rate;
+        if (request->end > last)
+            last = request->end;
+    }
+
+    point->completed = length;
+    point->failed = params->count - length;
+    if (length > 0) {
+        sort_latencies(latencies, length);
+        sort_latencies(posts, length);
+        point->median = latencies[length / 2];
+        point->percent99 = latencies[(size_t)((double)length * 0.99)];
+        point->percent999 = latencies[(size_t)((double)length * 0.999)];
+        point->max = latencies[length - 1];
+        point->post_median = posts[length / 2];
+        point->post_percent99 = posts[(size_t)((double)length * 0.99)];
+
+        double elapsed = (double)(last - intended[0]) / (double)clock_rate;
+        point->achieved = (double)(length * params->length) * 8 / elapsed / BILLION;
+    }
+
+    free(latencies);
+    free(posts);
+}
+
+/**
+ * Run one pass per offered load; points must hold one entry per load.
+ */
+int load_sweep(struct rdma_cm_id *id, struct dccs_request *requests, struct dccs_parameters *params,
+               double *loads, size_t load_count, struct dccs_load_point *points) {
+    uint64_t *intended = malloc(params->count * sizeof(uint64_t));
+    int failed_count = 0;
+
+    srand48((long)get_cycles());
+    for (size_t k = 0; k < load_count; k++) {
+        log_info("Offering %.3f Gbps ...\n", loads[k]);
+
+        // Leave time to finish setting up before the first arrival.
+        dccs_load_arrivals(intended, params->count, params, loads[k], get_cycles() + usec_to_cycles(LOAD_START_DELAY));
+        int rv = load_send_requests(id, requests, intended, params);
+        if (rv < 0)
+            failed_count -= rv;
+
+        dccs_load_summarize(points + k, requests, intended, params, loads[k]);
+    }
+
+    free(intended);
+    return -failed_count;
+}
+
+void print_load_report(struct dccs_parameters *params, struct dccs_load_point *points, size_t load_count) {
+    char *arrival;
+    switch (params->arrival) {
+        case ARRIVAL_CONSTANT:
+            arrival = "constant";
+            break;
+        case ARRIVAL_POISSON:
+            arrival = "poisson";
+            break;
+        case ARRIVAL_ON_OFF:
+            arrival = "on/off";
+            break;
+        default:
+            arrival = "unknown";
+            break;
+    }
+
+    log_info("=====================\n");
+    log_info("Open-loop Load Report\n");
+    log_info("Arrivals: %s, requests per load = %zu, block size = %zu.\n", arrival, params->count, params->length);
+    log_info("offered (Gbps), achieved (Gbps), completed, failed, median (µsec), percent99 (µsec), "
+             "percent99.9 (µsec), max (µsec), uncorrected median (µsec), uncorrected percent99 (µsec)\n");
+    for (size_t k = 0; k < load_count; k++) {
+        struct dccs_load_point *point = points + k;
+        log_info("%.3f, %.3f, %zu, %zu, %.3f, %.3f, %.3f, %.3f, %.3f, %.3f\n", point->offered, point->achieved,
+                 point->completed, point->failed, point->median, point->percent99, point->percent999, point->max,
+                 point->post_median, point->post_percent99);
+    }
+    log_info("=====================\n\n");
+}
+
+#endif // DCCS_LOAD_H
@@ -0,0 +1,416 @@
+/**
+ * Full-mesh RC QPs set up without rdma_cm.
+ *
+ * Every host creates one RC QP per peer on a shared PD and CQs, publishes
+ * QPN/PSN/LID/GID for each of them through the bootstrap coordinator, and
+ * then moves all its QPs to RTS with ibv_modify_qp, spread over threads.
+ */
+
+#ifndef DCCS_MESH_H
+#define DCCS_MESH_H
+
+#include <endian.h>
+#include <pthread.h>
+#include <infiniband/verbs.h>
+
+#include "dccs_bootstrap.h"
+#include "dccs_utils.h"
+
+// Endpoint description, as sent over the wire (multi-byte fields in network order)
+struct dccs_qp_info {
+    uint32_t qpn;
+    uint32_t psn;
+    uint16_t lid;
+    uint8_t gid[16];
+    uint64_t addr;      // Region the peer may write into
+    uint32_t rkey;
+} __attribute__((packed));
+
+struct dccs_mesh {
+    struct ibv_context *context;
+    struct ibv_pd *pd;
+    struct ibv_cq *send_cq;
+    struct ibv_cq *recv_cq;
+    struct ibv_port_attr port_attr;
+    union ibv_gid gid;
+    int gid_index;
+    uint8_t tos;
+    uint8_t max_rd_atomic;
+
+    size_t rank;
+    size_t hosts;
+    struct ibv_qp **qps;            // One per peer, qps[rank] is NULL
+    struct dccs_qp_info *local;     // Published to each peer
+    struct dccs_qp_info *remote;    // Published by each peer for us
+
+    // Message buffer: one source region, then one landing region per peer
+    void *buf;
+    struct ibv_mr *mr;
+    size_t length;
+};
+
+/**
+ * Open the device (the first one if no name is given) and allocate the
+ * resources shared by all QPs.
+ */
+int dccs_mesh_open(struct dccs_mesh *mesh, const char *device, size_t rank, size_t hosts, int gid_index, uint8_t tos) {
+    struct ibv_device **devices;
+    struct ibv_device_attr device_attr;
+    int device_count;
+    int cq_depth = (int)(MAX_WR * (hosts > 1 ? hosts - 1 : 1));
+
+    memset(mesh, 0, sizeof *mesh);
+    mesh->rank = rank;
+    mesh->hosts = hosts;
+    mesh->gid_index = gid_index;
+    mesh->tos = tos;
+
+    if ((devices = ibv_get_device_list(&device_count)) == NULL || device_count == 0) {
+        log_error("No RDMA device found.\n");
+        return -1;
+    }
+
+    for (int n = 0; n < device_count; n++) {
+        if (device == NULL || strcmp(ibv_get_device_name(devices[n]), device) == 0) {
+            mesh->context = ibv_open_device(devices[n]);
+            break;
+        }
+    }
+
+    ibv_free_device_list(devices);
+    if (mesh->context == NULL) {
+        log_error("Failed to open RDMA device %s.\n", device == NULL ? "(default)" : device);
+        return -1;
+    }
+
+    if (ibv_query_device(mesh->context, &device_attr) != 0 ||
+            ibv_query_port(mesh->context, MESH_PORT_NUM, &mesh->port_attr) != 0 ||
+            ibv_query_gid(mesh->context, MESH_PORT_NUM, gid_index, &mesh->gid) != 0) {
+        log_perror("ibv_query_device/port/gid");
+        return -1;
+    }
+    mesh->max_rd_atomic = (uint8_t)(device_attr.max_qp_rd_atom < 16 ? device_attr.max_qp_rd_atom : 16);
+
+    if ((mesh->pd = ibv_alloc_pd(mesh->context)) == NULL) {
+        log_perror("ibv_alloc_pd");
+        return -1;
+    }
+
+    if ((mesh->send_cq = ibv_create_cq(mesh->context, cq_depth, NULL, NULL, 0)) == NULL ||
+            (mesh->recv_cq = ibv_create_cq(mesh->context, cq_depth, NULL, NULL, 0)) == NULL) {
+        log_perror("ibv_create_cq");
+        return -1;
+    }
+
+    mesh->qps = calloc(hosts, sizeof(struct ibv_qp *));
+    mesh->local = calloc(hosts, sizeof(struct dccs_qp_info));
+    mesh->remote = calloc(hosts, sizeof(struct dccs_qp_info));
+    return 0;
+}
+
+/**
+ * Register the message buffer, with room for one message from every peer.
+ */
+int dccs_mesh_register_buffer(struct dccs_mesh *mesh, size_t length) {
+    mesh->length = length;
+    if ((mesh->buf = malloc_random((mesh->hosts + 1) * length)) == NULL) {
+        log_error("Failed to allocate mesh buffer.\n");
+        return -1;
+    }
+
+    if ((mesh->mr = ibv_reg_mr(mesh->pd, mesh->buf, (mesh->hosts + 1) * length,
+                               IBV_ACCESS_LOCAL_WRITE | IBV_ACCESS_REMOTE_WRITE)) == NULL) {
+        log_perror("ibv_reg_mr");
+        return -1;
+    }
+
+    return 0;
+}
+
+static inline void *dccs_mesh_landing(struct dccs_mesh *mesh, size_t peer) {
+    return (uint8_t *)mesh->buf + (peer + 1) * mesh->length;
+}
+
+/**
+ * Post a signaled RDMA write of length bytes from the source region into
+ * our landing region at the peer.
+ */
+static inline int dccs_mesh_write(struct dccs_mesh *mesh, size_t peer, size_t length, uint64_t wr_id) {
+    struct ibv_send_wr wr, *bad_wr;
+    struct ibv_sge sge;
+    int rv;
+
+    sge.addr = (uint64_t)(uintptr_t)mesh->buf;
+    sge.length = (uint32_t)length;
+    sge.lkey = mesh->mr->lkey;
+
+    memset(&wr, 0, sizeof wr);
+    wr.wr_id = wr_id;
+    wr.sg_list = &sge;
+    wr.num_sge = 1;
+    wr.opcode = IBV_WR_RDMA_WRITE;
+    wr.send_flags = IBV_SEND_SIGNALED;
+    wr.wr.rdma.remote_addr = be64toh(mesh->remote[peer].addr);
+    wr.wr.rdma.rkey = ntohl(mesh->remote[peer].rkey);
+
+    if ((rv = ibv_post_send(mesh->qps[peer], &wr, &bad_wr)) != 0)
+        log_error("ibv_post_send() failed, error = %d.\n", rv);
+
+    return rv;
+}
+
+/**
+ * Create an RC QP in INIT state for every peer and describe it in mesh->local.
+ */
+int dccs_mesh_create_qps(struct dccs_mesh *mesh) {
+    struct ibv_qp_init_attr init_attr;
+    struct ibv_qp_attr attr;
+
+    memset(&init_attr, 0, sizeof init_attr);
+    init_attr.send_cq = mesh->send_cq;
+    init_attr.recv_cq = mesh->recv_cq;
+    init_attr.cap.max_send_wr = init_attr.cap.max_recv_wr = MAX_WR;
+    init_attr.cap.max_send_sge = init_attr.cap.max_recv_sge = 1;
+    init_attr.qp_type = IBV_QPT_RC;
+
+    memset(&attr, 0, sizeof attr);
+    attr.qp_state = IBV_QPS_INIT;
+    attr.pkey_index = 0;
+    attr.port_num = MESH_PORT_NUM;
+    attr.qp_access_flags = IBV_ACCESS_LOCAL_WRITE | IBV_ACCESS_REMOTE_READ |
+                           IBV_ACCESS_REMOTE_WRITE | IBV_ACCESS_REMOTE_ATOMIC;
+
+    srand48((long)(get_cycles() ^ mesh->rank));
+    for (size_t peer = 0; peer < mesh->hosts; peer++) {
+        if (peer == mesh->rank)
+            continue;
+
+        struct ibv_qp *qp = ibv_create_qp(mesh->pd, &init_attr);
+        if (qp == NULL) {
+            log_perror("ibv_create_qp");
+            return -1;
+        }
+
+        mesh->qps[peer] = qp;
+        if (ibv_modify_qp(qp, &attr, IBV_QP_STATE | IBV_QP_PKEY_INDEX | IBV_QP_PORT | IBV_QP_ACCESS_FLAGS) != 0) {
+            log_perror("ibv_modify_qp(INIT)");
+            return -1;
+        }
+
+        struct dccs_qp_info *info = mesh->local + peer;
+        info->qpn = htonl(qp->qp_num);
+        info->psn = htonl((uint32_t)lrand48() & 0xffffff);
+        info->lid = htons(mesh->port_attr.lid);
+        memcpy(info->gid, mesh->gid.raw, sizeof info->gid);
+        if (mesh->mr != NULL) {
+            info->addr = htobe64((uint64_t)(uintptr_t)dccs_mesh_landing(mesh, peer));
+            info->rkey = htonl(mesh->mr->rkey);
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * Move the QP towards a peer through RTR to RTS.
+ */
+int dccs_mesh_connect_qp(struct dccs_mesh *mesh, size_t peer) {
+    struct dccs_qp_info *local = mesh->local + peer;
+    struct dccs_qp_info *remote = mesh->remote + peer;
+    struct ibv_qp *qp = mesh->qps[peer];
+    struct ibv_qp_attr attr;
+
+    memset(&attr, 0, sizeof attr);
+    attr.qp_state = IBV_QPS_RTR;
+    attr.path_mtu = mesh->port_attr.active_mtu;
+    attr.dest_qp_num = ntohl(remote->qpn);
+    attr.rq_psn = ntohl(remote->psn);
+    attr.max_dest_rd_atomic = mesh->max_rd_atomic;
+    attr.min_rnr_timer = MESH_MIN_RNR_TIMER;
+    attr.ah_attr.dlid = ntohs(remote->lid);
+    attr.ah_attr.port_num = MESH_PORT_NUM;
+    if (mesh->port_attr.link_layer == IBV_LINK_LAYER_ETHERNET) {
+        // RoCE always routes through the GRH.
+        attr.ah_attr.is_global = 1;
+        memcpy(attr.ah_attr.grh.dgid.raw, remote->gid, sizeof remote->gid);
+        attr.ah_attr.grh.sgid_index = (uint8_t)mesh->gid_index;
+        attr.ah_attr.grh.hop_limit = MESH_HOP_LIMIT;
+        attr.ah_attr.grh.traffic_class = mesh->tos;
+    }
+
+    if (ibv_modify_qp(qp, &attr, IBV_QP_STATE | IBV_QP_AV | IBV_QP_PATH_MTU | IBV_QP_DEST_QPN |
+                      IBV_QP_RQ_PSN | IBV_QP_MAX_DEST_RD_ATOMIC | IBV_QP_MIN_RNR_TIMER) != 0) {
+        log_perror("ibv_modify_qp(RTR)");
+        return -1;
+    }
+
+    memset(&attr, 0, sizeof attr);
+    attr.qp_state = IBV_QPS_RTS;
+    attr.timeout = MESH_TIMEOUT;
+    attr.retry_cnt = 7;
+    attr.rnr_retry = 7;     // Infinite
+    attr.sq_psn = ntohl(local->psn);
+    attr.max_rd_atomic = mesh->max_rd_atomic;
+
+    if (ibv_modify_qp(qp, &attr, IBV_QP_STATE | IBV_QP_TIMEOUT | IBV_QP_RETRY_CNT |
+                      IBV_QP_RNR_RETRY | IBV_QP_SQ_PSN | IBV_QP_MAX_QP_RD_ATOMIC) != 0) {
+        log_perror("ibv_modify_qp(RTS)");
+        return -1;
+    }
+
+    return 0;
+}
+
+struct dccs_mesh_worker {
+    pthread_t thread;
+    struct dccs_mesh *mesh;
+    size_t first;
+    size_t stride;
+    int failed_count;
+};
+
+static void *dccs_mesh_connect_worker(void *arg) {
+    struct dccs_mesh_worker *worker = arg;
+    struct dccs_mesh *mesh = worker->mesh;
+
+    for (size_t peer = worker->first; peer < mesh->hosts; peer += worker->stride) {
+        if (peer != mesh->rank && dccs_mesh_connect_qp(mesh, peer) != 0)
+            worker->failed_count++;
+    }
+
+    return NULL;
+}
+
+/**
+ * Connect all QPs, each of the threads taking every threads-th peer.
+ * The modify calls are independent driver round trips, so they overlap well.
+ */
+int dccs_mesh_connect_all(struct dccs_mesh *mesh, size_t threads) {
+    struct dccs_mesh_worker *workers = calloc(threads, sizeof(struct dccs_mesh_worker));
+    int failed_count = 0;
+
+    for (size_t n = 0; n < threads; n++) {
+        workers[n].mesh = mesh;
+        workers[n].first = n;
+        workers[n].stride = threads;
+        if (threads == 1) {
+            dccs_mesh_connect_worker(workers + n);
+        } else if (pthread_create(&workers[n].thread, NULL, dccs_mesh_connect_worker, workers + n) != 0) {
+            log_perror("pthread_create");
+            failed_count++;
+            workers[n].stride = 0;
+        }
+    }
+
+    for (size_t n = 0; n < threads; n++) {
+        if (threads > 1 && workers[n].stride != 0)
+            pthread_join(workers[n].thread, NULL);
+        failed_count += workers[n].failed_count;
+    }
+
+    free(workers);
+    return -failed_count;
+}
+
+/**
+ * Check every QP of the mesh by sending our rank to each peer.
+ * The barrier makes sure every receive is posted before any send.
+ */
+int dccs_mesh_verify(struct dccs_mesh *mesh, struct dccs_bootstrap *bs) {
+    size_t peers = mesh->hosts - 1;
+    uint32_t *ranks = calloc(2 * mesh->hosts, sizeof(uint32_t));
+    uint32_t *recvd = ranks + mesh->hosts;
+    struct ibv_mr *mr;
+    struct ibv_wc wc;
+    int failed_count = 0;
+
+    memset(&wc, 0, sizeof wc);
+    if ((mr = ibv_reg_mr(mesh->pd, ranks, 2 * mesh->hosts * sizeof(uint32_t), IBV_ACCESS_LOCAL_WRITE)) == NULL) {
+        log_perror("ibv_reg_mr");
+        free(ranks);
+        return -1;
+    }
+
+    for (size_t peer = 0; peer < mesh->hosts; peer++) {
+        struct ibv_recv_wr wr, *bad_wr;
+        struct ibv_sge sge;
+        if (peer == mesh->rank)
+            continue;
+
+        ranks[peer] = htonl((uint32_t)mesh->rank);
+        sge.addr = (uint64_t)(uintptr_t)(recvd + peer);
+        sge.length = sizeof(uint32_t);
+        sge.lkey = mr->lkey;
+        memset(&wr, 0, sizeof wr);
+        wr.wr_id = peer;
+        wr.sg_list = &sge;
+        wr.num_sge = 1;
+        if (ibv_post_recv(mesh->qps[peer], &wr, &bad_wr) != 0)
+            failed_count++;
+    }
+
+    if (dccs_bootstrap_barrier(bs) != 0)
+        failed_count++;
+
+    for (size_t peer = 0; peer < mesh->hosts; peer++) {
+        struct ibv_send_wr wr, *bad_wr;
+        struct ibv_sge sge;
+        if (peer == mesh->rank)
+            continue;
+
+        sge.addr = (uint64_t)(uintptr_t)(ranks + peer);
+        sge.length = sizeof(uint32_t);
+        sge.lkey = mr->lkey;
+        memset(&wr, 0, sizeof wr);
+        wr.wr_id = peer;
+        wr.sg_list = &sge;
+        wr.num_sge = 1;
+        wr.opcode = IBV_WR_SEND;
+        wr.send_flags = IBV_SEND_SIGNALED;
+        if (ibv_post_send(mesh->qps[peer], &wr, &bad_wr) != 0)
+            failed_count++;
+    }
+
+    for (size_t done = 0; done < 2 * peers && failed_count == 0; ) {
+        int rv = ibv_poll_cq(done < peers ? mesh->send_cq : mesh->recv_cq, 1, &wc);
+        if (rv < 0 || (rv > 0 && wc.status != IBV_WC_SUCCESS)) {
+            log_error("Mesh verification failed on peer %d: %s.\n", (int)wc.wr_id,
+                      rv < 0 ? "poll error" : ibv_wc_status_str(wc.status));
+            failed_count++;
+        } else if (rv > 0 && done++ >= peers && ntohl(recvd[wc.wr_id]) != wc.wr_id) {
+            log_error("Peer %d identified as rank %u.\n", (int)wc.wr_id, ntohl(recvd[wc.wr_id]));
+            failed_count++;
+        }
+    }
+
+    ibv_dereg_mr(mr);
+    free(ranks);
+    return -failed_count;
+}
+
+void dccs_mesh_close(struct dccs_mesh *mesh) {
+    if (mesh->qps != NULL) {
+        for (size_t peer = 0; peer < mesh->hosts; peer++) {
+            if (mesh->qps[peer] != NULL)
+                ibv_destroy_qp(mesh->qps[peer]);
+        }
+    }
+
+    if (mesh->mr != NULL)
+        ibv_dereg_mr(mesh->mr);
+    if (mesh->send_cq != NULL)
+        ibv_destroy_cq(mesh->send_cq);
+    if (mesh->recv_cq != NULL)
+        ibv_destroy_cq(mesh->recv_cq);
+    if (mesh->pd != NULL)
+        ibv_dealloc_pd(mesh->pd);
+    if (mesh->context != NULL)
+        ibv_close_device(mesh->context);
+
+    free(mesh->qps);
+    free(mesh->local);
+    free(mesh->remote);
+    free(mesh->buf);
+}
+
+#endif // DCCS_MESH_H
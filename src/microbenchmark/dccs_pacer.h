@@ -0,0 +1,114 @@
+/**
+ * Periodic pacing against absolute deadlines.
+ *
+ * Deadlines lie on a grid of period multiples from the clock epoch plus the
+ * slot phase, instead of "last wakeup + period", so being late once does not
+ * shift every later send. Waiting sleeps until shortly before a deadline and
+ * spins the rest of the way, which keeps the spin loop's precision without
+ * burning the whole period.
+ */
+
+#ifndef DCCS_PACER_H
+#define DCCS_PACER_H
+
+#include <sys/prctl.h>
+
+#include "dccs_utils.h"
+
+struct dccs_pacer {
+    uint64_t period;        // In cycles
+    uint64_t phase;
+    uint64_t spin;          // Spin for this long before each deadline
+    uint64_t deadline;      // Next deadline
+    size_t missed;          // Deadlines skipped after overrunning them
+
+    // Send-time error: actual post time minus deadline
+    double *jitters;        // In nsec
+    size_t count;
+    size_t capacity;
+    size_t histogram[PACER_HISTOGRAM_BINS + 1];
+};
+
+/**
+ * Prepare pacing for up to capacity sends with the slot period and phase.
+ * The first deadline is at least one period away.
+ */
+void dccs_pacer_init(struct dccs_pacer *p, struct dccs_parameters *params, size_t capacity) {
+    memset(p, 0, sizeof *p);
+    p->period = usec_to_cycles(params->slot_period);
+    p->phase = usec_to_cycles(params->slot_phase);
+    p->spin = usec_to_cycles(params->pace_spin);
+    p->capacity = capacity;
+    p->jitters = malloc(capacity * sizeof(double));
+
+    // Default timer slack adds ~50 µsec to every sleep.
+    if (prctl(PR_SET_TIMERSLACK, 1UL, 0, 0, 0) != 0)
+        log_perror("prctl");
+
+    uint64_t now = get_cycles();
+    p->deadline = p->phase + ((now - p->phase) / p->period + 2) * p->period;
+}
+
+/**
+ * Sleep, then spin until the current deadline, and return it.
+ */
+uint64_t dccs_pacer_wait(struct dccs_pacer *p) {
+    uint64_t now = get_cycles();
+    if (now + p->spin < p->deadline) {
+        uint64_t nsec = (uint64_t)cycles_to_nsec(p->deadline - p->spin - now);
+        struct timespec ts = { .tv_sec = (time_t)(nsec / BILLION), .tv_nsec = (long)(nsec % BILLION) };
+        nanosleep(&ts, NULL);
+    }
+
+    while (get_cycles() < p->deadline);
+    return p->deadline;
+}
+
+/**
+ * Record when the send for the current deadline was posted, and move on to
+ * the next deadline on the grid, skipping those already past.
+ */
+void dccs_pacer_record(struct dccs_pacer *p, uint64_t posted) {
+    double jitter = cycles_to_nsec(posted - p->deadline);
+    if (p->count < p->capacity)
+        p->jitters[p->count++] = jitter;
+
+    size_t bin = (size_t)(jitter / PACER_HISTOGRAM_BIN_NSEC);
+    p->histogram[bin < PACER_HISTOGRAM_BINS ? bin : PACER_HISTOGRAM_BINS]++;
+
+    uint64_t now = get_cycles();
+    uint64_t skipped = now > p->deadline ? (now - p->deadline) / p->period : 0;
+    p->missed += skipped;
+    p->deadline += (skipped + 1) * p->period;
+}
+
+void dccs_pacer_free(struct dccs_pacer *p) {
+    free(p->jitters);
+    p->jitters = NULL;
+}
+
+void print_pacer_report(struct dccs_pacer *p) {
+    if (p->count == 0)
+        return;
+
+    sort_latencies(p->jitters, p->count);
+
+    log_info("=====================\n");
+    log_info("Send-time Jitter Report\n");
+    log_info("period (µsec), sends, missed deadlines, median (ns), percent99 (ns), max (ns)\n");
+    log_info("%.3f, %zu, %zu, %.0f, %.0f, %.0f\n", (double)p->period * MILLION / (double)clock_rate,
+             p->count, p->missed, p->jitters[p->count / 2],
+             p->jitters[(size_t)((double)p->count * 0.99)], p->jitters[p->count - 1]);
+    log_info("Histogram (ns): bucket, sends\n");
+    for (size_t bin = 0; bin < PACER_HISTOGRAM_BINS; bin++) {
+        if (p->histogram[bin] != 0)
+            log_info("[%d, %d), %zu\n", (int)bin * PACER_HISTOGRAM_BIN_NSEC,
+                     (int)(bin + 1) * PACER_HISTOGRAM_BIN_NSEC, p->histogram[bin]);
+    }
+    if (p->histogram[PACER_HISTOGRAM_BINS] != 0)
+        log_info("[%d, inf), %zu\n", PACER_HISTOGRAM_BINS * PACER_HISTOGRAM_BIN_NSEC,
+                 p->histogram[PACER_HISTOGRAM_BINS]);
+    log_info("=====================\n\n");
+}
+
+#endif // DCCS_PACER_H
@@ -10,10 +10,16 @@
 #include <rdma/rdma_cma.h>
 #include <rdma/rdma_verbs.h>
 
-typedef enum { None, Send, Read, Write } Verb;
-typedef enum { MODE_LATENCY, MODE_THROUGHPUT } Mode;
+typedef enum { None, Send, Read, Write, FetchAdd, CompSwap, WriteImm } Verb;
+typedef enum { MODE_LATENCY, MODE_THROUGHPUT, MODE_OPEN_LOOP } Mode;
 typedef enum { DIR_OUT, DIR_IN, DIR_BOTH } Direction;
 typedef enum { ROLE_CLIENT, ROLE_SERVER } Role;
+typedef enum { TRANSPORT_RC, TRANSPORT_UD } Transport;
+typedef enum { ARRIVAL_CONSTANT, ARRIVAL_POISSON, ARRIVAL_ON_OFF } Arrival;
+typedef enum { PATTERN_NONE, PATTERN_PERMUTATION, PATTERN_INCAST, PATTERN_SHUFFLE, PATTERN_FILE } Pattern;
+typedef enum { RMA_NONE, RMA_FENCE, RMA_PSCW, RMA_PASSIVE } RmaSync;
+typedef enum { DIGEST_SHA1, DIGEST_CRC32C } Digest;
+typedef enum { BACKEND_VERBS, BACKEND_MPI, BACKEND_DAEMON } Backend;
 
 struct dccs_mr_info{
     uint64_t addr;
@@ -35,6 +41,45 @@ struct dccs_parameters {
     uint16_t index;
     uint8_t tos;
     uint8_t slot;
+    size_t atomic_words;
+    size_t sge;
+    bool sge_copy;
+    Transport transport;
+    size_t peers;
+    size_t hosts;
+    size_t threads;
+    char *device;
+    int gid_index;
+    bool scheduled;
+    double slot_period;
+    double slot_uptime;
+    double slot_guard;
+    double slot_phase;
+    size_t slots;
+    bool rotor;
+    char *matching;
+    double pace_spin;
+    Arrival arrival;
+    char *load;
+    double on_time;
+    double off_time;
+    Pattern pattern;
+    char *traffic_file;
+    size_t fanin;
+    char *sizes;
+    unsigned long seed;
+    char *classes;
+    double rate;
+    size_t burst;
+    bool rate_hw;
+    size_t window;
+    bool persistent;
+    char *collectives;
+    RmaSync rma;
+    bool thread_multiple;
+    Digest digest;
+    Backend backend;
+    char *shm_name;
     bool verbose;
 };
 
@@ -50,6 +95,17 @@ struct dccs_request {
     uint64_t remote_addr;
     uint32_t remote_rkey;
 
+    // Scatter-gather segments, when a message spans several regions.
+    // With sge_copy, buf is a contiguous staging copy of the segments.
+    struct ibv_sge *sg_list;
+    int num_sge;
+    bool sge_copy;
+    uint64_t copy_cycles;
+
+    // Operands for RDMA atomics
+    uint64_t compare_add;
+    uint64_t swap;
+
     // Timing information
     uint64_t start;
     uint64_t end;
@@ -0,0 +1,187 @@
+/**
+ * Injection rate limiting for one QP.
+ *
+ * In software, a token bucket filled at the target rate and holding up to
+ * burst bytes gates every post: a request waits, spinning, until the bucket
+ * holds its length. In hardware, the same rate and burst are handed to the
+ * NIC with ibv_modify_qp_rate_limit() and requests are posted as fast as the
+ * send queue allows. Either way every request is signaled, so that both post
+ * and completion gaps can be compared against the nominal gap.
+ */
+
+#ifndef DCCS_RATE_H
+#define DCCS_RATE_H
+
+#include "dccs_rdma.h"
+
+#define RATE_POLL_BATCH 16
+
+struct dccs_rate {
+    double gbps;
+    double rate;        // Bytes per cycle
+    double burst;       // Bucket depth, in bytes
+    double tokens;
+    uint64_t last;      // Last refill
+    bool hardware;
+
+    // Last run
+    uint64_t begin;
+    uint64_t end;
+};
+
+/**
+ * Set up a bucket for gbps, full to begin with. With hardware set, try to
+ * program the QP instead and fall back to software if the device refuses.
+ */
+void dccs_rate_init(struct dccs_rate *r, struct ibv_qp *qp, double gbps, size_t burst, size_t length, bool hardware) {
+    memset(r, 0, sizeof *r);
+    r->gbps = gbps;
+    r->rate = gbps * BILLION / 8 / (double)clock_rate;
+    r->burst = (double)(burst < length ? length : burst);
+    r->tokens = r->burst;
+
+    if (hardware) {
+        struct ibv_qp_rate_limit_attr attr;
+        int rv;
+
+        memset(&attr, 0, sizeof attr);
+        attr.rate_limit = (uint32_t)(gbps * MILLION);     // In kbps
+        attr.max_burst_sz = (uint32_t)r->burst;
+        attr.typical_pkt_sz = (uint16_t)(length < UINT16_MAX ? length : UINT16_MAX);
+        if ((rv = ibv_modify_qp_rate_limit(qp, &attr)) != 0) {
+            log_warning("ibv_modify_qp_rate_limit() failed, error = %d; pacing in software.\n", rv);
+        } else {
+            r->hardware = true;
+        }
+    }
+}
+
+/**
+ * Wait until the bucket holds length bytes, and take them.
+ */
+static inline void dccs_rate_wait(struct dccs_rate *r, size_t length) {
+    uint64_t now = get_cycles();
+    if (r->last == 0)
+        r->last = now;
+
+    while (true) {
+        r->tokens += (double)(now - r->last) * r->rate;
+        if (r->tokens > r->burst)
+            r->tokens = r->burst;
+        r->last = now;
+        if (r->tokens >= (double)length)
+            break;
+        now = get_cycles();
+    }
+
+    r->tokens -= (double)length;
+}
+
+/**
+ * Post every request with up to MAX_WR in flight (one in latency mode),
+ * paced by the bucket unless the NIC enforces the rate.
+ */
+int rate_send_requests(struct rdma_cm_id *id, struct dccs_request *requests, struct dccs_parameters *params,
+                       struct dccs_rate *r) {
+    struct ibv_wc wc[RATE_POLL_BATCH];
+    size_t depth = params->mode == MODE_LATENCY ? 1 : MAX_WR;
+    size_t posted = 0, completed = 0;
+    int failed_count = 0;
+
+    r->last = 0;
+    r->tokens = r->burst;
+    r->begin = get_cycles();
+    while (completed < params->count) {
+        while (posted < params->count && posted - completed < depth) {
+            struct dccs_request *request = requests + posted;
+            if (!r->hardware)
+                dccs_rate_wait(r, request->length);
+
+            if (dccs_post_request(id, request, posted, IBV_SEND_SIGNALED) != 0) {
+                // Later completions could no longer be matched to requests.
+                log_error("Failed to post request %zu.\n", posted);
+                failed_count += (int)(params->count - completed);
+                goto out;
+            }
+            request->start = get_cycles();
+            posted++;
+
+            // Keep polling while the bucket refills.
+            if (!r->hardware)
+                break;
+        }
+
+        int rv = ibv_poll_cq(id->send_cq, RATE_POLL_BATCH, wc);
+        if (rv < 0) {
+            log_error("ibv_poll_cq() failed, error = %d.\n", rv);
+            failed_count += (int)(params->count - completed);
+            break;
+        }
+
+        uint64_t t = get_cycles();
+        for (int k = 0; k < rv; k++) {
+            requests[completed++].end = t;
+            if (wc[k].status != IBV_WC_SUCCESS) {
+                log_error("Failed status %s (%d) for request %zu\n",
+                    ibv_wc_status_str(wc[k].status), wc[k].status, completed - 1);
+                failed_count++;
+            }
+        }
+    }
+
+out:
+    r->end = get_cycles();
+    return -failed_count;
+}
+
+static void rate_gap_stats(double *gaps, size_t length, double nominal, double *median, double *percent99,
+                           double *jitter) {
+    double sumsq = 0;
+    for (size_t n = 0; n < length; n++)
+        sumsq += (gaps[n] - nominal) * (gaps[n] - nominal);
+
+    sort_latencies(gaps, length);
+    *median = gaps[length / 2];
+    *percent99 = gaps[(size_t)((double)length * 0.99)];
+    *jitter = sqrt(sumsq / (double)length);
+}
+
+/**
+ * Print achieved against target rate, and how far the gaps between posts and
+ * between completions stray from the nominal gap (RMS deviation as jitter).
+ */
+void print_rate_report(struct dccs_parameters *params, struct dccs_request *requests, struct dccs_rate *r) {
+    size_t count = params->count;
+    if (count < 2 || requests[count - 1].end == 0)
+        return;
+
+    double *posts = malloc((count - 1) * sizeof(double));
+    double *completions = malloc((count - 1) * sizeof(double));
+    double nominal = (double)params->length * 8 / r->gbps / 1e3;     // In µsec
+    for (size_t n = 1; n < count; n++) {
+        posts[n - 1] = (double)(requests[n].start - requests[n - 1].start) * MILLION / (double)clock_rate;
+        completions[n - 1] = (double)(requests[n].end - requests[n - 1].end) * MILLION / (double)clock_rate;
+    }
+
+    double elapsed = (double)(requests[count - 1].end - requests[0].start) / (double)clock_rate;
+    double achieved = (double)(count * params->length) * 8 / elapsed / BILLION;
+    double post_median, post_percent99, post_jitter;
+    double comp_median, comp_percent99, comp_jitter;
+    rate_gap_stats(posts, count - 1, nominal, &post_median, &post_percent99, &post_jitter);
+    rate_gap_stats(completions, count - 1, nominal, &comp_median, &comp_percent99, &comp_jitter);
+
+    log_info("=====================\n");
+    log_info("Rate Limit Report\n");
+    log_info("method, target (Gbps), achieved (Gbps), burst (B), nominal gap (µsec)\n");
+    log_info("%s, %.3f, %.3f, %.0f, %.3f\n", r->hardware ? "hardware" : "software", r->gbps, achieved,
+             r->burst, nominal);
+    log_info("gap, median (µsec), percent99 (µsec), jitter (µsec)\n");
+    log_info("post, %.3f, %.3f, %.3f\n", post_median, post_percent99, post_jitter);
+    log_info("completion, %.3f, %.3f, %.3f\n", comp_median, comp_percent99, comp_jitter);
+    log_info("=====================\n\n");
+
+    free(posts);
+    free(completions);
+}
+
+#endif // DCCS_RATE_H
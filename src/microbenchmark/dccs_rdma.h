@@ -39,7 +39,7 @@ log_debug("Setting tos to %hhu\n", tos);
     return rv;
 }
 
-int dccs_connect(struct rdma_cm_id **id, char *server, char *port, uint8_t tos) {
+int dccs_connect(struct rdma_cm_id **id, char *server, char *port, uint8_t tos, uint32_t max_sge) {
     struct rdma_addrinfo *res;
     struct rdma_addrinfo hints;
     struct ibv_qp_init_attr attr;
@@ -54,6 +54,7 @@ int dccs_connect(struct rdma_cm_id **id, char *server, char *port, uint8_t tos)
 
     memset(&attr, 0, sizeof attr);
     attr.cap.max_send_wr = attr.cap.max_recv_wr = MAX_WR;
+    attr.cap.max_send_sge = attr.cap.max_recv_sge = max_sge;
     attr.qp_context = *id;
     attr.qp_type = IBV_QPT_RC;
 
@@ -82,7 +83,26 @@ end:
     return rv;
 }
 
-int dccs_listen(struct rdma_cm_id **listen_id, struct rdma_cm_id **id, char *port) {
+/**
+ * Accept the next connection on a listening endpoint.
+ */
+int dccs_accept(struct rdma_cm_id *listen_id, struct rdma_cm_id **id) {
+    int rv;
+
+    if ((rv = rdma_get_request(listen_id, id)) != 0) {
+        log_perror("rdma_get_request");
+        return rv;
+    }
+
+    if ((rv = rdma_accept(*id, NULL)) != 0) {
+        log_perror("rdma_accept");
+        rdma_destroy_ep(*id);
+    }
+
+    return rv;
+}
+
+int dccs_listen(struct rdma_cm_id **listen_id, struct rdma_cm_id **id, char *port, uint32_t max_sge) {
     struct rdma_addrinfo *res;
     struct rdma_addrinfo hints;
     struct ibv_qp_init_attr attr;
@@ -98,6 +118,7 @@ int dccs_listen(struct rdma_cm_id **listen_id, struct rdma_cm_id **id, char *por
 
     memset(&attr, 0, sizeof attr);
     attr.cap.max_send_wr = attr.cap.max_recv_wr = MAX_WR;
+    attr.cap.max_send_sge = attr.cap.max_recv_sge = max_sge;
     attr.qp_type = IBV_QPT_RC;
     
     if ((rv = rdma_create_ep(listen_id, res, NULL, &attr)) != 0) {
@@ -110,23 +131,14 @@ int dccs_listen(struct rdma_cm_id **listen_id, struct rdma_cm_id **id, char *por
         goto out_destroy_listen_ep;
     }
 
-    if ((rv = rdma_get_request(*listen_id, id)) != 0) {
-        log_perror("rdma_get_request");
-        goto out_destroy_listen_ep;
-    }
-
     // need ibv_query_qp?
 
-    if ((rv = rdma_accept(*id, NULL)) != 0) {
-        log_perror("rdma_accept");
-        goto out_destroy_accept_ep;
-    }
+    if ((rv = dccs_accept(*listen_id, id)) != 0)
+        goto out_destroy_listen_ep;
 
     rdma_freeaddrinfo(res);
     return 0;
 
-out_destroy_accept_ep:
-    rdma_destroy_ep(*id);
 out_destroy_listen_ep:
     rdma_destroy_ep(*listen_id);
 out_free_addrinfo:
@@ -175,6 +187,21 @@ struct ibv_mr * dccs_reg_write(struct rdma_cm_id *id, void *addr, size_t length)
     return mr;
 }
 
+/**
+ * Register a buffer as the target (and local result buffer) of RDMA atomics.
+ * librdmacm has no helper granting remote atomic access, so go through verbs.
+ */
+struct ibv_mr * dccs_reg_atomic(struct rdma_cm_id *id, void *addr, size_t length) {
+    struct ibv_mr *mr;
+    unsigned int access = IBV_ACCESS_LOCAL_WRITE | IBV_ACCESS_REMOTE_READ |
+                 IBV_ACCESS_REMOTE_WRITE | IBV_ACCESS_REMOTE_ATOMIC;
+    if ((mr = ibv_reg_mr(id->pd, addr, length, access)) == NULL) {
+        log_perror("ibv_reg_mr");
+    }
+
+    return mr;
+}
+
 void dccs_dereg_mr(struct ibv_mr *mr) {
     rdma_dereg_mr(mr);
 }
@@ -197,6 +224,15 @@ static inline int dccs_rdma_send(struct rdma_cm_id *id, void *addr, size_t lengt
     return dccs_rdma_send_with_flags(id, addr, length, mr, IBV_SEND_SIGNALED);
 }
 
+int dccs_rdma_sendv_with_flags(struct rdma_cm_id *id, struct ibv_sge *sgl, int nsge, int flags) {
+    int rv;
+    if ((rv = rdma_post_sendv(id, NULL, sgl, nsge, flags)) != 0) {
+        log_perror("rdma_post_sendv");
+    }
+
+    return rv;
+}
+
 int dccs_rdma_recv(struct rdma_cm_id *id, void *addr, size_t length, struct ibv_mr *mr) {
     int rv;
     //log_debug("RDMA recv ...\n");
@@ -208,6 +244,15 @@ int dccs_rdma_recv(struct rdma_cm_id *id, void *addr, size_t length, struct ibv_
     return rv;
 }
 
+int dccs_rdma_recvv(struct rdma_cm_id *id, struct ibv_sge *sgl, int nsge) {
+    int rv;
+    if ((rv = rdma_post_recvv(id, NULL, sgl, nsge)) != 0) {
+        log_perror("rdma_post_recvv");
+    }
+
+    return rv;
+}
+
 int dccs_rdma_read_with_flags(struct rdma_cm_id *id, void *addr, size_t length, struct ibv_mr *mr, uint64_t remote_addr, uint32_t rkey, int flags) {
     int rv;
     //log_debug("RDMA read ...\n");
@@ -223,6 +268,15 @@ static inline int dccs_rdma_read(struct rdma_cm_id *id, void *addr, size_t lengt
     return dccs_rdma_read_with_flags(id, addr, length, mr, remote_addr, rkey, IBV_SEND_SIGNALED);
 }
 
+int dccs_rdma_readv_with_flags(struct rdma_cm_id *id, struct ibv_sge *sgl, int nsge, uint64_t remote_addr, uint32_t rkey, int flags) {
+    int rv;
+    if ((rv = rdma_post_readv(id, NULL, sgl, nsge, flags, remote_addr, rkey)) != 0) {
+        log_perror("rdma_post_readv");
+    }
+
+    return rv;
+}
+
 int dccs_rdma_write_with_flags(struct rdma_cm_id *id, void *addr, size_t length, struct ibv_mr *mr, uint64_t remote_addr, uint32_t rkey, int flags) {
     int rv;
     // log_debug("RDMA write ...\n");
@@ -238,6 +292,181 @@ static inline int dccs_rdma_write(struct rdma_cm_id *id, void *addr, size_t leng
     return dccs_rdma_write_with_flags(id, addr, length, mr, remote_addr, rkey, IBV_SEND_SIGNALED);
 }
 
+int dccs_rdma_writev_with_flags(struct rdma_cm_id *id, struct ibv_sge *sgl, int nsge, uint64_t remote_addr, uint32_t rkey, int flags) {
+    int rv;
+    if ((rv = rdma_post_writev(id, NULL, sgl, nsge, flags, remote_addr, rkey)) != 0) {
+        log_perror("rdma_post_writev");
+    }
+
+    return rv;
+}
+
+/**
+ * Post an RDMA write carrying a 32-bit immediate (in network byte order),
+ * which consumes a receive on the responder and generates a completion there.
+ */
+int dccs_rdma_write_immv_with_flags(struct rdma_cm_id *id, struct ibv_sge *sgl, int nsge,
+                                    uint64_t remote_addr, uint32_t rkey, uint32_t imm_data, int flags) {
+    struct ibv_send_wr wr, *bad;
+    int rv;
+
+    memset(&wr, 0, sizeof wr);
+    wr.sg_list = sgl;
+    wr.num_sge = nsge;
+    wr.opcode = IBV_WR_RDMA_WRITE_WITH_IMM;
+    wr.send_flags = (unsigned int)flags;
+    wr.imm_data = imm_data;
+    wr.wr.rdma.remote_addr = remote_addr;
+    wr.wr.rdma.rkey = rkey;
+
+    if ((rv = ibv_post_send(id->qp, &wr, &bad)) != 0) {
+        log_error("ibv_post_send() failed, error = %d.\n", rv);
+    }
+
+    return rv;
+}
+
+static inline int dccs_rdma_write_imm_with_flags(struct rdma_cm_id *id, void *addr, size_t length, struct ibv_mr *mr,
+                                                 uint64_t remote_addr, uint32_t rkey, uint32_t imm_data, int flags) {
+    struct ibv_sge sge;
+
+    sge.addr = (uint64_t)(uintptr_t)addr;
+    sge.length = (uint32_t)length;
+    sge.lkey = mr->lkey;
+
+    return dccs_rdma_write_immv_with_flags(id, &sge, 1, remote_addr, rkey, imm_data, flags);
+}
+
+/**
+ * Post a receive without buffers, to be consumed by a write-with-immediate.
+ */
+int dccs_rdma_recv_imm(struct rdma_cm_id *id) {
+    int rv;
+    if ((rv = rdma_post_recvv(id, NULL, NULL, 0)) != 0) {
+        log_perror("rdma_post_recvv");
+    }
+
+    return rv;
+}
+
+/**
+ * Post an atomic fetch-and-add or compare-and-swap on a remote 64-bit word.
+ * The original remote value is written into the local 8-byte buffer.
+ */
+int dccs_rdma_atomic_with_flags(struct rdma_cm_id *id, void *addr, struct ibv_mr *mr, enum ibv_wr_opcode opcode,
+                                uint64_t remote_addr, uint32_t rkey, uint64_t compare_add, uint64_t swap, int flags) {
+    struct ibv_send_wr wr, *bad;
+    struct ibv_sge sge;
+    int rv;
+
+    sge.addr = (uint64_t)(uintptr_t)addr;
+    sge.length = ATOMIC_OPERAND_LENGTH;
+    sge.lkey = mr->lkey;
+
+    memset(&wr, 0, sizeof wr);
+    wr.sg_list = &sge;
+    wr.num_sge = 1;
+    wr.opcode = opcode;
+    wr.send_flags = (unsigned int)flags;
+    wr.wr.atomic.remote_addr = remote_addr;
+    wr.wr.atomic.rkey = rkey;
+    wr.wr.atomic.compare_add = compare_add;
+    wr.wr.atomic.swap = swap;
+
+    if ((rv = ibv_post_send(id->qp, &wr, &bad)) != 0) {
+        log_error("ibv_post_send() failed, error = %d.\n", rv);
+    }
+
+    return rv;
+}
+
+/**
+ * Post the atomic operation described by the request.
+ * CAS requests expect the value left behind by their previous attempt, so
+ * under contention the success rate reflects how often another requester won.
+ */
+static inline int dccs_rdma_atomic_request(struct rdma_cm_id *id, struct dccs_request *request, int flags) {
+    enum ibv_wr_opcode opcode;
+    if (request->verb == CompSwap) {
+        uint64_t observed = *(uint64_t *)request->buf;
+        request->compare_add = observed == request->compare_add ? request->swap : observed;
+        request->swap = request->compare_add + 1;
+        opcode = IBV_WR_ATOMIC_CMP_AND_SWP;
+    } else {
+        request->compare_add = ATOMIC_ADD_VALUE;
+        opcode = IBV_WR_ATOMIC_FETCH_AND_ADD;
+    }
+
+    return dccs_rdma_atomic_with_flags(id, request->buf, request->mr, opcode,
+                request->remote_addr, request->remote_rkey, request->compare_add, request->swap, flags);
+}
+
+/**
+ * Gather the segments of a request into its contiguous staging buffer.
+ */
+static inline void gather_segments(struct dccs_request *request) {
+    uint8_t *dst = request->buf;
+    for (int k = 0; k < request->num_sge; k++) {
+        struct ibv_sge *sge = request->sg_list + k;
+        memcpy(dst, (void *)(uintptr_t)sge->addr, sge->length);
+        dst += sge->length;
+    }
+}
+
+/**
+ * Scatter the contiguous staging buffer of a request into its segments.
+ */
+static inline void scatter_segments(struct dccs_request *request) {
+    uint8_t *src = request->buf;
+    for (int k = 0; k < request->num_sge; k++) {
+        struct ibv_sge *sge = request->sg_list + k;
+        memcpy((void *)(uintptr_t)sge->addr, src, sge->length);
+        src += sge->length;
+    }
+}
+
+/**
+ * Post a single request with its verb.
+ * Multi-segment requests are either gathered by the NIC from their SGE list,
+ * or copied by the CPU into the staging buffer first when sge_copy is set;
+ * the copy time is kept in copy_cycles. READ, whose data arrives rather than
+ * leaves, is never staged (parse_args() rejects it with sge_copy).
+ */
+int dccs_post_request(struct rdma_cm_id *id, struct dccs_request *request, size_t n, int flags) {
+    bool vectored = request->num_sge > 1 && !request->sge_copy;
+
+    if (request->num_sge > 1 && request->sge_copy) {
+        uint64_t t = get_cycles();
+        gather_segments(request);
+        request->copy_cycles = get_cycles() - t;
+    }
+
+    switch (request->verb) {
+        case Send:
+            if (vectored)
+                return dccs_rdma_sendv_with_flags(id, request->sg_list, request->num_sge, flags);
+            return dccs_rdma_send_with_flags(id, request->buf, request->length, request->mr, flags);
+        case Read:
+            if (vectored)
+                return dccs_rdma_readv_with_flags(id, request->sg_list, request->num_sge, request->remote_addr, request->remote_rkey, flags);
+            return dccs_rdma_read_with_flags(id, request->buf, request->length, request->mr, request->remote_addr, request->remote_rkey, flags);
+        case Write:
+            if (vectored)
+                return dccs_rdma_writev_with_flags(id, request->sg_list, request->num_sge, request->remote_addr, request->remote_rkey, flags);
+            return dccs_rdma_write_with_flags(id, request->buf, request->length, request->mr, request->remote_addr, request->remote_rkey, flags);
+        case WriteImm:
+            if (vectored)
+                return dccs_rdma_write_immv_with_flags(id, request->sg_list, request->num_sge, request->remote_addr, request->remote_rkey, htonl((uint32_t)n), flags);
+            return dccs_rdma_write_imm_with_flags(id, request->buf, request->length, request->mr, request->remote_addr, request->remote_rkey, htonl((uint32_t)n), flags);
+        case FetchAdd:
+        case CompSwap:
+            return dccs_rdma_atomic_request(id, request, flags);
+        default:
+            log_warning("Unrecognized request (n = %zu).", n);
+            return 0;
+    }
+}
+
 /* RDMA completion event */
 
 /**
@@ -303,6 +532,11 @@ int dccs_rdma_recv_comp(struct rdma_cm_id *id, struct ibv_wc *wc) {
 
 /**
  * Allocate and register multiple buffers.
+ *
+ * With more than one SGE, each MR is split into one region per segment, and
+ * segment k of every message lives in region k, so a message is scattered
+ * over non-contiguous memory. With sge_copy, a contiguous staging area is
+ * placed in front of the segment regions.
  */
 int allocate_buffer(struct rdma_cm_id *id, struct dccs_request *requests, struct dccs_parameters params) {
     Verb verb = params.verb;
@@ -310,6 +544,21 @@ int allocate_buffer(struct rdma_cm_id *id, struct dccs_request *requests, struct
     size_t length = params.length;
     size_t count_per_mr = count / params.mr_count;
     size_t buffer_length = count_per_mr * length;
+    size_t sge = params.sge;
+    size_t segment_length = length / sge;
+    size_t staging_length = 0;
+    struct ibv_sge *sg_lists = NULL;
+
+    if (sge > 1) {
+        if (params.sge_copy)
+            staging_length = buffer_length;
+        buffer_length += staging_length;
+        sg_lists = calloc(count * sge, sizeof(struct ibv_sge));
+        if (sg_lists == NULL) {
+            log_perror("calloc");
+            return -1;
+        }
+    }
 
     struct ibv_mr *mr = NULL;
     void *buf_base = NULL;
@@ -320,6 +569,12 @@ int allocate_buffer(struct rdma_cm_id *id, struct dccs_request *requests, struct
             buf_base = malloc_random(buffer_length);
 
             switch (verb) {
+                case FetchAdd:
+                case CompSwap:
+                    // Start counters and locks from a known state.
+                    memset(buf_base, 0, buffer_length);
+                    mr = dccs_reg_atomic(id, buf_base, buffer_length);
+                    break;
                 case Send:
                     mr = dccs_reg_msgs(id, buf_base, buffer_length);
                     break;
@@ -327,6 +582,7 @@ int allocate_buffer(struct rdma_cm_id *id, struct dccs_request *requests, struct
                     mr = dccs_reg_read(id, buf_base, buffer_length);
                     break;
                 case Write:
+                case WriteImm:
                     mr = dccs_reg_write(id, buf_base, buffer_length);
                     break;
                 default:
@@ -346,6 +602,24 @@ int allocate_buffer(struct rdma_cm_id *id, struct dccs_request *requests, struct
         request->buf = buf;
         request->length = length;
         request->mr = mr;
+
+        if (sge > 1) {
+            uint8_t *region = (uint8_t *)buf_base + staging_length;
+            request->sg_list = sg_lists + n * sge;
+            request->num_sge = (int)sge;
+            request->sge_copy = params.sge_copy;
+            for (size_t k = 0; k < sge; k++) {
+                struct ibv_sge *segment = request->sg_list + k;
+                size_t len = k == sge - 1 ? length - (sge - 1) * segment_length : segment_length;
+                segment->addr = (uint64_t)(uintptr_t)(region + offset * len);
+                segment->length = (uint32_t)len;
+                segment->lkey = mr->lkey;
+                region += count_per_mr * len;
+            }
+
+            if (!params.sge_copy)
+                request->buf = (void *)(uintptr_t)request->sg_list[0].addr;
+        }
     }
 
     return 0;
@@ -366,6 +640,24 @@ void deallocate_buffer(struct dccs_request *requests, struct dccs_parameters par
         dccs_dereg_mr(request->mr);
         free(request->buf);
     }
+
+    if (params.sge > 1)
+        free(requests[0].sg_list);
+}
+
+/**
+ * Point atomic requests at a subset of the remote words to control contention.
+ * With k atomic words, request n targets word n % k, so k = 1 makes every
+ * request hit the same word and k = count gives each request its own word.
+ */
+void assign_atomic_targets(struct dccs_request *requests, struct dccs_parameters params) {
+    size_t words = params.atomic_words == 0 ? params.count : params.atomic_words;
+
+    for (size_t n = 0; n < params.count; n++) {
+        struct dccs_request *target = requests + n % words;
+        requests[n].remote_addr = target->remote_addr;
+        requests[n].remote_rkey = target->remote_rkey;
+    }
 }
 
 /* Exchange MR information. */
@@ -618,29 +910,10 @@ int send_requests(struct rdma_cm_id *id, struct dccs_request *requests, size_t c
 
     for (size_t n = 0; n < count; n++) {
         struct dccs_request *request = requests + n;
-        switch (request->verb) {
-            case Send:
-                rv = dccs_rdma_send(id, request->buf, request->length, request->mr);
-                request->start = get_cycles();
-                if (rv != 0)
-                    failed_count++;
-                break;
-            case Read:
-                rv = dccs_rdma_read(id, request->buf, request->length, request->mr, request->remote_addr, request->remote_rkey);
-                request->start = get_cycles();
-                if (rv != 0)
-                    failed_count++;
-                break;
-            case Write:
-                rv = dccs_rdma_write(id, request->buf, request->length, request->mr, request->remote_addr, request->remote_rkey);
-                request->start = get_cycles();
-                if (rv != 0)
-                    failed_count++;
-                break;
-            default:
-                log_warning("Unrecognized request (n = %zu).", n);
-                break;
-        }
+        rv = dccs_post_request(id, request, n, IBV_SEND_SIGNALED);
+        request->start = get_cycles();
+        if (rv != 0)
+            failed_count++;
     }
 
     uint64_t end = get_cycles();
@@ -675,7 +948,10 @@ int recv_requests(struct rdma_cm_id *id, struct dccs_request *requests, struct d
 
     for (size_t n = 0; n < params->count; n++) {
         struct dccs_request *request = requests + n;
-        rv = dccs_rdma_recv(id, request->buf, request->length, request->mr);
+        if (request->num_sge > 1 && !request->sge_copy)
+            rv = dccs_rdma_recvv(id, request->sg_list, request->num_sge);
+        else
+            rv = dccs_rdma_recv(id, request->buf, request->length, request->mr);
         if (rv != 0) {
             log_error("Failed to recv messages.\n");
             ++failed_count;
@@ -685,6 +961,64 @@ int recv_requests(struct rdma_cm_id *id, struct dccs_request *requests, struct d
             log_error("Failed to recv messages.\n");
             ++failed_count;
         }
+
+        if (request->num_sge > 1 && request->sge_copy) {
+            uint64_t t = get_cycles();
+            scatter_segments(request);
+            request->copy_cycles = get_cycles() - t;
+        }
+    }
+
+    return -failed_count;
+}
+
+/**
+ * Fill the receive ring consumed by write-with-immediate requests.
+ */
+int post_imm_recv_ring(struct rdma_cm_id *id) {
+    for (size_t n = 0; n < IMM_RECV_RING_DEPTH; n++) {
+        if (dccs_rdma_recv_imm(id) != 0) {
+            log_error("Failed to post immediate receive ring.\n");
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * Consume one round of write-with-immediate completions.
+ * The immediate carries the request index, so the arrival time of each
+ * message is recorded in the matching request, and every consumed
+ * receive is replenished to keep the ring full.
+ */
+int recv_imm_requests(struct rdma_cm_id *id, struct dccs_request *requests, struct dccs_parameters *params) {
+    int rv;
+    int failed_count = 0;
+    struct ibv_wc wc;
+
+    for (size_t n = 0; n < params->count; n++)
+        requests[n].end = 0;
+
+    for (size_t n = 0; n < params->count; n++) {
+        rv = dccs_rdma_recv_comp(id, &wc);
+        uint64_t arrival = get_cycles();
+        if (rv < 0) {
+            log_error("Failed to recv immediate.\n");
+            ++failed_count;
+            break;
+        }
+
+        uint32_t seq = ntohl(wc.imm_data);
+        if (wc.opcode != IBV_WC_RECV_RDMA_WITH_IMM || seq >= params->count) {
+            log_warning("Unexpected completion (opcode = %d, seq = %u).\n", wc.opcode, seq);
+            ++failed_count;
+        } else {
+            requests[seq].end = arrival;
+        }
+
+        if (dccs_rdma_recv_imm(id) != 0)
+            ++failed_count;
     }
 
     return -failed_count;
@@ -702,6 +1036,7 @@ int send_and_wait_requests(struct rdma_cm_id *id, struct dccs_request *requests,
 
     switch (params->mode) {
         case MODE_LATENCY:      // Signal on all requests.
+        case MODE_OPEN_LOOP:
             flags |= IBV_SEND_SIGNALED;
             break;
         case MODE_THROUGHPUT:   // Only signal the last request.
@@ -739,22 +1074,7 @@ int send_and_wait_requests(struct rdma_cm_id *id, struct dccs_request *requests,
         log_verbose("buf = %p, length = %zu, remote = %p.\n", request->buf, request->length, request->remote_addr);
 #endif
 
-        switch (request->verb) {
-            case Send:
-                rv = dccs_rdma_send_with_flags(id, request->buf, request->length, request->mr, flags);
-                break;
-            case Read:
-                rv = dccs_rdma_read_with_flags(id, request->buf, request->length, request->mr, request->remote_addr, request->remote_rkey, flags);
-                break;
-            case Write:
-                rv = dccs_rdma_write_with_flags(id, request->buf, request->length, request->mr, request->remote_addr, request->remote_rkey, flags);
-                break;
-            default:
-                log_warning("Unrecognized request (n = %zu).", n);
-                rv = 0;
-                break;
-        }
-
+        rv = dccs_post_request(id, request, n, flags);
         requests[n].start = get_cycles();
         if (rv != 0)
             failed = true;
@@ -803,6 +1123,25 @@ void print_sha1sum(struct dccs_request *requests, size_t count) {
     unsigned char digest[SHA_DIGEST_LENGTH];
 
     size_t length = requests[0].length;
+    if (requests[0].num_sge > 1) {
+        // Hash the segments in message order, which equals the gathered payload.
+        size_t segment_count = 0;
+        struct dccs_segment *segments = malloc(count * (size_t)requests[0].num_sge * sizeof(struct dccs_segment));
+        for (size_t n = 0; n < count; n++) {
+            struct dccs_request *request = requests + n;
+            for (int k = 0; k < request->num_sge; k++)
+                segments[segment_count++] = (struct dccs_segment){ (void *)(uintptr_t)request->sg_list[k].addr,
+                                                                   request->sg_list[k].length };
+        }
+
+        sha1sum_segments(segments, segment_count, digest);
+        free(segments);
+        char *digest_hex = bin_to_hex_string(digest, SHA_DIGEST_LENGTH);
+        log_info("SHA1 sum: count = %zu, length = %zu, digest = %s.\n", count, length, digest_hex);
+        free(digest_hex);
+        return;
+    }
+
     void **array = malloc(count * sizeof(void *));
     for (size_t n = 0; n < count; n++) {
         struct dccs_request *request = requests + n;
@@ -909,6 +1248,21 @@ void print_latency_report(struct dccs_parameters *params, struct dccs_request *r
     free(end);
 }
 
+/**
+ * Print the CPU cost of gathering/scattering segments with --sge_copy.
+ */
+void print_copy_report(struct dccs_parameters *params, struct dccs_request *requests) {
+    if (params->sge <= 1 || !params->sge_copy)
+        return;
+
+    uint64_t sum = 0;
+    for (size_t n = 0; n < params->count; n++)
+        sum += requests[n].copy_cycles;
+
+    log_info("CPU copy of %zu segments: %.3f µsec per message on average.\n",
+             params->sge, (double)sum * MILLION / (double)clock_rate / (double)params->count);
+}
+
 /**
  * Print throughput report.
  */
@@ -930,4 +1284,99 @@ void print_throughput_report(struct dccs_parameters *params, struct dccs_request
     log_info("=====================\n\n");
 }
 
+/**
+ * Print receiver-side delivery report for write-with-immediate.
+ * Arrival times are taken when the responder polls each completion.
+ */
+void print_delivery_report(struct dccs_parameters *params, struct dccs_request *requests) {
+    size_t count = params->count;
+    size_t missing = 0, reordered = 0;
+    uint64_t first = UINT64_MAX, last = 0, prev = 0;
+    double *gaps = malloc(count * sizeof(double));
+    size_t gap_count = 0;
+
+    if (params->verbose) {
+        log_verbose("Raw arrival time (µsec):\n");
+        log_verbose("Seq,Arrival\n");
+    }
+
+    for (size_t n = 0; n < count; n++) {
+        uint64_t arrival = requests[n].end;
+        if (arrival == 0) {
+            missing++;
+            continue;
+        }
+
+        if (arrival < first)
+            first = arrival;
+        if (arrival > last)
+            last = arrival;
+        if (prev != 0) {
+            if (arrival < prev)
+                reordered++;
+            else
+                gaps[gap_count++] = (double)(arrival - prev) * MILLION / (double)clock_rate;
+        }
+        prev = arrival;
+
+        if (params->verbose)
+            log_verbose("%zu,%.3f\n", n, (double)arrival * MILLION / (double)clock_rate);
+    }
+
+    log_info("=====================\n");
+    log_info("Delivery Report\n");
+    log_info("Received: %zu, missing: %zu, out of order: %zu.\n", count - missing, missing, reordered);
+    if (gap_count > 0) {
+        double elapsed_seconds = (double)(last - first) / (double)clock_rate;
+        double throughput_gbits = (double)((count - missing - 1) * params->length) * 8 / elapsed_seconds / 1e9;
+        sort_latencies(gaps, gap_count);
+        log_info("Receive elapsed: %.3e s, throughput: %.3f Gbps.\n", elapsed_seconds, throughput_gbits);
+        log_info("Inter-arrival (µsec): median = %.3f, percent99 = %.3f, max = %.3f.\n",
+                 gaps[gap_count / 2], gaps[(size_t)((double)gap_count * 0.99)], gaps[gap_count - 1]);
+    }
+    log_info("=====================\n\n");
+
+    free(gaps);
+}
+
+/**
+ * Print atomic verbs report.
+ * The requester reports its message rate and how many CAS attempts won; the
+ * responder reports the sum of its words, which must equal the total number
+ * of fetch-and-adds. CAS leaves no such total, so the responder skips it.
+ */
+void print_atomic_report(struct dccs_parameters *params, struct dccs_request *requests, Role role) {
+    size_t words = params->atomic_words == 0 ? params->count : params->atomic_words;
+
+    if (role == ROLE_SERVER && params->verb == CompSwap)
+        return;
+
+    log_info("=====================\n");
+    log_info("Atomic Report\n");
+    if (role == ROLE_CLIENT) {
+        size_t warmup_count = params->warmup_count;
+        double elapsed_seconds = (double)(requests[params->count - 1].end - requests[warmup_count].start) /
+                                 (double)clock_rate;
+        log_info("Message rate: %.3f Mops.\n", (double)(params->count - warmup_count) / elapsed_seconds / 1e6);
+
+        if (params->verb == CompSwap) {
+            size_t succeeded = 0;
+            for (size_t n = 0; n < params->count; n++) {
+                struct dccs_request *request = requests + n;
+                if (*(uint64_t *)request->buf == request->compare_add)
+                    succeeded++;
+            }
+
+            log_info("CAS succeeded in this round: %zu / %zu (%zu words).\n", succeeded, params->count, words);
+        }
+    } else {    // role == ROLE_SERVER
+        uint64_t sum = 0;
+        for (size_t n = 0; n < params->count; n++)
+            sum += *(volatile uint64_t *)requests[n].buf;
+
+        log_info("Atomic words total = %" PRIu64 ".\n", sum);
+    }
+    log_info("=====================\n\n");
+}
+
 #endif // DCCS_RDMA_H
@@ -0,0 +1,280 @@
+/**
+ * Rotor traffic over a full mesh.
+ *
+ * A rotor schedule is a cycle of matchings, one per slot: in every slot each
+ * host sends to at most one peer, and each peer receives from at most one
+ * host. Senders switch their active QP at every slot boundary, using the same
+ * slot timing as dccs_schedule.h, and write messages into the peer's landing
+ * region with RDMA writes, so receivers stay passive.
+ *
+ * A matching file has one slot per line, listing the destination of every
+ * rank in rank order, or -1 for a rank idle in that slot. Empty lines and
+ * lines starting with '#' are skipped. For example, for 3 hosts:
+ *
+ *     # rank 0, rank 1, rank 2
+ *     1 2 0
+ *     2 0 1
+ */
+
+#ifndef DCCS_ROTOR_H
+#define DCCS_ROTOR_H
+
+#include <errno.h>
+
+#include "dccs_mesh.h"
+#include "dccs_schedule.h"
+
+#define ROTOR_LINE_LENGTH 4096
+
+struct dccs_rotor {
+    size_t slots;       // Matchings per cycle
+    size_t hosts;
+    int *peers;         // peers[slot * hosts + rank]: destination, or -1 when idle
+};
+
+struct dccs_rotor_message {
+    uint64_t start;
+    uint64_t end;
+    uint32_t peer;
+    uint32_t slot;
+};
+
+/**
+ * Rank r sends to r + 1 + k (mod hosts) in slot k, visiting every peer once
+ * per cycle of hosts - 1 slots.
+ */
+void dccs_rotor_round_robin(struct dccs_rotor *rotor, size_t hosts) {
+    rotor->hosts = hosts;
+    rotor->slots = hosts - 1;
+    rotor->peers = malloc(rotor->slots * hosts * sizeof(int));
+    for (size_t k = 0; k < rotor->slots; k++) {
+        for (size_t r = 0; r < hosts; r++)
+            rotor->peers[k * hosts + r] = (int)((r + 1 + k) % hosts);
+    }
+}
+
+/**
+ * Check that every slot is a matching: no self loops, and no two ranks
+ * sending to the same peer. Every rank must also send in some slot, or it
+ * could never finish its messages.
+ */
+static int dccs_rotor_validate(struct dccs_rotor *rotor) {
+    bool *taken = malloc(rotor->hosts * sizeof(bool));
+    bool *sends = calloc(rotor->hosts, sizeof(bool));
+    int rv = 0;
+
+    for (size_t k = 0; k < rotor->slots && rv == 0; k++) {
+        memset(taken, 0, rotor->hosts * sizeof(bool));
+        for (size_t r = 0; r < rotor->hosts; r++) {
+            int peer = rotor->peers[k * rotor->hosts + r];
+            if (peer < 0)
+                continue;
+            if ((size_t)peer >= rotor->hosts || (size_t)peer == r || taken[peer]) {
+                log_error("Slot %zu is not a matching (rank %zu -> %d).\n", k, r, peer);
+                rv = -1;
+                break;
+            }
+            taken[peer] = true;
+            sends[r] = true;
+        }
+    }
+
+    for (size_t r = 0; r < rotor->hosts && rv == 0; r++) {
+        if (!sends[r]) {
+            log_error("Rank %zu is idle in every slot.\n", r);
+            rv = -1;
+        }
+    }
+
+    free(taken);
+    free(sends);
+    return rv;
+}
+
+int dccs_rotor_load(struct dccs_rotor *rotor, const char *path, size_t hosts) {
+    char line[ROTOR_LINE_LENGTH];
+    size_t capacity = hosts;
+    FILE *file;
+
+    rotor->peers = NULL;
+    if ((file = fopen(path, "r")) == NULL) {
+        log_perror("fopen");
+        return -1;
+    }
+
+    rotor->hosts = hosts;
+    rotor->slots = 0;
+    rotor->peers = malloc(capacity * hosts * sizeof(int));
+
+    while (fgets(line, sizeof line, file) != NULL) {
+        char *p = line, *end;
+        while (*p == ' ' || *p == '\t')
+            p++;
+        if (*p == '#' || *p == '\n' || *p == '\0')
+            continue;
+
+        if (rotor->slots == capacity) {
+            capacity *= 2;
+            rotor->peers = realloc(rotor->peers, capacity * hosts * sizeof(int));
+        }
+
+        int *row = rotor->peers + rotor->slots * hosts;
+        for (size_t r = 0; r < hosts; r++) {
+            errno = 0;
+            long peer = strtol(p, &end, 10);
+            if (end == p || errno != 0) {
+                log_error("%s: slot %zu lists fewer than %zu destinations.\n", path, rotor->slots, hosts);
+                fclose(file);
+                return -1;
+            }
+            row[r] = (int)peer;
+            p = end;
+        }
+
+        while (*p == ' ' || *p == '\t' || *p == '\r')
+            p++;
+        if (*p != '\n' && *p != '\0' && *p != '#') {
+            log_error("%s: slot %zu lists more than %zu destinations.\n", path, rotor->slots, hosts);
+            fclose(file);
+            return -1;
+        }
+        rotor->slots++;
+    }
+
+    fclose(file);
+    if (rotor->slots == 0) {
+        log_error("%s: no slots found.\n", path);
+        return -1;
+    }
+
+    return dccs_rotor_validate(rotor);
+}
+
+void dccs_rotor_free(struct dccs_rotor *rotor) {
+    free(rotor->peers);
+    rotor->peers = NULL;
+}
+
+static inline int dccs_rotor_peer(struct dccs_rotor *rotor, size_t slot, size_t rank) {
+    return rotor->peers[slot * rotor->hosts + rank];
+}
+
+/**
+ * Send count messages, always to the peer of the current slot. Posting stops
+ * outside the open part of a slot and in slots where this rank is idle; in
+ * latency mode a single message is in flight at a time.
+ */
+int rotor_send_messages(struct dccs_mesh *mesh, struct dccs_rotor *rotor, struct dccs_schedule *s,
+                        struct dccs_parameters *params, struct dccs_rotor_message *messages) {
+    struct ibv_wc wc[SCHED_POLL_BATCH];
+    size_t depth = params->mode == MODE_LATENCY ? 1 : MAX_WR;
+    size_t posted = 0, completed = 0, inflight = 0;
+    int failed_count = 0;
+
+    memset(messages, 0, params->count * sizeof(struct dccs_rotor_message));
+    s->begin = get_cycles();
+    while (completed < params->count) {
+        uint64_t now = get_cycles();
+        uint64_t number = dccs_schedule_slot_number(s, now);
+        uint64_t offset = now - dccs_schedule_slot_start(s, number);
+        size_t slot = number % rotor->slots;
+        int peer = dccs_rotor_peer(rotor, slot, mesh->rank);
+
+        if (peer >= 0 && offset >= s->open && offset < s->close) {
+            while (posted < params->count && inflight < depth) {
+                struct dccs_rotor_message *message = messages + posted;
+                if (dccs_mesh_write(mesh, (size_t)peer, mesh->length, posted) != 0) {
+                    failed_count++;
+                    completed++;
+                    posted++;
+                    continue;
+                }
+
+                message->start = get_cycles();
+                message->peer = (uint32_t)peer;
+                message->slot = (uint32_t)slot;
+                posted++;
+                inflight++;
+
+                if (message->start - dccs_schedule_slot_start(s, number) >= s->close)
+                    break;
+            }
+        }
+
+        int rv = ibv_poll_cq(mesh->send_cq, SCHED_POLL_BATCH, wc);
+        if (rv < 0) {
+            log_error("ibv_poll_cq() failed, error = %d.\n", rv);
+            failed_count += (int)(params->count - completed);
+            break;
+        }
+
+        uint64_t t = get_cycles();
+        for (int k = 0; k < rv; k++) {
+            messages[wc[k].wr_id].end = t;
+            inflight--;
+            completed++;
+            if (wc[k].status != IBV_WC_SUCCESS) {
+                log_error("Failed status %s (%d) for message %d\n",
+                    ibv_wc_status_str(wc[k].status), wc[k].status, (int)wc[k].wr_id);
+                failed_count++;
+            }
+        }
+    }
+
+    s->end = get_cycles();
+    return -failed_count;
+}
+
+/**
+ * Print bytes and latency of the messages sent in every slot of the cycle,
+ * then per peer.
+ */
+void print_rotor_report(struct dccs_parameters *params, struct dccs_rotor *rotor, struct dccs_schedule *s,
+                        size_t rank, struct dccs_rotor_message *messages) {
+    double *latencies = malloc(params->count * sizeof(double));
+    double elapsed = (double)(s->end - s->begin) / (double)clock_rate;
+
+    log_info("=====================\n");
+    log_info("Rotor Traffic Report\n");
+    log_info("slot, peer, messages, bytes, median (µsec), percent99 (µsec)\n");
+    for (size_t slot = 0; slot < rotor->slots; slot++) {
+        int peer = dccs_rotor_peer(rotor, slot, rank);
+        size_t length = 0;
+        for (size_t n = 0; n < params->count; n++) {
+            struct dccs_rotor_message *message = messages + n;
+            if (message->end != 0 && message->slot == slot)
+                latencies[length++] = (double)(message->end - message->start) * MILLION / (double)clock_rate;
+        }
+
+        if (length == 0) {
+            log_info("%zu, %d, 0, 0, -, -\n", slot, peer);
+            continue;
+        }
+
+        sort_latencies(latencies, length);
+        log_info("%zu, %d, %zu, %zu, %.3f, %.3f\n", slot, peer, length, length * params->length,
+                 latencies[length / 2], latencies[(size_t)((double)length * 0.99)]);
+    }
+
+    log_info("peer, messages, bytes, goodput (Gbps)\n");
+    for (size_t peer = 0; peer < rotor->hosts; peer++) {
+        size_t length = 0;
+        if (peer == rank)
+            continue;
+        for (size_t n = 0; n < params->count; n++) {
+            if (messages[n].end != 0 && messages[n].peer == peer)
+                length++;
+        }
+
+        log_info("%zu, %zu, %zu, %.3f\n", peer, length, length * params->length,
+                 (double)(length * params->length) * 8 / elapsed / BILLION);
+    }
+
+    log_info("Elapsed: %.3f µsec, goodput: %.3f Gbps.\n", elapsed * MILLION,
+             (double)(params->count * params->length) * 8 / elapsed / BILLION);
+    log_info("=====================\n\n");
+
+    free(latencies);
+}
+
+#endif // DCCS_ROTOR_H
@@ -0,0 +1,302 @@
+/**
+ * Slot-aware sending on a reconfiguring circuit fabric.
+ *
+ * Time is cut into slots of a fixed period, and slots into cycles of `slots`
+ * slots. The circuit to a destination is up for the first `uptime` of its own
+ * slot in every cycle; requests are only posted inside that window, less a
+ * guard band at both edges, and wait in a per-destination queue otherwise.
+ *
+ * Slot boundaries are derived from the clock epoch plus a phase offset, so
+ * hosts whose clocks are synchronized (e.g. the default CLOCK_REALTIME timer
+ * under PTP) agree on them without exchanging anything.
+ */
+
+#ifndef DCCS_SCHEDULE_H
+#define DCCS_SCHEDULE_H
+
+#include "dccs_rdma.h"
+
+#define SCHED_POLL_BATCH 16
+#define SCHED_NO_WINDOW UINT64_MAX
+
+struct dccs_schedule {
+    uint64_t period;    // Slot length, in cycles
+    uint64_t open;      // Offset into the slot where posting starts
+    uint64_t close;     // Offset into the slot where posting stops
+    uint64_t phase;     // Start of slot 0, relative to the clock epoch
+    size_t slots;       // Slots per cycle
+
+    // Timing of the last run
+    uint64_t begin;
+    uint64_t end;
+};
+
+/**
+ * Requests of one destination, as request indices.
+ * Pending requests wait for an open window; in-flight ones wait for their
+ * completion, which RC delivers in posting order.
+ */
+struct dccs_sched_queue {
+    struct rdma_cm_id *id;
+    size_t slot;            // Slot of the cycle in which the destination is reachable
+
+    size_t *pending;
+    size_t pending_head, pending_tail;
+    size_t inflight[MAX_WR];
+    size_t inflight_head, inflight_count;
+
+    // Stats
+    size_t sent;
+    size_t windows;         // Windows in which at least one request was posted
+    size_t deferrals;       // Windows that closed with requests still pending
+    uint64_t window;        // Last window posted in
+    uint64_t deferred;      // Last window counted as deferred
+};
+
+void dccs_schedule_init(struct dccs_schedule *s, struct dccs_parameters *params) {
+    memset(s, 0, sizeof *s);
+    s->period = usec_to_cycles(params->slot_period);
+    s->open = usec_to_cycles(params->slot_guard);
+    s->close = usec_to_cycles(params->slot_uptime - params->slot_guard);
+    s->phase = usec_to_cycles(params->slot_phase);
+    s->slots = params->slots;
+}
+
+static inline uint64_t dccs_schedule_slot_number(struct dccs_schedule *s, uint64_t now) {
+    return (now - s->phase) / s->period;
+}
+
+static inline uint64_t dccs_schedule_slot_start(struct dccs_schedule *s, uint64_t number) {
+    return s->phase + number * s->period;
+}
+
+/**
+ * Whether posting to a destination reachable in the given slot is allowed now.
+ */
+static inline bool dccs_schedule_is_open(struct dccs_schedule *s, size_t slot, uint64_t now) {
+    uint64_t number = dccs_schedule_slot_number(s, now);
+    uint64_t offset = now - dccs_schedule_slot_start(s, number);
+    return number % s->slots == slot && offset >= s->open && offset < s->close;
+}
+
+/**
+ * First time at or after now when posting in the given slot is allowed.
+ */
+uint64_t dccs_schedule_next_open(struct dccs_schedule *s, size_t slot, uint64_t now) {
+    uint64_t number = dccs_schedule_slot_number(s, now);
+    uint64_t offset = now - dccs_schedule_slot_start(s, number);
+
+    if (number % s->slots == slot) {
+        if (offset < s->open)
+            return dccs_schedule_slot_start(s, number) + s->open;
+        if (offset < s->close)
+            return now;
+    }
+
+    uint64_t next = number + 1;
+    next += (slot + s->slots - next % s->slots) % s->slots;
+    return dccs_schedule_slot_start(s, next) + s->open;
+}
+
+/**
+ * Allocate one queue per destination; ids[d] is reachable in slots[d].
+ */
+struct dccs_sched_queue *dccs_sched_create_queues(struct rdma_cm_id **ids, const size_t *slots,
+                                                  size_t destinations, size_t count) {
+    struct dccs_sched_queue *queues = calloc(destinations, sizeof(struct dccs_sched_queue));
+    for (size_t d = 0; d < destinations; d++) {
+        queues[d].id = ids[d];
+        queues[d].slot = slots[d];
+        queues[d].pending = malloc(count * sizeof(size_t));
+    }
+
+    return queues;
+}
+
+void dccs_sched_free_queues(struct dccs_sched_queue *queues, size_t destinations) {
+    for (size_t d = 0; d < destinations; d++)
+        free(queues[d].pending);
+    free(queues);
+}
+
+/**
+ * Reap the completions of a destination without blocking.
+ */
+static int sched_poll_queue(struct dccs_sched_queue *q, struct dccs_request *requests,
+                            size_t *remaining, int *failed_count) {
+    struct ibv_wc wc[SCHED_POLL_BATCH];
+
+    int rv = ibv_poll_cq(q->id->send_cq, SCHED_POLL_BATCH, wc);
+    if (rv < 0) {
+        log_error("ibv_poll_cq() failed, error = %d.\n", rv);
+        return -1;
+    }
+
+    uint64_t t = get_cycles();
+    for (int k = 0; k < rv; k++) {
+        size_t n = q->inflight[q->inflight_head];
+        q->inflight_head = (q->inflight_head + 1) % MAX_WR;
+        q->inflight_count--;
+        (*remaining)--;
+
+        requests[n].end = t;
+        if (wc[k].status != IBV_WC_SUCCESS) {
+            log_error("Failed status %s (%d) for request %zu\n",
+                ibv_wc_status_str(wc[k].status), wc[k].status, n);
+            (*failed_count)++;
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * Send all requests, each only while the circuit to its destination is up.
+ * Request n goes to destination n % destinations. Every request is signaled
+ * so that its end time is its own completion; in latency mode a destination
+ * has at most one request in flight.
+ */
+int sched_send_requests(struct dccs_sched_queue *queues, size_t destinations, struct dccs_request *requests,
+                        struct dccs_parameters *params, struct dccs_schedule *s) {
+    int failed_count = 0;
+    size_t remaining = params->count;
+    size_t depth = params->mode == MODE_LATENCY ? 1 : MAX_WR;
+
+    for (size_t d = 0; d < destinations; d++) {
+        struct dccs_sched_queue *q = queues + d;
+        q->pending_head = q->pending_tail = 0;
+        q->inflight_head = q->inflight_count = 0;
+        q->sent = q->windows = q->deferrals = 0;
+        q->window = q->deferred = SCHED_NO_WINDOW;
+    }
+
+    for (size_t n = 0; n < params->count; n++) {
+        struct dccs_sched_queue *q = queues + n % destinations;
+        q->pending[q->pending_tail++] = n;
+        requests[n].start = requests[n].end = 0;
+    }
+
+    s->begin = get_cycles();
+    while (remaining > 0) {
+        uint64_t now = get_cycles();
+        uint64_t wake = UINT64_MAX;
+        bool busy = false;
+
+        for (size_t d = 0; d < destinations; d++) {
+            struct dccs_sched_queue *q = queues + d;
+
+            if (q->inflight_count > 0) {
+                busy = true;
+                if (sched_poll_queue(q, requests, &remaining, &failed_count) != 0) {
+                    failed_count += (int)remaining;
+                    goto out;
+                }
+            }
+
+            if (q->pending_head == q->pending_tail)
+                continue;
+
+            if (!dccs_schedule_is_open(s, q->slot, now)) {
+                if (q->window != SCHED_NO_WINDOW && q->deferred != q->window) {
+                    q->deferrals++;
+                    q->deferred = q->window;
+                }
+
+                uint64_t next = dccs_schedule_next_open(s, q->slot, now);
+                if (next < wake)
+                    wake = next;
+                continue;
+            }
+
+            uint64_t window = dccs_schedule_slot_number(s, now);
+            if (q->window != window) {
+                q->window = window;
+                q->windows++;
+            }
+
+            busy = true;
+            while (q->pending_head != q->pending_tail && q->inflight_count < depth) {
+                size_t n = q->pending[q->pending_head++];
+                struct dccs_request *request = requests + n;
+                if (dccs_post_request(q->id, request, n, IBV_SEND_SIGNALED) != 0) {
+                    failed_count++;
+                    remaining--;
+                    continue;
+                }
+
+                request->start = get_cycles();
+                q->inflight[(q->inflight_head + q->inflight_count) % MAX_WR] = n;
+                q->inflight_count++;
+                q->sent++;
+
+                if (!dccs_schedule_is_open(s, q->slot, request->start))
+                    break;
+            }
+        }
+
+        // Nothing in flight and every circuit down: wait for the first window.
+        if (!busy && wake != UINT64_MAX)
+            while (get_cycles() < wake);
+    }
+
+out:
+    s->end = get_cycles();
+    log_debug("Time elapsed to send all scheduled requests: %.3f µsec.\n", (double)(s->end - s->begin) * 1e6 / (double)clock_rate);
+
+    return -failed_count;
+}
+
+/**
+ * Print how requests were spread over windows and the goodput achieved.
+ * Wait is the time a request spent queued, from the start of the run until
+ * it was posted.
+ */
+void print_schedule_report(struct dccs_parameters *params, struct dccs_schedule *s,
+                           struct dccs_sched_queue *queues, size_t destinations, struct dccs_request *requests) {
+    double *waits = malloc(params->count * sizeof(double));
+
+    log_info("=====================\n");
+    log_info("Slot Schedule Report\n");
+    log_info("Schedule: period = %.3f µsec, up = %.3f µsec, guard = %.3f µsec, slots = %zu.\n",
+             params->slot_period, params->slot_uptime, params->slot_guard, params->slots);
+    log_info("destination, slot, requests, windows, deferrals, median wait (µsec), max wait (µsec)\n");
+    for (size_t d = 0; d < destinations; d++) {
+        struct dccs_sched_queue *q = queues + d;
+        size_t length = 0;
+        for (size_t n = d; n < params->count; n += destinations) {
+            if (requests[n].start != 0)
+                waits[length++] = (double)(requests[n].start - s->begin) * MILLION / (double)clock_rate;
+        }
+
+        double median = 0, max = 0;
+        if (length > 0) {
+            sort_latencies(waits, length);
+            median = waits[length / 2];
+            max = waits[length - 1];
+        }
+
+        log_info("%zu, %zu, %zu, %zu, %zu, %.3f, %.3f\n", d, q->slot, q->sent, q->windows, q->deferrals, median, max);
+    }
+
+    // Share of time in which posting to at least one destination is allowed
+    size_t open_slots = 0;
+    for (size_t slot = 0; slot < s->slots; slot++) {
+        for (size_t d = 0; d < destinations; d++) {
+            if (queues[d].slot == slot) {
+                open_slots++;
+                break;
+            }
+        }
+    }
+    double duty = (double)((s->close - s->open) * open_slots) / (double)(s->period * s->slots);
+
+    double elapsed = (double)(s->end - s->begin) / (double)clock_rate;
+    double goodput = (double)(params->count * params->length) * 8 / elapsed / BILLION;
+    log_info("Elapsed: %.3f µsec, open %.1f%% of the time, goodput: %.3f Gbps (%.3f Gbps while open).\n",
+             elapsed * MILLION, duty * 100, goodput, goodput / duty);
+    log_info("=====================\n\n");
+
+    free(waits);
+}
+
+#endif // DCCS_SCHEDULE_H
@@ -0,0 +1,222 @@
+/**
+ * Shared memory between the transport daemon and its applications.
+ *
+ * The daemon creates one POSIX shared memory segment: a header, one channel
+ * per application (SHM_MAX_APPS), and SHM_SLOTS message buffers per channel,
+ * which the daemon registers with the NIC. An application attaches, claims a
+ * channel and owns its buffers: it writes a message straight into a buffer
+ * and submits the buffer by slot index on the channel's request ring; the
+ * daemon posts it from there, so the NIC reads the application's bytes
+ * without a copy, and answers on the response ring. Receives are not posted
+ * in place: all channels share the daemon's connections, so the daemon tags
+ * each send with its channel, receives into buffers of its own and copies a
+ * message to the channel its tag names. Per-channel credits between daemons
+ * keep one channel from holding all of those buffers.
+ *
+ * A channel is free, attached, or detaching: an application claims a free
+ * channel and marks it detaching when done, and the daemon drops the
+ * channel's outstanding work, waits for its sends in flight and frees it.
+ *
+ * Each ring has one producer and one consumer, synchronized only by
+ * acquire/release on its head and tail, so neither side makes a system call
+ * on the fast path. A slot has at most one request outstanding, so rings as
+ * deep as the slot count never overflow.
+ */
+
+#ifndef DCCS_SHM_H
+#define DCCS_SHM_H
+
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "dccs_utils.h"
+
+#define SHM_MAGIC 0x6463637373686d31UL   // "dccsshm1"
+#define SHM_PAGE_SIZE 4096
+
+typedef enum {
+    SHM_CHANNEL_FREE = 0,
+    SHM_CHANNEL_ATTACHED,
+    SHM_CHANNEL_DETACHING,
+} ShmChannelState;
+
+typedef enum {
+    SHM_OP_SEND = 1,
+    SHM_OP_RECV,
+} ShmOp;
+
+struct dccs_shm_entry {
+    uint32_t op;
+    uint32_t slot;
+    uint64_t length;    // Bytes to send or room to receive; responses: bytes moved
+    uint64_t cookie;    // Chosen by the application, returned as is
+    int32_t peer;       // Transport peer of the daemon
+    int32_t status;     // Responses: 0, or a negative errno
+};
+
+struct dccs_ring {
+    uint32_t head __attribute__((aligned(CACHE_LINE_SIZE)));    // Written by the consumer only
+    uint32_t tail __attribute__((aligned(CACHE_LINE_SIZE)));    // Written by the producer only
+    struct dccs_shm_entry entries[SHM_SLOTS] __attribute__((aligned(CACHE_LINE_SIZE)));
+};
+
+struct dccs_shm_channel {
+    uint32_t state __attribute__((aligned(CACHE_LINE_SIZE)));  // ShmChannelState
+    struct dccs_ring requests;      // Application to daemon
+    struct dccs_ring responses;     // Daemon to application
+};
+
+struct dccs_shm_header {
+    uint64_t magic;
+    size_t size;            // Whole segment
+    size_t buffer_offset;   // First message buffer
+    size_t slot_size;       // Bytes per message buffer
+    uint32_t slots;
+    uint32_t peer_count;    // Peers of the daemon's transport
+    uint32_t server;        // The daemon's transport is the server
+    uint32_t ready;         // Set once the daemon serves requests
+    struct dccs_shm_channel channels[SHM_MAX_APPS];
+};
+
+struct dccs_shm {
+    struct dccs_shm_header *header;
+    size_t size;
+};
+
+/**
+ * Enqueue an entry; false if the ring is full.
+ */
+static inline bool dccs_ring_push(struct dccs_ring *ring, const struct dccs_shm_entry *entry) {
+    uint32_t tail = ring->tail;
+    if (tail - __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE) == SHM_SLOTS)
+        return false;
+
+    ring->entries[tail % SHM_SLOTS] = *entry;
+    __atomic_store_n(&ring->tail, tail + 1, __ATOMIC_RELEASE);
+    return true;
+}
+
+/**
+ * Dequeue an entry; false if the ring is empty.
+ */
+static inline bool dccs_ring_pop(struct dccs_ring *ring, struct dccs_shm_entry *entry) {
+    uint32_t head = ring->head;
+    if (head == __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE))
+        return false;
+
+    *entry = ring->entries[head % SHM_SLOTS];
+    __atomic_store_n(&ring->head, head + 1, __ATOMIC_RELEASE);
+    return true;
+}
+
+static inline void *dccs_shm_buffer(struct dccs_shm *shm, size_t channel, size_t slot) {
+    struct dccs_shm_header *h = shm->header;
+    return (uint8_t *)h + h->buffer_offset + (channel * h->slots + slot) * h->slot_size;
+}
+
+/**
+ * Daemon: create the segment, replacing any left over from an earlier run.
+ */
+int dccs_shm_create(struct dccs_shm *shm, const char *name, size_t slot_size) {
+    size_t buffer_offset = (sizeof(struct dccs_shm_header) + SHM_PAGE_SIZE - 1) / SHM_PAGE_SIZE * SHM_PAGE_SIZE;
+    slot_size = (slot_size + CACHE_LINE_SIZE - 1) / CACHE_LINE_SIZE * CACHE_LINE_SIZE;
+    size_t size = buffer_offset + (size_t)SHM_MAX_APPS * SHM_SLOTS * slot_size;
+    int fd;
+
+    shm_unlink(name);
+    if ((fd = shm_open(name, O_CREAT | O_EXCL | O_RDWR, 0600)) < 0) {
+        log_perror("shm_open");
+        return -1;
+    }
+    if (ftruncate(fd, (off_t)size) != 0) {
+        log_perror("ftruncate");
+        close(fd);
+        shm_unlink(name);
+        return -1;
+    }
+
+    void *base = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED) {
+        log_perror("mmap");
+        shm_unlink(name);
+        return -1;
+    }
+
+    // ftruncate() zeroed the segment: every ring is empty, every channel free.
+    shm->header = base;
+    shm->size = size;
+    shm->header->size = size;
+    shm->header->buffer_offset = buffer_offset;
+    shm->header->slot_size = slot_size;
+    shm->header->slots = SHM_SLOTS;
+    __atomic_store_n(&shm->header->magic, SHM_MAGIC, __ATOMIC_RELEASE);
+
+    return 0;
+}
+
+void dccs_shm_destroy(struct dccs_shm *shm, const char *name) {
+    munmap(shm->header, shm->size);
+    shm_unlink(name);
+    shm->header = NULL;
+}
+
+/**
+ * Application: map the segment of a serving daemon and claim a free channel.
+ * Returns the channel, or negative.
+ */
+int dccs_shm_attach(struct dccs_shm *shm, const char *name) {
+    struct stat st;
+    int fd;
+
+    if ((fd = shm_open(name, O_RDWR, 0)) < 0) {
+        log_perror("shm_open");
+        return -1;
+    }
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(struct dccs_shm_header)) {
+        log_error("Shared memory segment %s is not a transport daemon's.\n", name);
+        close(fd);
+        return -1;
+    }
+
+    void *base = mmap(NULL, (size_t)st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED) {
+        log_perror("mmap");
+        return -1;
+    }
+
+    shm->header = base;
+    shm->size = (size_t)st.st_size;
+    if (__atomic_load_n(&shm->header->magic, __ATOMIC_ACQUIRE) != SHM_MAGIC ||
+            shm->header->size != shm->size || !__atomic_load_n(&shm->header->ready, __ATOMIC_ACQUIRE)) {
+        log_error("No transport daemon is serving %s.\n", name);
+        munmap(base, shm->size);
+        return -1;
+    }
+
+    for (int channel = 0; channel < SHM_MAX_APPS; channel++) {
+        struct dccs_shm_channel *ch = shm->header->channels + channel;
+        // The daemon frees a channel only with both rings empty.
+        if (__sync_bool_compare_and_swap(&ch->state, SHM_CHANNEL_FREE, SHM_CHANNEL_ATTACHED))
+            return channel;
+    }
+
+    log_error("All %d channels of %s are in use.\n", SHM_MAX_APPS, name);
+    munmap(base, shm->size);
+    return -1;
+}
+
+/**
+ * Application: hand the channel back. The daemon drops what is outstanding
+ * on it and frees it once its sends have left.
+ */
+void dccs_shm_detach(struct dccs_shm *shm, int channel) {
+    __atomic_store_n(&shm->header->channels[channel].state, SHM_CHANNEL_DETACHING, __ATOMIC_RELEASE);
+    munmap(shm->header, shm->size);
+    shm->header = NULL;
+}
+
+#endif // DCCS_SHM_H
@@ -0,0 +1,319 @@
+/**
+ * Byte stream over RDMA WRITE, in both directions of one RC connection.
+ *
+ * Each end owns a ring of STREAM_RING_SIZE bytes that its peer writes into.
+ * A writer RDMA-writes bytes at its tail in the peer's ring (in two pieces
+ * where they wrap) straight from the caller's registered buffer, then writes
+ * the new tail into the peer's control words; a QP executes its writes in
+ * order, so the tail never runs ahead of the data. The reader polls its tail
+ * word, consumes bytes in place or copies them out, and returns credits
+ * lazily: once it has consumed 1/STREAM_CREDIT_FRACTION of the ring since the
+ * last credit, it writes its head into the writer's control words. No receive
+ * is posted per message.
+ *
+ * Writes are unsignaled except every STREAM_SIGNAL_INTERVAL, and a caller's
+ * buffer must stay intact until dccs_stream_flush().
+ */
+
+#ifndef DCCS_STREAM_H
+#define DCCS_STREAM_H
+
+#include <stddef.h>
+
+#include "dccs_rdma.h"
+
+#define STREAM_POLL_BATCH 16
+
+struct stream_control {
+    volatile uint64_t tail __attribute__((aligned(CACHE_LINE_SIZE)));     // Peer: bytes written into our ring
+    volatile uint64_t credit __attribute__((aligned(CACHE_LINE_SIZE)));   // Peer: bytes consumed from its ring
+    uint64_t words[MAX_WR] __attribute__((aligned(CACHE_LINE_SIZE)));     // Sources of our tail and credit writes
+};
+
+struct stream_remote {
+    uint64_t control;
+    uint64_t ring;
+    uint64_t ring_size;
+    uint32_t rkey;
+};
+
+struct dccs_stream {
+    struct rdma_cm_id *id;
+    struct stream_control *control;     // Followed by the ring
+    uint8_t *ring;
+    size_t ring_size;
+    struct ibv_mr *mr;
+    struct stream_remote remote;
+
+    uint64_t head;          // Bytes consumed from our ring
+    uint64_t credited;      // Head as last returned to the peer
+    uint64_t tail;          // Bytes written into the peer's ring
+    uint64_t posted;        // Writes posted
+    uint64_t retired;       // Writes known complete
+};
+
+/**
+ * Allocate and register the ring, and exchange it with the peer's.
+ */
+int dccs_stream_init(struct dccs_stream *s, struct rdma_cm_id *id) {
+    struct stream_remote local;
+    struct ibv_mr *info_mr = NULL;
+    struct ibv_wc wc;
+    size_t size = sizeof(struct stream_control) + STREAM_RING_SIZE;
+    int rv = -1;
+
+    memset(s, 0, sizeof *s);
+    s->id = id;
+    s->ring_size = STREAM_RING_SIZE;
+    if (posix_memalign((void **)&s->control, (size_t)sysconf(_SC_PAGESIZE), size) != 0) {
+        log_perror("posix_memalign");
+        return -1;
+    }
+    memset(s->control, 0, size);
+    s->ring = (uint8_t *)(s->control + 1);
+    if ((s->mr = dccs_reg_write(id, s->control, size)) == NULL)
+        goto out_free;
+
+    local.control = (uint64_t)(uintptr_t)s->control;
+    local.ring = (uint64_t)(uintptr_t)s->ring;
+    local.ring_size = s->ring_size;
+    local.rkey = s->mr->rkey;
+
+    // Both ends post their receive before sending, so neither can miss the other's.
+    struct stream_remote info[2] = { local, { 0 } };
+    if ((info_mr = dccs_reg_msgs(id, info, sizeof info)) == NULL)
+        goto out_dereg;
+    if (dccs_rdma_recv(id, info + 1, sizeof(struct stream_remote), info_mr) != 0 ||
+            dccs_rdma_send(id, info, sizeof(struct stream_remote), info_mr) != 0 ||
+            dccs_rdma_send_comp(id, 1, &wc) < 0 || dccs_rdma_recv_comp(id, &wc) < 0) {
+        log_error("Failed to exchange stream rings.\n");
+        goto out_dereg;
+    }
+
+    s->remote = info[1];
+    dccs_dereg_mr(info_mr);
+    return 0;
+
+out_dereg:
+    if (info_mr != NULL)
+        dccs_dereg_mr(info_mr);
+    dccs_dereg_mr(s->mr);
+out_free:
+    free(s->control);
+    s->control = NULL;
+    return rv;
+}
+
+/**
+ * Reap signaled writes until at most limit writes are outstanding.
+ */
+static int stream_retire(struct dccs_stream *s, uint64_t limit) {
+    struct ibv_wc wc[STREAM_POLL_BATCH];
+
+    while (s->posted - s->retired > limit) {
+        int rv = ibv_poll_cq(s->id->send_cq, STREAM_POLL_BATCH, wc);
+        if (rv < 0) {
+            log_error("ibv_poll_cq() failed, error = %d.\n", rv);
+            return -1;
+        }
+
+        for (int k = 0; k < rv; k++) {
+            if (wc[k].status != IBV_WC_SUCCESS) {
+                log_error("Failed status %s (%d) for stream write %lu\n", ibv_wc_status_str(wc[k].status),
+                          wc[k].status, wc[k].wr_id);
+                return -1;
+            }
+            // The send queue completes in order: every earlier write is done too.
+            if (wc[k].wr_id > s->retired)
+                s->retired = wc[k].wr_id;
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * Post one write, signaled every STREAM_SIGNAL_INTERVAL or when forced.
+ */
+static int stream_post(struct dccs_stream *s, const void *addr, size_t length, uint32_t lkey, uint64_t remote_addr,
+                       bool signaled) {
+    struct ibv_send_wr wr, *bad;
+    struct ibv_sge sge;
+    int rv;
+
+    if (stream_retire(s, MAX_WR - 1) != 0)
+        return -1;
+
+    sge.addr = (uint64_t)(uintptr_t)addr;
+    sge.length = (uint32_t)length;
+    sge.lkey = lkey;
+
+    memset(&wr, 0, sizeof wr);
+    wr.wr_id = ++s->posted;
+    wr.sg_list = &sge;
+    wr.num_sge = length > 0 ? 1 : 0;
+    wr.opcode = IBV_WR_RDMA_WRITE;
+    wr.send_flags = signaled || s->posted % STREAM_SIGNAL_INTERVAL == 0 ? IBV_SEND_SIGNALED : 0;
+    wr.wr.rdma.remote_addr = remote_addr;
+    wr.wr.rdma.rkey = s->remote.rkey;
+
+    if ((rv = ibv_post_send(s->id->qp, &wr, &bad)) != 0) {
+        log_error("ibv_post_send() failed, error = %d.\n", rv);
+        s->posted--;
+    }
+
+    return rv;
+}
+
+/**
+ * Write a 64-bit word into the peer's control words. Its source is the word
+ * of its send queue entry, free once the entry's previous write is retired,
+ * so that no later value overwrites it before the NIC reads it.
+ */
+static int stream_post_word(struct dccs_stream *s, uint64_t value, size_t offset) {
+    uint64_t *word = s->control->words + (s->posted + 1) % MAX_WR;
+
+    if (stream_retire(s, MAX_WR - 1) != 0)
+        return -1;
+    *word = value;
+    return stream_post(s, word, sizeof *word, s->mr->lkey, s->remote.control + offset, false);
+}
+
+/**
+ * Write up to length bytes from buf, in mr, as far as credits allow.
+ * Returns the bytes written, or negative.
+ */
+ssize_t dccs_stream_write(struct dccs_stream *s, const void *buf, size_t length, struct ibv_mr *mr) {
+    uint64_t space = s->remote.ring_size - (s->tail - s->control->credit);
+    size_t n = length < space ? length : (size_t)space;
+
+    if (n == 0)
+        return 0;
+
+    size_t offset = (size_t)(s->tail % s->remote.ring_size);
+    size_t first = n < s->remote.ring_size - offset ? n : (size_t)(s->remote.ring_size - offset);
+    if (stream_post(s, buf, first, mr->lkey, s->remote.ring + offset, false) != 0)
+        return -1;
+    if (n > first && stream_post(s, (const uint8_t *)buf + first, n - first, mr->lkey, s->remote.ring, false) != 0)
+        return -1;
+
+    s->tail += n;
+    if (stream_post_word(s, s->tail, offsetof(struct stream_control, tail)) != 0)
+        return -1;
+
+    return (ssize_t)n;
+}
+
+/**
+ * Write all of buf, waiting for credits as needed.
+ */
+int dccs_stream_write_all(struct dccs_stream *s, const void *buf, size_t length, struct ibv_mr *mr) {
+    for (size_t done = 0; done < length;) {
+        ssize_t rv = dccs_stream_write(s, (const uint8_t *)buf + done, length - done, mr);
+        if (rv < 0)
+            return -1;
+        done += (size_t)rv;
+    }
+
+    return 0;
+}
+
+/**
+ * Wait until every write posted so far is complete.
+ */
+int dccs_stream_flush(struct dccs_stream *s) {
+    if (s->posted == s->retired)
+        return 0;
+
+    // A signaled empty write completes after all before it.
+    if (stream_post(s, NULL, 0, 0, s->remote.ring, true) != 0)
+        return -1;
+
+    return stream_retire(s, 0);
+}
+
+static inline size_t dccs_stream_readable(struct dccs_stream *s) {
+    return (size_t)(__atomic_load_n(&s->control->tail, __ATOMIC_ACQUIRE) - s->head);
+}
+
+/**
+ * The contiguous readable bytes at the head, in place.
+ */
+static inline const void *dccs_stream_peek(struct dccs_stream *s, size_t *length) {
+    size_t offset = (size_t)(s->head % s->ring_size);
+    size_t readable = dccs_stream_readable(s);
+
+    *length = readable < s->ring_size - offset ? readable : s->ring_size - offset;
+    return s->ring + offset;
+}
+
+/**
+ * Release length read bytes, and return credits once enough are released.
+ */
+int dccs_stream_consume(struct dccs_stream *s, size_t length) {
+    s->head += length;
+    if (s->head - s->credited < s->ring_size / STREAM_CREDIT_FRACTION)
+        return 0;
+
+    s->credited = s->head;
+    return stream_post_word(s, s->head, offsetof(struct stream_control, credit));
+}
+
+/**
+ * Copy up to length readable bytes into buf. Returns the bytes read, or
+ * negative.
+ */
+ssize_t dccs_stream_read(struct dccs_stream *s, void *buf, size_t length) {
+    size_t done = 0, n;
+
+    while (done < length) {
+        const void *data = dccs_stream_peek(s, &n);
+        if (n == 0)
+            break;
+        if (n > length - done)
+            n = length - done;
+
+        memcpy((uint8_t *)buf + done, data, n);
+        if (dccs_stream_consume(s, n) != 0)
+            return -1;
+        done += n;
+    }
+
+    return (ssize_t)done;
+}
+
+/**
+ * Consume length bytes as they arrive, copying them into buf unless it is
+ * NULL.
+ */
+int dccs_stream_read_all(struct dccs_stream *s, void *buf, size_t length) {
+    size_t done = 0, n;
+
+    while (done < length) {
+        const void *data = dccs_stream_peek(s, &n);
+        if (n == 0)
+            continue;
+        if (n > length - done)
+            n = length - done;
+
+        if (buf != NULL)
+            memcpy((uint8_t *)buf + done, data, n);
+        if (dccs_stream_consume(s, n) != 0)
+            return -1;
+        done += n;
+    }
+
+    return 0;
+}
+
+void dccs_stream_free(struct dccs_stream *s) {
+    if (s->control == NULL)
+        return;
+
+    dccs_stream_flush(s);
+    dccs_dereg_mr(s->mr);
+    free(s->control);
+    s->control = NULL;
+}
+
+#endif // DCCS_STREAM_H
@@ -0,0 +1,248 @@
+/**
+ * Traffic matrices and message size distributions, shared by the MPI and
+ * mesh executables.
+ *
+ * A traffic matrix gives, for every ordered pair of ranks, how many times
+ * count messages flow from one to the other (0 for none). Patterns:
+ *  - permutation: every rank sends to one peer and receives from one, along
+ *    a random cycle through all ranks;
+ *  - incast: ranks 1 to fanin all send to rank 0;
+ *  - shuffle: every rank sends to every other rank;
+ *  - file: a matrix file with one line per source rank, listing the weight
+ *    towards every destination rank. Empty lines and lines starting with '#'
+ *    are skipped, as in matching files.
+ * Every rank builds the same matrix from the shared seed.
+ *
+ * Message sizes are either the block size, or drawn from an empirical CDF
+ * file such as the web-search or data-mining workloads: one point per line,
+ * the size in bytes first and the cumulative probability last (as a
+ * fraction or a percentage), with sizes interpolated between points.
+ */
+
+#ifndef DCCS_TRAFFIC_H
+#define DCCS_TRAFFIC_H
+
+#include <errno.h>
+#include <math.h>
+
+#include "dccs_utils.h"
+
+#define TRAFFIC_LINE_LENGTH 4096
+
+struct dccs_traffic {
+    size_t hosts;
+    size_t *weights;    // weights[src * hosts + dst]
+};
+
+struct dccs_sizes {
+    size_t points;      // 0 for a fixed size
+    double *sizes;
+    double *cdf;
+    size_t fixed;
+    size_t max;
+
+    unsigned short state[3];
+};
+
+static inline size_t dccs_traffic_weight(struct dccs_traffic *traffic, size_t src, size_t dst) {
+    return traffic->weights[src * traffic->hosts + dst];
+}
+
+static int dccs_traffic_load(struct dccs_traffic *traffic, const char *path) {
+    char line[TRAFFIC_LINE_LENGTH];
+    size_t hosts = traffic->hosts, src = 0;
+    FILE *file;
+
+    if ((file = fopen(path, "r")) == NULL) {
+        log_perror("fopen");
+        return -1;
+    }
+
+    while (src < hosts && fgets(line, sizeof line, file) != NULL) {
+        char *p = line, *end;
+        while (*p == ' ' || *p == '\t')
+            p++;
+        if (*p == '#' || *p == '\n' || *p == '\0')
+            continue;
+
+        for (size_t dst = 0; dst < hosts; dst++) {
+            errno = 0;
+            long weight = strtol(p, &end, 10);
+            if (end == p || errno != 0 || weight < 0) {
+                log_error("%s: rank %zu lists fewer than %zu non-negative weights.\n", path, src, hosts);
+                fclose(file);
+                return -1;
+            }
+            if (dst == src && weight != 0) {
+                log_error("%s: rank %zu sends to itself.\n", path, src);
+                fclose(file);
+                return -1;
+            }
+            traffic->weights[src * hosts + dst] = (size_t)weight;
+            p = end;
+        }
+        src++;
+    }
+
+    fclose(file);
+    if (src < hosts) {
+        log_error("%s: %zu of %zu ranks found.\n", path, src, hosts);
+        return -1;
+    }
+
+    return 0;
+}
+
+/**
+ * Build the traffic matrix of the configured pattern for hosts ranks.
+ */
+int dccs_traffic_init(struct dccs_traffic *traffic, struct dccs_parameters *params, size_t hosts) {
+    unsigned short state[3] = { (unsigned short)params->seed, (unsigned short)(params->seed >> 16), 0x330e };
+
+    traffic->hosts = hosts;
+    traffic->weights = calloc(hosts * hosts, sizeof(size_t));
+    if (hosts < 2) {
+        log_error("Traffic patterns need at least 2 ranks.\n");
+        return -1;
+    }
+
+    switch (params->pattern) {
+        case PATTERN_PERMUTATION: {
+            // Sattolo's algorithm: a single cycle, so nobody sends to itself.
+            size_t *next = malloc(hosts * sizeof(size_t));
+            for (size_t r = 0; r < hosts; r++)
+                next[r] = r;
+            for (size_t r = hosts - 1; r > 0; r--) {
+                size_t k = (size_t)(nrand48(state) % (long)r);
+                size_t t = next[r];
+                next[r] = next[k];
+                next[k] = t;
+            }
+            for (size_t r = 0; r < hosts; r++)
+                traffic->weights[r * hosts + next[r]] = 1;
+            free(next);
+            break;
+        }
+        case PATTERN_INCAST: {
+            size_t fanin = params->fanin == 0 ? hosts - 1 : params->fanin;
+            if (fanin >= hosts) {
+                log_error("Incast fan-in %zu needs more than %zu ranks.\n", fanin, hosts);
+                return -1;
+            }
+            for (size_t r = 1; r <= fanin; r++)
+                traffic->weights[r * hosts] = 1;
+            break;
+        }
+        case PATTERN_SHUFFLE:
+            for (size_t src = 0; src < hosts; src++) {
+                for (size_t dst = 0; dst < hosts; dst++)
+                    traffic->weights[src * hosts + dst] = src != dst;
+            }
+            break;
+        case PATTERN_FILE:
+            return dccs_traffic_load(traffic, params->traffic_file);
+        default:
+            log_error("Unknown traffic pattern: %d.\n", params->pattern);
+            return -1;
+    }
+
+    return 0;
+}
+
+void dccs_traffic_free(struct dccs_traffic *traffic) {
+    free(traffic->weights);
+    traffic->weights = NULL;
+}
+
+/**
+ * Load the size distribution, or use the block size without a CDF file.
+ * Draws are seeded per rank.
+ */
+int dccs_sizes_init(struct dccs_sizes *sizes, struct dccs_parameters *params, size_t rank) {
+    char line[TRAFFIC_LINE_LENGTH];
+    size_t capacity = 64;
+    FILE *file;
+
+    memset(sizes, 0, sizeof *sizes);
+    sizes->fixed = sizes->max = params->length;
+    sizes->state[0] = (unsigned short)params->seed;
+    sizes->state[1] = (unsigned short)(params->seed >> 16);
+    sizes->state[2] = (unsigned short)rank;
+    if (params->sizes == NULL)
+        return 0;
+
+    if ((file = fopen(params->sizes, "r")) == NULL) {
+        log_perror("fopen");
+        return -1;
+    }
+
+    sizes->sizes = malloc(capacity * sizeof(double));
+    sizes->cdf = malloc(capacity * sizeof(double));
+    while (fgets(line, sizeof line, file) != NULL) {
+        char *p = line, *end;
+        double value, size, cdf = -1;
+        while (*p == ' ' || *p == '\t')
+            p++;
+        if (*p == '#' || *p == '\n' || *p == '\0')
+            continue;
+
+        size = strtod(p, &end);
+        for (p = end; (value = strtod(p, &end)), end != p; p = end)
+            cdf = value;
+        if (size < 1 || cdf < 0 || (sizes->points > 0 && cdf < sizes->cdf[sizes->points - 1])) {
+            log_error("%s: invalid point after %zu point(s).\n", params->sizes, sizes->points);
+            fclose(file);
+            return -1;
+        }
+
+        if (sizes->points == capacity) {
+            capacity *= 2;
+            sizes->sizes = realloc(sizes->sizes, capacity * sizeof(double));
+            sizes->cdf = realloc(sizes->cdf, capacity * sizeof(double));
+        }
+        sizes->sizes[sizes->points] = size;
+        sizes->cdf[sizes->points++] = cdf;
+        if ((size_t)size > sizes->max || sizes->points == 1)
+            sizes->max = (size_t)size;
+    }
+
+    fclose(file);
+    if (sizes->points == 0 || sizes->cdf[sizes->points - 1] <= 0) {
+        log_error("%s: no distribution found.\n", params->sizes);
+        return -1;
+    }
+
+    // Percentages or fractions alike
+    double total = sizes->cdf[sizes->points - 1];
+    for (size_t k = 0; k < sizes->points; k++)
+        sizes->cdf[k] /= total;
+
+    return 0;
+}
+
+/**
+ * Draw a message size.
+ */
+size_t dccs_sizes_next(struct dccs_sizes *sizes) {
+    if (sizes->points == 0)
+        return sizes->fixed;
+
+    double u = erand48(sizes->state);
+    size_t k = 0;
+    while (k < sizes->points - 1 && sizes->cdf[k] < u)
+        k++;
+    if (k == 0)
+        return (size_t)sizes->sizes[0];
+
+    double low = sizes->cdf[k - 1], high = sizes->cdf[k];
+    double fraction = high > low ? (u - low) / (high - low) : 1;
+    return (size_t)llround(sizes->sizes[k - 1] + fraction * (sizes->sizes[k] - sizes->sizes[k - 1]));
+}
+
+void dccs_sizes_free(struct dccs_sizes *sizes) {
+    free(sizes->sizes);
+    free(sizes->cdf);
+    sizes->sizes = sizes->cdf = NULL;
+}
+
+#endif // DCCS_TRAFFIC_H
@@ -0,0 +1,127 @@
+/**
+ * Transport interface, with RDMA verbs and MPI backends.
+ *
+ * Follows docs/transport_daemon.md: a server listens and accepts peers, a
+ * client connects to one server, and both then move messages with
+ * asynchronous isend/irecv, reap completions with poll, and synchronize with
+ * barrier. Memory is registered transparently, or ahead of time with the
+ * optional register_buffer; a buffer must go through the optional
+ * deregister_buffer before it is freed. Peers are numbered from 0 in accept
+ * (or connect) order. The optional isend_tag attaches a tag to a message, which its
+ * receive completion reports; it labels messages but does not match them.
+ *
+ * The backends differ in matching, so two rules keep them interchangeable:
+ *  - a receive must be posted before its message can arrive, since verbs has
+ *    no unexpected-message queue and matches receives in posting order;
+ *  - nothing may be outstanding across barrier().
+ */
+
+#ifndef DCCS_TRANSPORT_H
+#define DCCS_TRANSPORT_H
+
+#include "dccs_utils.h"
+
+#define TRANSPORT_POLL_BATCH 16
+#define TRANSPORT_BARRIER_WR_ID UINT64_MAX
+#define TRANSPORT_TOKEN_LENGTH 8
+#define TRANSPORT_TAG 0             // Tag of a message sent with isend
+#define TRANSPORT_MAX_TAG 32767     // The least upper bound MPI guarantees
+
+struct dccs_completion {
+    uint64_t wr_id;
+    int peer;
+    size_t length;      // Bytes received, for receives
+    uint32_t tag;       // Sender's tag, for receives
+    bool is_send;
+    bool ok;
+};
+
+struct dccs_transport;
+
+struct dccs_transport_ops {
+    const char *name;
+
+    // Set up the backend and decide the role; MPI takes the command line.
+    int (*init)(struct dccs_transport *t, int *argc, char ***argv);
+    int (*listen)(struct dccs_transport *t, char *port);
+    int (*accept)(struct dccs_transport *t);                            // New peer, or negative
+    int (*connect)(struct dccs_transport *t, char *server, char *port); // Server peer, or negative
+    void (*disconnect)(struct dccs_transport *t);
+
+    int (*isend)(struct dccs_transport *t, int peer, void *buf, size_t length, uint64_t wr_id);
+    int (*irecv)(struct dccs_transport *t, int peer, void *buf, size_t length, uint64_t wr_id);
+    int (*poll)(struct dccs_transport *t, struct dccs_completion *completions, int max);    // Count, or negative
+    int (*barrier)(struct dccs_transport *t);
+
+    // Optional: register a buffer with every connected peer before first use.
+    int (*register_buffer)(struct dccs_transport *t, void *buf, size_t length);
+    // Optional: forget what was registered for a buffer before it is freed.
+    void (*deregister_buffer)(struct dccs_transport *t, void *buf);
+    // Optional: isend with a tag for the receiver, at most TRANSPORT_MAX_TAG.
+    int (*isend_tag)(struct dccs_transport *t, int peer, void *buf, size_t length, uint32_t tag, uint64_t wr_id);
+};
+
+struct dccs_transport {
+    const struct dccs_transport_ops *ops;
+    struct dccs_parameters *params;
+    bool server;
+    size_t expected_peers;  // Peers a server accepts
+    size_t peer_count;
+    void *state;
+};
+
+/**
+ * Poll until at least one completion is reaped.
+ */
+static inline int dccs_transport_wait(struct dccs_transport *t, struct dccs_completion *completions, int max) {
+    int rv;
+    while ((rv = t->ops->poll(t, completions, max)) == 0)
+        ;
+
+    return rv;
+}
+
+/**
+ * Barrier out of messages, for backends without their own: clients send a
+ * token to the server and wait for its reply, which the server sends once it
+ * holds a token from every peer.
+ */
+static int dccs_transport_token_barrier(struct dccs_transport *t, void *token) {
+    struct dccs_completion completions[TRANSPORT_POLL_BATCH];
+    size_t peers = t->peer_count, expected = t->server ? peers : 2, done = 0;
+
+    if (!t->server) {
+        if (t->ops->irecv(t, 0, token, TRANSPORT_TOKEN_LENGTH, TRANSPORT_BARRIER_WR_ID) != 0 ||
+                t->ops->isend(t, 0, token, TRANSPORT_TOKEN_LENGTH, TRANSPORT_BARRIER_WR_ID) != 0)
+            return -1;
+    } else {
+        for (size_t p = 0; p < peers; p++) {
+            if (t->ops->irecv(t, (int)p, token, TRANSPORT_TOKEN_LENGTH, TRANSPORT_BARRIER_WR_ID) != 0)
+                return -1;
+        }
+    }
+
+    while (done < expected) {
+        int rv = dccs_transport_wait(t, completions, TRANSPORT_POLL_BATCH);
+        if (rv < 0)
+            return rv;
+        for (int k = 0; k < rv; k++) {
+            if (!completions[k].ok || completions[k].wr_id != TRANSPORT_BARRIER_WR_ID)
+                return -1;
+        }
+        done += (size_t)rv;
+
+        // Every token is in; release the clients.
+        if (t->server && done == peers && expected == peers) {
+            for (size_t p = 0; p < peers; p++) {
+                if (t->ops->isend(t, (int)p, token, TRANSPORT_TOKEN_LENGTH, TRANSPORT_BARRIER_WR_ID) != 0)
+                    return -1;
+            }
+            expected += peers;
+        }
+    }
+
+    return 0;
+}
+
+#endif // DCCS_TRANSPORT_H
@@ -0,0 +1,278 @@
+/**
+ * Daemon backend of the transport interface: moves messages through a
+ * transport daemon (daemon_main.c) over one channel of its shared memory
+ * segment. The daemon holds the connections, so listen, accept and connect
+ * only assign its peers, and the role is the daemon's.
+ *
+ * Buffers handed out by daemon_transport_alloc() are the channel's own and
+ * are sent without a copy; any other buffer, or one of ours that already
+ * has a request outstanding, is staged through a free buffer of the channel,
+ * as a slot carries one request at a time. The daemon tags messages with the channel, so tags are not
+ * the application's: isend_tag is not offered and receives report
+ * TRANSPORT_TAG.
+ */
+
+#ifndef DCCS_TRANSPORT_DAEMON_H
+#define DCCS_TRANSPORT_DAEMON_H
+
+#include "dccs_shm.h"
+#include "dccs_transport.h"
+
+struct daemon_transport_slot {
+    uint64_t wr_id;
+    void *staged;       // Caller's buffer behind a staged receive, or NULL
+    bool allocated;     // Handed out by daemon_transport_alloc()
+    bool busy;          // A request is outstanding on it
+};
+
+struct daemon_transport_state {
+    struct dccs_shm shm;
+    struct dccs_shm_channel *channel;
+    int channel_index;
+    int next_peer;
+
+    struct daemon_transport_slot slots[SHM_SLOTS];
+    uint32_t free_slots[SHM_SLOTS];     // Neither allocated nor in flight
+    size_t free_count;
+
+    // Completions reaped while waiting for a free buffer, not yet returned
+    struct dccs_completion ready[2 * SHM_SLOTS];
+    size_t ready_head;
+    size_t ready_count;
+
+    uint8_t token[TRANSPORT_TOKEN_LENGTH];
+};
+
+static int daemon_transport_init(struct dccs_transport *t, int *argc, char ***argv) {
+    struct daemon_transport_state *s = calloc(1, sizeof(struct daemon_transport_state));
+    (void)argc;
+    (void)argv;
+
+    t->state = s;
+    if ((s->channel_index = dccs_shm_attach(&s->shm, t->params->shm_name)) < 0) {
+        free(s);
+        t->state = NULL;
+        return -1;
+    }
+
+    s->channel = s->shm.header->channels + s->channel_index;
+    for (uint32_t slot = SHM_SLOTS; slot > 0; slot--)
+        s->free_slots[s->free_count++] = slot - 1;
+
+    t->server = s->shm.header->server != 0;
+    t->expected_peers = s->shm.header->peer_count;
+    t->peer_count = 0;
+    return 0;
+}
+
+static int daemon_transport_listen(struct dccs_transport *t, char *port) {
+    (void)port;
+    return t->server ? 0 : -1;
+}
+
+static int daemon_transport_accept(struct dccs_transport *t) {
+    struct daemon_transport_state *s = t->state;
+
+    if ((size_t)s->next_peer >= t->expected_peers)
+        return -1;
+
+    t->peer_count++;
+    return s->next_peer++;
+}
+
+static int daemon_transport_connect(struct dccs_transport *t, char *server, char *port) {
+    (void)server;
+    (void)port;
+
+    if (t->server || t->expected_peers == 0)
+        return -1;
+
+    t->peer_count = 1;
+    return 0;
+}
+
+static void daemon_transport_disconnect(struct dccs_transport *t) {
+    struct daemon_transport_state *s = t->state;
+
+    dccs_shm_detach(&s->shm, s->channel_index);
+    free(s);
+    t->state = NULL;
+}
+
+/**
+ * A message buffer of the channel, or NULL if none is free or length does
+ * not fit one.
+ */
+void *daemon_transport_alloc(struct dccs_transport *t, size_t length) {
+    struct daemon_transport_state *s = t->state;
+
+    if (length > s->shm.header->slot_size || s->free_count == 0)
+        return NULL;
+
+    uint32_t slot = s->free_slots[--s->free_count];
+    s->slots[slot].allocated = true;
+    return dccs_shm_buffer(&s->shm, (size_t)s->channel_index, slot);
+}
+
+/**
+ * The channel buffer at buf, or -1 if buf does not start one.
+ */
+static int daemon_transport_slot_of(struct daemon_transport_state *s, const void *buf) {
+    const uint8_t *first = dccs_shm_buffer(&s->shm, (size_t)s->channel_index, 0);
+    size_t slot_size = s->shm.header->slot_size;
+
+    if ((const uint8_t *)buf < first || (const uint8_t *)buf >= first + SHM_SLOTS * slot_size)
+        return -1;
+
+    size_t offset = (size_t)((const uint8_t *)buf - first);
+    return offset % slot_size == 0 ? (int)(offset / slot_size) : -1;
+}
+
+/**
+ * Return a buffer from daemon_transport_alloc(); false if buf is not one.
+ */
+bool daemon_transport_free(struct dccs_transport *t, void *buf) {
+    struct daemon_transport_state *s = t->state;
+    int slot = daemon_transport_slot_of(s, buf);
+
+    if (slot < 0 || !s->slots[slot].allocated)
+        return false;
+
+    // A busy slot is returned by its completion.
+    s->slots[slot].allocated = false;
+    if (!s->slots[slot].busy)
+        s->free_slots[s->free_count++] = (uint32_t)slot;
+    return true;
+}
+
+/**
+ * Turn one response into a completion, unstaging its buffer.
+ */
+static void daemon_transport_complete(struct daemon_transport_state *s, struct dccs_shm_entry *entry,
+                                      struct dccs_completion *c) {
+    struct daemon_transport_slot *slot = s->slots + entry->slot;
+
+    c->wr_id = slot->wr_id;
+    slot->busy = false;
+    c->peer = entry->peer;
+    c->is_send = entry->op == SHM_OP_SEND;
+    c->length = c->is_send ? 0 : entry->length;
+    c->tag = TRANSPORT_TAG;
+    c->ok = entry->status == 0;
+    if (!c->ok)
+        log_error("Daemon failed a %s with peer %d, error = %d.\n", c->is_send ? "send" : "receive", c->peer,
+                  entry->status);
+
+    if (slot->allocated)
+        return;
+    if (slot->staged != NULL && c->ok)
+        memcpy(slot->staged, dccs_shm_buffer(&s->shm, (size_t)s->channel_index, entry->slot), entry->length);
+    slot->staged = NULL;
+    s->free_slots[s->free_count++] = entry->slot;
+}
+
+/**
+ * Reap responses into the ready queue until a buffer is free to stage a
+ * message through.
+ */
+static int daemon_transport_reserve(struct daemon_transport_state *s) {
+    struct dccs_shm_entry entry;
+
+    while (s->free_count == 0) {
+        if (s->ready_count == sizeof s->ready / sizeof s->ready[0]) {
+            log_error("Too many completions not polled.\n");
+            return -1;
+        }
+        if (!__atomic_load_n(&s->shm.header->ready, __ATOMIC_ACQUIRE)) {
+            log_error("The transport daemon stopped.\n");
+            return -1;
+        }
+
+        if (dccs_ring_pop(&s->channel->responses, &entry)) {
+            size_t tail = (s->ready_head + s->ready_count++) % (sizeof s->ready / sizeof s->ready[0]);
+            daemon_transport_complete(s, &entry, s->ready + tail);
+        }
+    }
+
+    return 0;
+}
+
+static int daemon_transport_post(struct dccs_transport *t, ShmOp op, int peer, void *buf, size_t length,
+                                 uint64_t wr_id) {
+    struct daemon_transport_state *s = t->state;
+    int slot = daemon_transport_slot_of(s, buf);
+
+    if (length > s->shm.header->slot_size) {
+        log_error("Message of %zu bytes exceeds the daemon's %zu-byte buffers.\n", length, s->shm.header->slot_size);
+        return -1;
+    }
+
+    // Anything but one of our idle buffers is staged.
+    if (slot < 0 || !s->slots[slot].allocated || s->slots[slot].busy) {
+        if (daemon_transport_reserve(s) != 0)
+            return -1;
+        slot = (int)s->free_slots[--s->free_count];
+        if (op == SHM_OP_SEND)
+            memcpy(dccs_shm_buffer(&s->shm, (size_t)s->channel_index, (size_t)slot), buf, length);
+        else
+            s->slots[slot].staged = buf;
+    }
+
+    struct dccs_shm_entry entry = {
+        .op = op,
+        .slot = (uint32_t)slot,
+        .length = length,
+        .peer = peer,
+    };
+    s->slots[slot].wr_id = wr_id;
+    if (!dccs_ring_push(&s->channel->requests, &entry)) {
+        log_error("Request ring of channel %d is full.\n", s->channel_index);
+        return -1;
+    }
+    s->slots[slot].busy = true;
+
+    return 0;
+}
+
+static int daemon_transport_isend(struct dccs_transport *t, int peer, void *buf, size_t length, uint64_t wr_id) {
+    return daemon_transport_post(t, SHM_OP_SEND, peer, buf, length, wr_id);
+}
+
+static int daemon_transport_irecv(struct dccs_transport *t, int peer, void *buf, size_t length, uint64_t wr_id) {
+    return daemon_transport_post(t, SHM_OP_RECV, peer, buf, length, wr_id);
+}
+
+static int daemon_transport_poll(struct dccs_transport *t, struct dccs_completion *completions, int max) {
+    struct daemon_transport_state *s = t->state;
+    struct dccs_shm_entry entry;
+    int count = 0;
+
+    while (count < max && s->ready_count > 0) {
+        completions[count++] = s->ready[s->ready_head];
+        s->ready_head = (s->ready_head + 1) % (sizeof s->ready / sizeof s->ready[0]);
+        s->ready_count--;
+    }
+    while (count < max && dccs_ring_pop(&s->channel->responses, &entry))
+        daemon_transport_complete(s, &entry, completions + count++);
+
+    return count;
+}
+
+static int daemon_transport_barrier(struct dccs_transport *t) {
+    return dccs_transport_token_barrier(t, ((struct daemon_transport_state *)t->state)->token);
+}
+
+static const struct dccs_transport_ops daemon_transport_ops = {
+    .name = "daemon",
+    .init = daemon_transport_init,
+    .listen = daemon_transport_listen,
+    .accept = daemon_transport_accept,
+    .connect = daemon_transport_connect,
+    .disconnect = daemon_transport_disconnect,
+    .isend = daemon_transport_isend,
+    .irecv = daemon_transport_irecv,
+    .poll = daemon_transport_poll,
+    .barrier = daemon_transport_barrier,
+};
+
+#endif // DCCS_TRANSPORT_DAEMON_H
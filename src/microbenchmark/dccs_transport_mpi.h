@@ -0,0 +1,202 @@
+/**
+ * MPI backend of the transport interface. Rank 0 is the server and every
+ * other rank a client, so listen, accept and connect only assign peers; the
+ * connections are MPI's. Requests live in a growable slot table whose
+ * completions MPI_Testsome reaps into a queue that poll drains. Tags ride
+ * on MPI's own; receives take any tag, so that, as with verbs, messages from
+ * one peer match receives in posting order whatever their tag.
+ */
+
+#ifndef DCCS_TRANSPORT_MPI_H
+#define DCCS_TRANSPORT_MPI_H
+
+#include <mpi.h>
+
+#include "dccs_transport.h"
+
+#define TRANSPORT_MPI_SLOTS 256     // Initial slots, doubled as needed
+
+struct mpi_slot {
+    uint64_t wr_id;
+    int peer;
+    bool is_send;
+};
+
+struct mpi_state {
+    int rank;
+    int size;
+    int next_peer;
+
+    MPI_Request *requests;
+    struct mpi_slot *slots;
+    int *free_slots;
+    int *indices;
+    MPI_Status *statuses;
+    size_t capacity;
+    size_t free_count;
+
+    // Completions reaped but not yet returned
+    struct dccs_completion *ready;
+    size_t ready_head;
+    size_t ready_count;
+};
+
+static void mpi_transport_grow(struct mpi_state *s, size_t capacity) {
+    s->requests = realloc(s->requests, capacity * sizeof(MPI_Request));
+    s->slots = realloc(s->slots, capacity * sizeof(struct mpi_slot));
+    s->free_slots = realloc(s->free_slots, capacity * sizeof(int));
+    s->indices = realloc(s->indices, capacity * sizeof(int));
+    s->statuses = realloc(s->statuses, capacity * sizeof(MPI_Status));
+    s->ready = realloc(s->ready, capacity * sizeof(struct dccs_completion));
+    for (size_t k = s->capacity; k < capacity; k++) {
+        s->requests[k] = MPI_REQUEST_NULL;
+        s->free_slots[s->free_count++] = (int)k;
+    }
+
+    s->capacity = capacity;
+}
+
+static int mpi_transport_init(struct dccs_transport *t, int *argc, char ***argv) {
+    struct mpi_state *s = calloc(1, sizeof(struct mpi_state));
+
+    MPI_Init(argc, argv);
+    MPI_Comm_rank(MPI_COMM_WORLD, &s->rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &s->size);
+    mpi_transport_grow(s, TRANSPORT_MPI_SLOTS);
+
+    t->state = s;
+    t->server = s->rank == 0;
+    t->expected_peers = (size_t)s->size - 1;
+    t->peer_count = 0;
+    if (s->size < 2) {
+        log_error("The MPI backend needs at least 2 ranks.\n");
+        return -1;
+    }
+
+    return 0;
+}
+
+static int mpi_transport_listen(struct dccs_transport *t, char *port) {
+    (void)port;
+    return t->server ? 0 : -1;
+}
+
+static int mpi_transport_accept(struct dccs_transport *t) {
+    struct mpi_state *s = t->state;
+
+    if (s->next_peer >= s->size - 1)
+        return -1;
+
+    t->peer_count++;
+    return s->next_peer++;
+}
+
+static int mpi_transport_connect(struct dccs_transport *t, char *server, char *port) {
+    (void)server;
+    (void)port;
+
+    t->peer_count = 1;
+    return 0;
+}
+
+static void mpi_transport_disconnect(struct dccs_transport *t) {
+    struct mpi_state *s = t->state;
+
+    free(s->requests);
+    free(s->slots);
+    free(s->free_slots);
+    free(s->indices);
+    free(s->statuses);
+    free(s->ready);
+    free(s);
+    t->state = NULL;
+    MPI_Finalize();
+}
+
+static inline int mpi_transport_rank(struct dccs_transport *t, int peer) {
+    return t->server ? peer + 1 : 0;
+}
+
+static MPI_Request *mpi_transport_slot(struct mpi_state *s, int peer, uint64_t wr_id, bool is_send) {
+    if (s->free_count == 0)
+        mpi_transport_grow(s, 2 * s->capacity);
+
+    int slot = s->free_slots[--s->free_count];
+    s->slots[slot] = (struct mpi_slot){ wr_id, peer, is_send };
+    return s->requests + slot;
+}
+
+static int mpi_transport_isend_tag(struct dccs_transport *t, int peer, void *buf, size_t length, uint32_t tag,
+                                   uint64_t wr_id) {
+    struct mpi_state *s = t->state;
+    MPI_Request *request = mpi_transport_slot(s, peer, wr_id, true);
+    return MPI_Isend(buf, (int)length, MPI_BYTE, mpi_transport_rank(t, peer), (int)tag, MPI_COMM_WORLD,
+                     request) == MPI_SUCCESS ? 0 : -1;
+}
+
+static int mpi_transport_isend(struct dccs_transport *t, int peer, void *buf, size_t length, uint64_t wr_id) {
+    return mpi_transport_isend_tag(t, peer, buf, length, TRANSPORT_TAG, wr_id);
+}
+
+static int mpi_transport_irecv(struct dccs_transport *t, int peer, void *buf, size_t length, uint64_t wr_id) {
+    struct mpi_state *s = t->state;
+    MPI_Request *request = mpi_transport_slot(s, peer, wr_id, false);
+    return MPI_Irecv(buf, (int)length, MPI_BYTE, mpi_transport_rank(t, peer), MPI_ANY_TAG, MPI_COMM_WORLD,
+                     request) == MPI_SUCCESS ? 0 : -1;
+}
+
+static int mpi_transport_poll(struct dccs_transport *t, struct dccs_completion *completions, int max) {
+    struct mpi_state *s = t->state;
+
+    if (s->ready_count == 0 && s->free_count < s->capacity) {
+        int outcount;
+        MPI_Testsome((int)s->capacity, s->requests, &outcount, s->indices, s->statuses);
+        for (int k = 0; outcount != MPI_UNDEFINED && k < outcount; k++) {
+            int slot = s->indices[k];
+            struct dccs_completion *c = s->ready + s->ready_count++;
+            c->wr_id = s->slots[slot].wr_id;
+            c->peer = s->slots[slot].peer;
+            c->is_send = s->slots[slot].is_send;
+            c->length = 0;
+            c->tag = TRANSPORT_TAG;
+            c->ok = true;
+            if (!c->is_send) {
+                int length;
+                MPI_Get_count(s->statuses + k, MPI_BYTE, &length);
+                c->length = (size_t)length;
+                c->tag = (uint32_t)s->statuses[k].MPI_TAG;
+            }
+            s->free_slots[s->free_count++] = slot;
+        }
+        s->ready_head = 0;
+    }
+
+    int count = 0;
+    while (count < max && s->ready_count > 0) {
+        completions[count++] = s->ready[s->ready_head++];
+        s->ready_count--;
+    }
+
+    return count;
+}
+
+static int mpi_transport_barrier(struct dccs_transport *t) {
+    (void)t;
+    return MPI_Barrier(MPI_COMM_WORLD) == MPI_SUCCESS ? 0 : -1;
+}
+
+static const struct dccs_transport_ops mpi_transport_ops = {
+    .name = "mpi",
+    .init = mpi_transport_init,
+    .listen = mpi_transport_listen,
+    .accept = mpi_transport_accept,
+    .connect = mpi_transport_connect,
+    .disconnect = mpi_transport_disconnect,
+    .isend = mpi_transport_isend,
+    .irecv = mpi_transport_irecv,
+    .poll = mpi_transport_poll,
+    .barrier = mpi_transport_barrier,
+    .isend_tag = mpi_transport_isend_tag,
+};
+
+#endif // DCCS_TRANSPORT_MPI_H
@@ -0,0 +1,295 @@
+/**
+ * RDMA verbs backend of the transport interface: one RC connection per
+ * peer through librdmacm, two-sided SEND/RECV, and a growable per-peer
+ * cache of memory regions registered on first use and dropped by
+ * deregister_buffer. A tag travels as the immediate
+ * data of a SEND_WITH_IMM.
+ */
+
+#ifndef DCCS_TRANSPORT_VERBS_H
+#define DCCS_TRANSPORT_VERBS_H
+
+#include "dccs_rdma.h"
+#include "dccs_transport.h"
+
+#define TRANSPORT_MR_CACHE 64      // Initial cache entries per peer, doubled as needed
+
+struct verbs_mr_entry {
+    void *addr;
+    size_t length;
+    struct ibv_mr *mr;
+};
+
+struct verbs_peer {
+    struct rdma_cm_id *id;
+    struct verbs_mr_entry *mrs;
+    size_t mr_count;
+    size_t mr_capacity;
+};
+
+struct verbs_state {
+    struct rdma_cm_id *listen_id;
+    struct rdma_cm_id *pending;     // Accepted along with the listen
+    struct verbs_peer *peers;
+    size_t next_poll;
+    uint8_t token[TRANSPORT_TOKEN_LENGTH];
+};
+
+static int verbs_init(struct dccs_transport *t, int *argc, char ***argv) {
+    (void)argc;
+    (void)argv;
+
+    t->server = t->params->server == NULL;
+    t->expected_peers = t->params->peers;
+    t->peer_count = 0;
+    t->state = calloc(1, sizeof(struct verbs_state));
+    return 0;
+}
+
+static int verbs_add_peer(struct dccs_transport *t, struct rdma_cm_id *id) {
+    struct verbs_state *s = t->state;
+
+    s->peers = realloc(s->peers, (t->peer_count + 1) * sizeof(struct verbs_peer));
+    memset(s->peers + t->peer_count, 0, sizeof(struct verbs_peer));
+    s->peers[t->peer_count].id = id;
+    return (int)t->peer_count++;
+}
+
+static int verbs_listen(struct dccs_transport *t, char *port) {
+    struct verbs_state *s = t->state;
+    int rv;
+
+    // dccs_listen() also takes the first connection; accept() hands it out.
+    if ((rv = dccs_listen(&s->listen_id, &s->pending, port, 1)) != 0)
+        log_error("Failed to listen on port %s.\n", port);
+
+    return rv;
+}
+
+static int verbs_accept(struct dccs_transport *t) {
+    struct verbs_state *s = t->state;
+    struct rdma_cm_id *id;
+
+    if (s->pending != NULL) {
+        id = s->pending;
+        s->pending = NULL;
+    } else if (dccs_accept(s->listen_id, &id) != 0) {
+        return -1;
+    }
+
+    return verbs_add_peer(t, id);
+}
+
+static int verbs_connect(struct dccs_transport *t, char *server, char *port) {
+    struct rdma_cm_id *id = NULL;
+
+    if (dccs_connect(&id, server, port, t->params->tos, 1) != 0) {
+        log_error("Failed to connect to %s:%s.\n", server, port);
+        return -1;
+    }
+
+    return verbs_add_peer(t, id);
+}
+
+static void verbs_disconnect(struct dccs_transport *t) {
+    struct verbs_state *s = t->state;
+
+    for (size_t p = 0; p < t->peer_count; p++) {
+        for (size_t k = 0; k < s->peers[p].mr_count; k++)
+            dccs_dereg_mr(s->peers[p].mrs[k].mr);
+        free(s->peers[p].mrs);
+        if (t->server) {
+            rdma_disconnect(s->peers[p].id);
+            rdma_destroy_ep(s->peers[p].id);
+        } else {
+            dccs_client_disconnect(s->peers[p].id);
+        }
+    }
+    if (s->listen_id != NULL)
+        rdma_destroy_ep(s->listen_id);
+
+    free(s->peers);
+    free(s);
+    t->state = NULL;
+}
+
+/**
+ * Find the region covering buf, or register one for it.
+ */
+static struct ibv_mr *verbs_mr(struct verbs_peer *peer, void *buf, size_t length) {
+    for (size_t k = 0; k < peer->mr_count; k++) {
+        struct verbs_mr_entry *e = peer->mrs + k;
+        if ((uint8_t *)buf >= (uint8_t *)e->addr && (uint8_t *)buf + length <= (uint8_t *)e->addr + e->length)
+            return e->mr;
+    }
+
+    struct ibv_mr *mr = dccs_reg_msgs(peer->id, buf, length);
+    if (mr == NULL)
+        return NULL;
+
+    if (peer->mr_count == peer->mr_capacity) {
+        peer->mr_capacity = peer->mr_capacity == 0 ? TRANSPORT_MR_CACHE : 2 * peer->mr_capacity;
+        peer->mrs = realloc(peer->mrs, peer->mr_capacity * sizeof(struct verbs_mr_entry));
+    }
+    peer->mrs[peer->mr_count++] = (struct verbs_mr_entry){ buf, length, mr };
+
+    return mr;
+}
+
+static int verbs_register_buffer(struct dccs_transport *t, void *buf, size_t length) {
+    struct verbs_state *s = t->state;
+
+    for (size_t p = 0; p < t->peer_count; p++) {
+        if (verbs_mr(s->peers + p, buf, length) == NULL)
+            return -1;
+    }
+
+    return 0;
+}
+
+/**
+ * Deregister the regions registered for a buffer starting at buf, which is
+ * about to be freed, so that no later buffer at its address matches them.
+ */
+static void verbs_deregister_buffer(struct dccs_transport *t, void *buf) {
+    struct verbs_state *s = t->state;
+
+    for (size_t p = 0; p < t->peer_count; p++) {
+        struct verbs_peer *peer = s->peers + p;
+        for (size_t k = 0; k < peer->mr_count; ) {
+            if (peer->mrs[k].addr == buf) {
+                dccs_dereg_mr(peer->mrs[k].mr);
+                peer->mrs[k] = peer->mrs[--peer->mr_count];
+            } else {
+                k++;
+            }
+        }
+    }
+}
+
+static int verbs_isend(struct dccs_transport *t, int peer, void *buf, size_t length, uint64_t wr_id) {
+    struct verbs_peer *p = ((struct verbs_state *)t->state)->peers + peer;
+    struct ibv_mr *mr;
+    int rv;
+
+    if ((mr = verbs_mr(p, buf, length)) == NULL)
+        return -1;
+    if ((rv = rdma_post_send(p->id, (void *)(uintptr_t)wr_id, buf, length, mr, IBV_SEND_SIGNALED)) != 0)
+        log_perror("rdma_post_send");
+
+    return rv;
+}
+
+static int verbs_isend_tag(struct dccs_transport *t, int peer, void *buf, size_t length, uint32_t tag,
+                           uint64_t wr_id) {
+    struct verbs_peer *p = ((struct verbs_state *)t->state)->peers + peer;
+    struct ibv_send_wr wr, *bad;
+    struct ibv_sge sge;
+    struct ibv_mr *mr;
+    int rv;
+
+    if ((mr = verbs_mr(p, buf, length)) == NULL)
+        return -1;
+
+    sge.addr = (uint64_t)(uintptr_t)buf;
+    sge.length = (uint32_t)length;
+    sge.lkey = mr->lkey;
+    memset(&wr, 0, sizeof wr);
+    wr.wr_id = wr_id;
+    wr.sg_list = &sge;
+    wr.num_sge = 1;
+    wr.opcode = IBV_WR_SEND_WITH_IMM;
+    wr.send_flags = IBV_SEND_SIGNALED;
+    wr.imm_data = htonl(tag);
+
+    if ((rv = ibv_post_send(p->id->qp, &wr, &bad)) != 0)
+        log_error("ibv_post_send() failed, error = %d.\n", rv);
+
+    return rv;
+}
+
+static int verbs_irecv(struct dccs_transport *t, int peer, void *buf, size_t length, uint64_t wr_id) {
+    struct verbs_peer *p = ((struct verbs_state *)t->state)->peers + peer;
+    struct ibv_mr *mr;
+    int rv;
+
+    if ((mr = verbs_mr(p, buf, length)) == NULL)
+        return -1;
+    if ((rv = rdma_post_recv(p->id, (void *)(uintptr_t)wr_id, buf, length, mr)) != 0)
+        log_perror("rdma_post_recv");
+
+    return rv;
+}
+
+/**
+ * Reap completions from one CQ. Its direction comes from the CQ, since a
+ * failed completion's opcode is undefined.
+ */
+static int verbs_poll_cq(struct ibv_cq *cq, int peer, bool is_send, struct dccs_completion *completions, int max) {
+    struct ibv_wc wc[TRANSPORT_POLL_BATCH];
+    int rv = ibv_poll_cq(cq, max < TRANSPORT_POLL_BATCH ? max : TRANSPORT_POLL_BATCH, wc);
+    if (rv < 0) {
+        log_error("ibv_poll_cq() failed, error = %d.\n", rv);
+        return rv;
+    }
+
+    for (int k = 0; k < rv; k++) {
+        struct dccs_completion *c = completions + k;
+        c->wr_id = wc[k].wr_id;
+        c->peer = peer;
+        c->is_send = is_send;
+        c->length = c->is_send ? 0 : wc[k].byte_len;
+        c->tag = !c->is_send && (wc[k].wc_flags & IBV_WC_WITH_IMM) ? ntohl(wc[k].imm_data) : TRANSPORT_TAG;
+        c->ok = wc[k].status == IBV_WC_SUCCESS;
+        if (!c->ok)
+            log_error("Failed status %s (%d) from peer %d\n", ibv_wc_status_str(wc[k].status), wc[k].status, peer);
+    }
+
+    return rv;
+}
+
+/**
+ * Reap completions from every peer, starting from a different peer each
+ * call so that none is starved.
+ */
+static int verbs_poll(struct dccs_transport *t, struct dccs_completion *completions, int max) {
+    struct verbs_state *s = t->state;
+    int count = 0, rv;
+
+    for (size_t k = 0; k < t->peer_count && count < max; k++) {
+        size_t p = (s->next_poll + k) % t->peer_count;
+        struct rdma_cm_id *id = s->peers[p].id;
+
+        if ((rv = verbs_poll_cq(id->send_cq, (int)p, true, completions + count, max - count)) < 0)
+            return rv;
+        count += rv;
+        if ((rv = verbs_poll_cq(id->recv_cq, (int)p, false, completions + count, max - count)) < 0)
+            return rv;
+        count += rv;
+    }
+    s->next_poll = t->peer_count == 0 ? 0 : (s->next_poll + 1) % t->peer_count;
+
+    return count;
+}
+
+static int verbs_barrier(struct dccs_transport *t) {
+    return dccs_transport_token_barrier(t, ((struct verbs_state *)t->state)->token);
+}
+
+static const struct dccs_transport_ops verbs_transport_ops = {
+    .name = "verbs",
+    .init = verbs_init,
+    .listen = verbs_listen,
+    .accept = verbs_accept,
+    .connect = verbs_connect,
+    .disconnect = verbs_disconnect,
+    .isend = verbs_isend,
+    .irecv = verbs_irecv,
+    .poll = verbs_poll,
+    .barrier = verbs_barrier,
+    .register_buffer = verbs_register_buffer,
+    .deregister_buffer = verbs_deregister_buffer,
+    .isend_tag = verbs_isend_tag,
+};
+
+#endif // DCCS_TRANSPORT_VERBS_H
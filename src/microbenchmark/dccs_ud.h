@@ -0,0 +1,643 @@
+/**
+ * Unreliable Datagram (UD) transport for DC circuit switch
+ *
+ * Each host owns a single UD QP and reaches every peer through an address
+ * handle, instead of one RC QP per peer. rdma_cm is only used to resolve
+ * addresses: the client learns each server's AH/QPN/qkey from the SIDR
+ * reply, and the server learns each client's AH from the GRH of the first
+ * datagram it receives from it. That greeting also carries how many
+ * datagrams per round the client sends to the server, its share of a round
+ * spread over several servers.
+ */
+
+#ifndef DCCS_UD_H
+#define DCCS_UD_H
+
+#include "dccs_parameters.h"
+#include "dccs_utils.h"
+#include "dccs_rdma.h"
+
+#define UD_GRH_LENGTH sizeof(struct ibv_grh)
+#define UD_IMM_HELLO 0xffffffffU    // Immediate of handshake datagrams
+#define UD_IPV4_HEADER_LENGTH 20
+
+struct dccs_ud_peer {
+    struct rdma_cm_id *id;  // Only used for address resolution
+    struct ibv_ah *ah;
+    uint32_t qpn;
+    uint32_t qkey;
+    // QPNs are per HCA, so datagrams are told apart by their source address
+    // too: its GID if they carry a GRH (always on RoCE), else its LID.
+    uint16_t lid;
+    union ibv_gid gid;
+    size_t expected;        // Server: datagrams per round from this client
+    size_t base;            // Server: index of its first arrival slot
+};
+
+struct dccs_ud_context {
+    struct rdma_cm_id *listen_id;
+    struct rdma_cm_id *qp_id;   // The id that owns the shared UD QP
+    struct ibv_qp *qp;
+    struct ibv_pd *pd;
+    struct ibv_cq *send_cq;
+    struct ibv_cq *recv_cq;
+    uint32_t mtu;
+
+    struct dccs_ud_peer *peers;
+    size_t peer_count;
+
+    // Receive ring; every slot reserves room for the GRH
+    uint8_t *ring;
+    struct ibv_mr *ring_mr;
+    size_t slot_length;
+    uint32_t *hello;        // Client: greeting payloads, past the ring
+};
+
+/* Setup/teardown */
+
+static inline void dccs_ud_init_qp_attr(struct ibv_qp_init_attr *attr) {
+    memset(attr, 0, sizeof *attr);
+    attr->cap.max_send_wr = attr->cap.max_recv_wr = MAX_WR;
+    attr->cap.max_send_sge = attr->cap.max_recv_sge = 1;
+    attr->qp_type = IBV_QPT_UD;
+}
+
+/**
+ * Record the shared QP and look up the path MTU, which bounds datagram size.
+ */
+int dccs_ud_attach_qp(struct dccs_ud_context *ctx, struct rdma_cm_id *id) {
+    struct ibv_port_attr port_attr;
+
+    ctx->qp_id = id;
+    ctx->qp = id->qp;
+    ctx->pd = id->pd;
+    ctx->send_cq = id->send_cq;
+    ctx->recv_cq = id->recv_cq;
+
+    if (ibv_query_port(id->verbs, id->port_num, &port_attr) != 0) {
+        log_perror("ibv_query_port");
+        return -1;
+    }
+
+    ctx->mtu = 128U << port_attr.active_mtu;
+    log_debug("UD QP %u, path MTU = %u.\n", ctx->qp->qp_num, ctx->mtu);
+    return 0;
+}
+
+/**
+ * Resolve every server in the comma-separated list and create an AH for it.
+ * The UD QP is created on the first server's id and shared by all.
+ */
+int dccs_ud_connect(struct dccs_ud_context *ctx, char *servers, char *port) {
+    struct rdma_addrinfo hints, *res;
+    struct ibv_qp_init_attr attr;
+    char *list, *server, *saveptr;
+    int rv = 0;
+
+    memset(ctx, 0, sizeof *ctx);
+    ctx->peer_count = 1;
+    for (char *c = servers; *c != '\0'; c++) {
+        if (*c == ',')
+            ctx->peer_count++;
+    }
+    ctx->peers = calloc(ctx->peer_count, sizeof(struct dccs_ud_peer));
+
+    memset(&hints, 0, sizeof hints);
+    hints.ai_port_space = RDMA_PS_UDP;
+    hints.ai_qp_type = IBV_QPT_UD;
+    dccs_ud_init_qp_attr(&attr);
+
+    list = strdup(servers);
+    size_t n = 0;
+    for (server = strtok_r(list, ",", &saveptr); server != NULL; server = strtok_r(NULL, ",", &saveptr), n++) {
+        struct dccs_ud_peer *peer = ctx->peers + n;
+
+        if ((rv = rdma_getaddrinfo(server, port, &hints, &res)) != 0) {
+            log_perror("rdma_getaddrinfo");
+            goto out_free_list;
+        }
+
+        rv = rdma_create_ep(&peer->id, res, ctx->pd, n == 0 ? &attr : NULL);
+        rdma_freeaddrinfo(res);
+        if (rv != 0) {
+            log_perror("rdma_create_ep");
+            goto out_free_list;
+        }
+
+        if (n == 0 && (rv = dccs_ud_attach_qp(ctx, peer->id)) != 0)
+            goto out_free_list;
+
+        // For UD, this resolves the route and exchanges a SIDR request/reply.
+        if ((rv = rdma_connect(peer->id, NULL)) != 0) {
+            log_perror("rdma_connect");
+            goto out_free_list;
+        }
+
+        struct rdma_ud_param *ud = &peer->id->event->param.ud;
+        peer->qpn = ud->qp_num;
+        peer->qkey = ud->qkey;
+        if (ud->ah_attr.is_global)
+            peer->gid = ud->ah_attr.grh.dgid;
+        else
+            peer->lid = ud->ah_attr.dlid;
+        if ((peer->ah = ibv_create_ah(ctx->pd, &ud->ah_attr)) == NULL) {
+            log_perror("ibv_create_ah");
+            rv = -1;
+            goto out_free_list;
+        }
+
+        log_debug("Resolved UD peer %s: qpn = %u.\n", server, peer->qpn);
+    }
+
+out_free_list:
+    free(list);
+    return rv;
+}
+
+/**
+ * Accept SIDR requests from the given number of clients, all answered with
+ * the QP created for the first one. The AHs are filled in by the handshake.
+ */
+int dccs_ud_listen(struct dccs_ud_context *ctx, char *port, size_t peer_count) {
+    struct rdma_addrinfo hints, *res;
+    struct ibv_qp_init_attr attr;
+    struct rdma_conn_param conn_param;
+    int rv;
+
+    memset(ctx, 0, sizeof *ctx);
+    ctx->peer_count = peer_count;
+    ctx->peers = calloc(peer_count, sizeof(struct dccs_ud_peer));
+
+    memset(&hints, 0, sizeof hints);
+    hints.ai_flags = RAI_PASSIVE;
+    hints.ai_port_space = RDMA_PS_UDP;
+    hints.ai_qp_type = IBV_QPT_UD;
+    if ((rv = rdma_getaddrinfo(NULL, port, &hints, &res)) != 0) {
+        log_perror("rdma_getaddrinfo");
+        return rv;
+    }
+
+    rv = rdma_create_ep(&ctx->listen_id, res, NULL, NULL);
+    rdma_freeaddrinfo(res);
+    if (rv != 0) {
+        log_perror("rdma_create_ep");
+        return rv;
+    }
+
+    if ((rv = rdma_listen(ctx->listen_id, 0)) != 0) {
+        log_perror("rdma_listen");
+        return rv;
+    }
+
+    dccs_ud_init_qp_attr(&attr);
+    for (size_t n = 0; n < peer_count; n++) {
+        struct dccs_ud_peer *peer = ctx->peers + n;
+
+        if ((rv = rdma_get_request(ctx->listen_id, &peer->id)) != 0) {
+            log_perror("rdma_get_request");
+            return rv;
+        }
+
+        memset(&conn_param, 0, sizeof conn_param);
+        if (n == 0) {
+            if ((rv = rdma_create_qp(peer->id, NULL, &attr)) != 0) {
+                log_perror("rdma_create_qp");
+                return rv;
+            }
+
+            if ((rv = dccs_ud_attach_qp(ctx, peer->id)) != 0)
+                return rv;
+        } else {
+            conn_param.qp_num = ctx->qp->qp_num;
+        }
+
+        if ((rv = rdma_accept(peer->id, &conn_param)) != 0) {
+            log_perror("rdma_accept");
+            return rv;
+        }
+    }
+
+    return 0;
+}
+
+void dccs_ud_disconnect(struct dccs_ud_context *ctx) {
+    if (ctx->ring_mr != NULL)
+        dccs_dereg_mr(ctx->ring_mr);
+    free(ctx->ring);
+
+    // Destroy the QP owner last, as the other ids share its PD.
+    for (size_t n = ctx->peer_count; n-- > 0; ) {
+        struct dccs_ud_peer *peer = ctx->peers + n;
+        if (peer->ah != NULL)
+            ibv_destroy_ah(peer->ah);
+        if (peer->id != NULL)
+            rdma_destroy_ep(peer->id);
+    }
+
+    if (ctx->listen_id != NULL)
+        rdma_destroy_ep(ctx->listen_id);
+    free(ctx->peers);
+}
+
+/* Data path */
+
+int dccs_ud_post_recv(struct dccs_ud_context *ctx, uint64_t slot) {
+    struct ibv_recv_wr wr, *bad;
+    struct ibv_sge sge;
+    int rv;
+
+    sge.addr = (uint64_t)(uintptr_t)(ctx->ring + slot * ctx->slot_length);
+    sge.length = (uint32_t)ctx->slot_length;
+    sge.lkey = ctx->ring_mr->lkey;
+
+    memset(&wr, 0, sizeof wr);
+    wr.wr_id = slot;
+    wr.sg_list = &sge;
+    wr.num_sge = 1;
+
+    if ((rv = ibv_post_recv(ctx->qp, &wr, &bad)) != 0) {
+        log_error("ibv_post_recv() failed, error = %d.\n", rv);
+    }
+
+    return rv;
+}
+
+/**
+ * Allocate the receive ring for datagrams of up to length bytes (and
+ * greetings) and post every slot. A UD receive always starts with a 40-byte
+ * GRH area. The greeting payloads sit past the ring, in the same region.
+ */
+int dccs_ud_setup_ring(struct dccs_ud_context *ctx, size_t length) {
+    ctx->slot_length = UD_GRH_LENGTH + (length > sizeof(uint32_t) ? length : sizeof(uint32_t));
+    size_t ring_length = UD_RECV_RING_DEPTH * ctx->slot_length;
+    ring_length = (ring_length + sizeof(uint32_t) - 1) / sizeof(uint32_t) * sizeof(uint32_t);
+    size_t region_length = ring_length + ctx->peer_count * sizeof(uint32_t);
+    if ((ctx->ring = malloc_random(region_length)) == NULL)
+        return -1;
+    if ((ctx->ring_mr = dccs_reg_msgs(ctx->qp_id, ctx->ring, region_length)) == NULL)
+        return -1;
+    ctx->hello = (uint32_t *)(ctx->ring + ring_length);
+
+    for (uint64_t slot = 0; slot < UD_RECV_RING_DEPTH; slot++) {
+        if (dccs_ud_post_recv(ctx, slot) != 0)
+            return -1;
+    }
+
+    return 0;
+}
+
+/**
+ * Payload of a received datagram, past its GRH area.
+ */
+static inline void *dccs_ud_slot_payload(struct dccs_ud_context *ctx, uint64_t slot) {
+    return ctx->ring + slot * ctx->slot_length + UD_GRH_LENGTH;
+}
+
+int dccs_ud_send(struct dccs_ud_context *ctx, struct dccs_ud_peer *peer, void *addr, size_t length,
+                 uint32_t lkey, uint32_t imm_data, int flags) {
+    struct ibv_send_wr wr, *bad;
+    struct ibv_sge sge;
+    int rv;
+
+    sge.addr = (uint64_t)(uintptr_t)addr;
+    sge.length = (uint32_t)length;
+    sge.lkey = lkey;
+
+    memset(&wr, 0, sizeof wr);
+    wr.sg_list = &sge;
+    wr.num_sge = length > 0 ? 1 : 0;
+    wr.opcode = IBV_WR_SEND_WITH_IMM;
+    wr.send_flags = (unsigned int)flags;
+    wr.imm_data = imm_data;
+    wr.wr.ud.ah = peer->ah;
+    wr.wr.ud.remote_qpn = peer->qpn;
+    wr.wr.ud.remote_qkey = peer->qkey;
+
+    if ((rv = ibv_post_send(ctx->qp, &wr, &bad)) != 0) {
+        log_error("ibv_post_send() failed, error = %d.\n", rv);
+    }
+
+    return rv;
+}
+
+/**
+ * Poll a CQ until a completion arrives or the timeout (in cycles) expires.
+ * Returns 1 on completion, 0 on timeout and -1 on error.
+ */
+int dccs_ud_poll(struct ibv_cq *cq, struct ibv_wc *wc, uint64_t timeout) {
+    uint64_t deadline = get_cycles() + timeout;
+    int rv;
+
+    do {
+        rv = ibv_poll_cq(cq, 1, wc);
+    } while (rv == 0 && get_cycles() < deadline);
+
+    if (rv < 0) {
+        log_error("ibv_poll_cq() failed, error = %d.\n", rv);
+        return -1;
+    }
+
+    if (rv > 0 && wc->status != IBV_WC_SUCCESS) {
+        log_error("Failed status %s (%d) for wr_id %d\n",
+            ibv_wc_status_str(wc->status), wc->status, (int)wc->wr_id);
+        return -1;
+    }
+
+    return rv;
+}
+
+static inline uint64_t dccs_ud_timeout_cycles() {
+    return UD_RECV_TIMEOUT_USEC * clock_rate / MILLION;
+}
+
+/**
+ * Datagrams per round that a client sends to the nth of its servers: a round
+ * of count goes to the servers in turn.
+ */
+static inline size_t dccs_ud_share(size_t count, size_t peer_count, size_t n) {
+    return count / peer_count + (n < count % peer_count ? 1 : 0);
+}
+
+/**
+ * Source address of a received datagram, in the form dccs_ud_peer keeps.
+ * RoCEv2 over IPv4 leaves an IPv4 header in the last 20 bytes of the GRH
+ * area instead of a GRH; its source address maps to an IPv4-mapped GID.
+ */
+static void dccs_ud_source(struct dccs_ud_context *ctx, struct ibv_wc *wc, uint16_t *lid, union ibv_gid *gid) {
+    uint8_t *grh = ctx->ring + wc->wr_id * ctx->slot_length;
+    uint8_t *ip = grh + UD_GRH_LENGTH - UD_IPV4_HEADER_LENGTH;
+    uint32_t sum = 0;
+
+    memset(gid, 0, sizeof *gid);
+    *lid = 0;
+    if (!(wc->wc_flags & IBV_WC_GRH)) {
+        *lid = wc->slid;
+        return;
+    }
+
+    for (int k = 0; k < UD_IPV4_HEADER_LENGTH; k += 2)
+        sum += (uint32_t)(ip[k] << 8 | ip[k + 1]);
+    sum = (sum & 0xffff) + (sum >> 16);
+    sum = (sum & 0xffff) + (sum >> 16);
+    if (ip[0] == 0x45 && sum == 0xffff) {
+        gid->raw[10] = gid->raw[11] = 0xff;
+        memcpy(gid->raw + 12, ip + 12, 4);
+    } else {
+        memcpy(gid->raw, ((struct ibv_grh *)grh)->sgid.raw, sizeof gid->raw);
+    }
+}
+
+/**
+ * The peer a datagram came from, by source QPN and address, or NULL.
+ */
+struct dccs_ud_peer *dccs_ud_find_peer(struct dccs_ud_context *ctx, struct ibv_wc *wc) {
+    union ibv_gid gid;
+    uint16_t lid;
+
+    dccs_ud_source(ctx, wc, &lid, &gid);
+    for (size_t n = 0; n < ctx->peer_count; n++) {
+        struct dccs_ud_peer *peer = ctx->peers + n;
+        if (peer->qpn == wc->src_qp && peer->lid == lid && memcmp(peer->gid.raw, gid.raw, sizeof gid.raw) == 0)
+            return peer;
+    }
+
+    return NULL;
+}
+
+/**
+ * Client side of the handshake: greet every server until it answers, which
+ * lets it create an AH towards us from the GRH of our datagram. The greeting
+ * tells the server its share of a round of count datagrams.
+ */
+int dccs_ud_handshake_client(struct dccs_ud_context *ctx, size_t count) {
+    struct ibv_wc wc;
+    size_t answered = 0;
+    bool *done = calloc(ctx->peer_count, sizeof(bool));
+    int rv = 0;
+
+    for (size_t n = 0; n < ctx->peer_count; n++)
+        ctx->hello[n] = htonl((uint32_t)dccs_ud_share(count, ctx->peer_count, n));
+
+    for (int attempt = 0; attempt < UD_HANDSHAKE_RETRIES && answered < ctx->peer_count; attempt++) {
+        for (size_t n = 0; n < ctx->peer_count; n++) {
+            if (done[n])
+                continue;
+            if (dccs_ud_send(ctx, ctx->peers + n, ctx->hello + n, sizeof(uint32_t), ctx->ring_mr->lkey,
+                             UD_IMM_HELLO, IBV_SEND_SIGNALED) != 0 ||
+                dccs_ud_poll(ctx->send_cq, &wc, dccs_ud_timeout_cycles()) != 1) {
+                rv = -1;
+                goto out;
+            }
+        }
+
+        while (answered < ctx->peer_count && (rv = dccs_ud_poll(ctx->recv_cq, &wc, dccs_ud_timeout_cycles())) == 1) {
+            struct dccs_ud_peer *peer = dccs_ud_find_peer(ctx, &wc);
+            if (peer != NULL && !done[peer - ctx->peers]) {
+                done[peer - ctx->peers] = true;
+                answered++;
+            }
+
+            if ((rv = dccs_ud_post_recv(ctx, wc.wr_id)) != 0)
+                goto out;
+        }
+
+        if (rv < 0)
+            goto out;
+    }
+
+    rv = answered == ctx->peer_count ? 0 : -1;
+    if (rv != 0)
+        log_error("Only %zu of %zu UD peers answered the handshake.\n", answered, ctx->peer_count);
+out:
+    free(done);
+    return rv;
+}
+
+/**
+ * Record the share announced by a client's greeting.
+ */
+static inline void dccs_ud_greeted(struct dccs_ud_context *ctx, struct dccs_ud_peer *peer, struct ibv_wc *wc) {
+    if (wc->byte_len >= UD_GRH_LENGTH + sizeof(uint32_t))
+        peer->expected = ntohl(*(uint32_t *)dccs_ud_slot_payload(ctx, wc->wr_id));
+}
+
+/**
+ * Server side of the handshake: create an AH for every client from the GRH
+ * of its greeting, and answer every greeting (including retransmissions).
+ * Every client's arrivals then get a run of slots as long as its share.
+ */
+int dccs_ud_handshake_server(struct dccs_ud_context *ctx) {
+    struct ibv_wc wc;
+    size_t known = 0;
+    int rv;
+
+    while (known < ctx->peer_count) {
+        if ((rv = dccs_ud_poll(ctx->recv_cq, &wc, UINT64_MAX / 2)) != 1)
+            return -1;
+
+        struct dccs_ud_peer *peer = dccs_ud_find_peer(ctx, &wc);
+        if (peer == NULL) {
+            peer = ctx->peers + known++;
+            peer->qpn = wc.src_qp;
+            peer->qkey = RDMA_UDP_QKEY;
+            dccs_ud_source(ctx, &wc, &peer->lid, &peer->gid);
+            struct ibv_grh *grh = (struct ibv_grh *)(ctx->ring + wc.wr_id * ctx->slot_length);
+            if ((peer->ah = ibv_create_ah_from_wc(ctx->pd, &wc, grh, ctx->qp_id->port_num)) == NULL) {
+                log_perror("ibv_create_ah_from_wc");
+                return -1;
+            }
+
+            log_debug("UD peer %zu: qpn = %u.\n", known, peer->qpn);
+        }
+        dccs_ud_greeted(ctx, peer, &wc);
+
+        if (dccs_ud_post_recv(ctx, wc.wr_id) != 0 ||
+            dccs_ud_send(ctx, peer, NULL, 0, 0, UD_IMM_HELLO, IBV_SEND_SIGNALED) != 0 ||
+            dccs_ud_poll(ctx->send_cq, &wc, dccs_ud_timeout_cycles()) != 1)
+            return -1;
+    }
+
+    for (size_t n = 1; n < ctx->peer_count; n++)
+        ctx->peers[n].base = ctx->peers[n - 1].base + ctx->peers[n - 1].expected;
+
+    return 0;
+}
+
+/**
+ * Arrival slots a server needs for one round: the shares of all its clients.
+ */
+static inline size_t dccs_ud_expected(struct dccs_ud_context *ctx) {
+    struct dccs_ud_peer *last = ctx->peers + ctx->peer_count - 1;
+    return last->base + last->expected;
+}
+
+/**
+ * Send one round of datagrams, spreading them over the peers in turn.
+ * Datagram n is the (n / peers)th to its server, which numbers it so.
+ * In latency mode every datagram is echoed back and the round trip is
+ * recorded; a datagram whose echo does not arrive in time is left with
+ * end = 0 and counted as lost.
+ */
+int dccs_ud_send_requests(struct dccs_ud_context *ctx, struct dccs_request *requests, struct dccs_parameters *params) {
+    int rv;
+    int failed_count = 0;
+    size_t count = params->count;
+    struct ibv_wc wc;
+
+    for (size_t n = 0; n < count; n++) {
+        struct dccs_request *request = requests + n;
+        struct dccs_ud_peer *peer = ctx->peers + n % ctx->peer_count;
+        uint32_t seq = (uint32_t)(n / ctx->peer_count);
+        bool signal = params->mode == MODE_LATENCY || n == count - 1 || (n + 1) % UD_SIGNAL_INTERVAL == 0;
+
+        request->end = 0;
+        rv = dccs_ud_send(ctx, peer, request->buf, request->length, request->mr->lkey,
+                          htonl(seq), signal ? IBV_SEND_SIGNALED : 0);
+        request->start = get_cycles();
+        if (rv != 0) {
+            failed_count++;
+            continue;
+        }
+
+        if (signal) {
+            if (dccs_ud_poll(ctx->send_cq, &wc, dccs_ud_timeout_cycles()) != 1) {
+                failed_count++;
+                continue;
+            }
+            request->end = get_cycles();
+        }
+
+        if (params->mode != MODE_LATENCY)
+            continue;
+
+        request->end = 0;
+        while ((rv = dccs_ud_poll(ctx->recv_cq, &wc, dccs_ud_timeout_cycles())) == 1) {
+            uint64_t arrival = get_cycles();
+            if (dccs_ud_post_recv(ctx, wc.wr_id) != 0)
+                failed_count++;
+            // Skip late echoes and handshake answers
+            if (ntohl(wc.imm_data) == seq && dccs_ud_find_peer(ctx, &wc) == peer) {
+                request->end = arrival;
+                break;
+            }
+        }
+
+        if (rv < 0)
+            failed_count++;
+    }
+
+    return -failed_count;
+}
+
+/**
+ * Receive one round of datagrams from every peer, its share each, echoing
+ * them back in latency mode. Arrival times are kept in
+ * requests[peer->base + seq].end, and the round ends early once no datagram
+ * arrived for UD_RECV_TIMEOUT_USEC.
+ */
+int dccs_ud_serve_requests(struct dccs_ud_context *ctx, struct dccs_request *requests, struct dccs_parameters *params) {
+    size_t expected = dccs_ud_expected(ctx);
+    size_t received = 0;
+    struct ibv_wc wc, send_wc;
+    int rv;
+
+    for (size_t n = 0; n < expected; n++)
+        requests[n].end = 0;
+
+    while (received < expected) {
+        if ((rv = dccs_ud_poll(ctx->recv_cq, &wc, dccs_ud_timeout_cycles())) < 0)
+            return -1;
+        if (rv == 0) {
+            log_warning("Timed out with %zu of %zu datagrams received.\n", received, expected);
+            break;
+        }
+
+        uint64_t arrival = get_cycles();
+        uint32_t seq = ntohl(wc.imm_data);
+        struct dccs_ud_peer *peer = dccs_ud_find_peer(ctx, &wc);
+        if (peer == NULL) {
+            log_warning("Datagram from unknown QP %u.\n", wc.src_qp);
+        } else if (seq == UD_IMM_HELLO || params->mode == MODE_LATENCY) {
+            // Echo datagrams, and answer greetings whose answer was lost
+            if (dccs_ud_send(ctx, peer, dccs_ud_slot_payload(ctx, wc.wr_id), wc.byte_len - UD_GRH_LENGTH,
+                             ctx->ring_mr->lkey, wc.imm_data, IBV_SEND_SIGNALED) != 0 ||
+                dccs_ud_poll(ctx->send_cq, &send_wc, dccs_ud_timeout_cycles()) != 1)
+                return -1;
+        }
+
+        if (peer != NULL && seq < peer->expected) {
+            requests[peer->base + seq].end = arrival;
+            received++;
+        }
+
+        if (dccs_ud_post_recv(ctx, wc.wr_id) != 0)
+            return -1;
+    }
+
+    return 0;
+}
+
+/**
+ * Print round-trip latencies of the datagrams whose echo came back.
+ */
+void print_ud_latency_report(struct dccs_parameters *params, struct dccs_request *requests) {
+    uint64_t *start = malloc(params->count * sizeof(uint64_t));
+    uint64_t *end = malloc(params->count * sizeof(uint64_t));
+    size_t received = 0;
+
+    for (size_t n = 0; n < params->count; n++) {
+        if (requests[n].end == 0)
+            continue;
+        start[received] = requests[n].start;
+        end[received] = requests[n].end;
+        received++;
+    }
+
+    log_info("UD round trips: %zu received, %zu lost.\n", received, params->count - received);
+    if (received > 0)
+        print_latency_report_raw(start, end, received, start[0], params->verbose, params->count, params->length);
+    free(start);
+    free(end);
+}
+
+#endif // DCCS_UD_H
@@ -8,6 +8,7 @@
 #include <getopt.h>
 #include <inttypes.h>
 #include <mpi.h>
+#include <openssl/evp.h>
 #include <openssl/sha.h>
 #include <sched.h>
 #include <stdarg.h>
@@ -204,6 +205,14 @@ double get_time_in_microseconds(uint64_t cycles) {
 #endif
 }
 
+static inline uint64_t usec_to_cycles(double usec) {
+    return (uint64_t)(usec * (double)clock_rate / (double)MILLION);
+}
+
+static inline double cycles_to_nsec(uint64_t cycles) {
+    return (double)cycles * BILLION / (double)clock_rate;
+}
+
 int compare_double(const void *a, const void *b)
 {
     double da = *(double *)a;
@@ -235,9 +244,46 @@ void set_cpu_affinity() {
 
 void print_usage(char *argv0) {
     log_warning("Usage: %s [-b <block size>] [-c count] [--mr <mr count>] "
-                "[-r <repeat>] [-v read|write] [-p <port>] "
-                "[-m latency|throughput] [-w <warmup count>] [-V {verbose}] "
-                "[--tos <tos>] [server]\n", argv0);
+                "[-r <repeat>] [-v read|write|write_imm|fadd|cas] [-p <port>] "
+                "[-m latency|throughput|open] [-w <warmup count>] [-V {verbose}] "
+                "[--tos <tos>] [--atomic_words <word count>] "
+                "[--sge <segment count>] [--sge_copy] [--transport rc|ud] "
+                "[--peers <client count>] [--hosts <host count>] [--threads <thread count>] "
+                "[--device <ib device>] [--gid_index <index>] "
+                "[--schedule] [--slot_period <µsec>] [--slot_uptime <µsec>] [--slot_guard <µsec>] "
+                "[--slot_phase <µsec>] [--slots <slots per cycle>] [--slot <slot>] "
+                "[--rotor] [--matching <schedule file>] [--pace_spin <µsec>] "
+                "[--arrival constant|poisson|onoff] [--load <Gbps>[,<Gbps>...]] "
+                "[--on_time <µsec>] [--off_time <µsec>] "
+                "[--pattern permutation|incast|shuffle] [--traffic_matrix <matrix file>] [--fanin <senders>] "
+                "[--sizes <size CDF file>] [--seed <seed>] "
+                "[--classes <tos>:<length>:<count>:latency|throughput[,...]] "
+                "[--rate <Gbps>] [--burst <bytes>] [--hw_rate] "
+                "[--window <requests>] [--persistent] "
+                "[--collective alltoall|allreduce|bcast[,...]] "
+                "[--rma fence|pscw|passive] [--thread_multiple] "
+                "[--digest sha1|crc32c] "
+                "[--backend verbs|mpi|daemon] [--shm <name>] "
+                "[server[,server...]]\n", argv0);
+}
+
+static inline bool is_atomic_verb(Verb verb) {
+    return verb == FetchAdd || verb == CompSwap;
+}
+
+static inline const char *pattern_name(Pattern pattern) {
+    switch (pattern) {
+        case PATTERN_PERMUTATION:
+            return "permutation";
+        case PATTERN_INCAST:
+            return "incast";
+        case PATTERN_SHUFFLE:
+            return "shuffle";
+        case PATTERN_FILE:
+            return "file";
+        default:
+            return "none";
+    }
 }
 
 void print_parameters(struct dccs_parameters *params) {
@@ -249,9 +295,18 @@ void print_parameters(struct dccs_parameters *params) {
         case Write:
             verb = "Write";
             break;
+        case WriteImm:
+            verb = "WriteImm";
+            break;
         case Send:
             verb = "Send";
             break;
+        case FetchAdd:
+            verb = "FetchAdd";
+            break;
+        case CompSwap:
+            verb = "CompSwap";
+            break;
         default:
             verb = "Unknown";
             break;
@@ -264,6 +319,9 @@ void print_parameters(struct dccs_parameters *params) {
         case MODE_THROUGHPUT:
             mode = "Throughput";
             break;
+        case MODE_OPEN_LOOP:
+            mode = "Open-loop";
+            break;
         default:
             mode = "Unknown";
             break;
@@ -288,6 +346,49 @@ void print_parameters(struct dccs_parameters *params) {
     log_info("Config: mode = %s, repeat = %zu, warmup count = %zu, direction = %s, verbose = %d.\n", mode, params->repeat, params->warmup_count, direction, params->verbose);
     if (params->tos != 0)
         log_info("Config: tos = %zu.\n", params->tos);
+    if (is_atomic_verb(params->verb))
+        log_info("Config: atomic words = %zu.\n", params->atomic_words == 0 ? params->count : params->atomic_words);
+    if (params->sge > 1)
+        log_info("Config: sge = %zu, gather = %s.\n", params->sge, params->sge_copy ? "CPU copy" : "NIC");
+    if (params->transport == TRANSPORT_UD)
+        log_info("Config: transport = UD, peers = %zu.\n", params->peers);
+    if (params->scheduled)
+        log_info("Config: slot period = %.3f µsec, up = %.3f µsec, guard = %.3f µsec, phase = %.3f µsec, slot = %u of %zu.\n",
+                 params->slot_period, params->slot_uptime, params->slot_guard, params->slot_phase, params->slot, params->slots);
+    if (params->rotor)
+        log_info("Config: rotor schedule = %s, slot period = %.3f µsec, up = %.3f µsec, guard = %.3f µsec.\n",
+                 params->matching == NULL ? "round-robin" : params->matching,
+                 params->slot_period, params->slot_uptime, params->slot_guard);
+    if (params->mode == MODE_OPEN_LOOP)
+        log_info("Config: offered load = %s Gbps, arrival = %s, on = %.3f µsec, off = %.3f µsec.\n", params->load,
+                 params->arrival == ARRIVAL_CONSTANT ? "constant" : params->arrival == ARRIVAL_POISSON ? "poisson" : "on/off",
+                 params->on_time, params->off_time);
+    if (params->pattern != PATTERN_NONE)
+        log_info("Config: traffic pattern = %s, fan-in = %zu, sizes = %s, seed = %lu.\n",
+                 params->pattern == PATTERN_FILE ? params->traffic_file : pattern_name(params->pattern),
+                 params->fanin, params->sizes == NULL ? "fixed" : params->sizes, params->seed);
+    if (params->classes != NULL)
+        log_info("Config: traffic classes = %s.\n", params->classes);
+    if (params->rate > 0)
+        log_info("Config: rate limit = %.3f Gbps, burst = %zu B, method = %s.\n", params->rate,
+                 params->burst == 0 ? params->length : params->burst, params->rate_hw ? "hardware" : "software");
+    if (params->window != DEFAULT_MPI_WINDOW || params->persistent)
+        log_info("Config: MPI window = %zu requests, persistent requests = %s.\n", params->window,
+                 params->persistent ? "yes" : "no");
+    if (params->collectives != NULL)
+        log_info("Config: collectives = %s.\n", params->collectives);
+    if (params->rma != RMA_NONE)
+        log_info("Config: RMA synchronization = %s.\n",
+                 params->rma == RMA_FENCE ? "fence" : params->rma == RMA_PSCW ? "pscw" : "passive");
+    if (params->thread_multiple)
+        log_info("Config: MPI_THREAD_MULTIPLE, up to %zu threads per rank.\n", params->threads);
+    if (params->digest != DEFAULT_DIGEST)
+        log_info("Config: digest = %s.\n", params->digest == DIGEST_SHA1 ? "sha1" : "crc32c");
+    if (params->backend != DEFAULT_BACKEND)
+        log_info("Config: transport backend = %s.\n",
+                 params->backend == BACKEND_MPI ? "mpi" : params->backend == BACKEND_DAEMON ? "daemon" : "verbs");
+    if (strcmp(params->shm_name, DEFAULT_SHM_NAME) != 0)
+        log_info("Config: shared memory segment = %s.\n", params->shm_name);
 }
 
 /**
@@ -306,6 +407,7 @@ void print_parameters(struct dccs_parameters *params) {
  */
 void parse_args(int argc, char *argv[], struct dccs_parameters *params) {
     int c;
+    bool length_set = false;
 
     memset(params, 0,  sizeof(struct dccs_parameters));
     params->verb = Send;
@@ -320,12 +422,92 @@ void parse_args(int argc, char *argv[], struct dccs_parameters *params) {
     params->direction = DEFAULT_DIRECTION;
     params->index = DEFAULT_INDEX;
     params->tos = DEFAULT_TOS;
+    params->atomic_words = DEFAULT_ATOMIC_WORDS;
+    params->sge = DEFAULT_SGE_COUNT;
+    params->sge_copy = false;
+    params->transport = DEFAULT_TRANSPORT;
+    params->peers = DEFAULT_PEER_COUNT;
+    params->hosts = DEFAULT_HOST_COUNT;
+    params->threads = DEFAULT_THREAD_COUNT;
+    params->device = NULL;
+    params->gid_index = DEFAULT_GID_INDEX;
+    params->scheduled = false;
+    params->slot_period = DEFAULT_SLOT_PERIOD;
+    params->slot_uptime = DEFAULT_SLOT_UPTIME;
+    params->slot_guard = DEFAULT_SLOT_GUARD;
+    params->slot_phase = DEFAULT_SLOT_PHASE;
+    params->slots = DEFAULT_SLOT_COUNT;
+    params->slot = DEFAULT_SLOT;
+    params->rotor = false;
+    params->matching = NULL;
+    params->pace_spin = DEFAULT_PACE_SPIN;
+    params->arrival = DEFAULT_ARRIVAL;
+    params->load = NULL;
+    params->on_time = DEFAULT_ON_TIME;
+    params->off_time = DEFAULT_OFF_TIME;
+    params->pattern = PATTERN_NONE;
+    params->traffic_file = NULL;
+    params->fanin = DEFAULT_FANIN;
+    params->sizes = NULL;
+    params->seed = DEFAULT_SEED;
+    params->classes = NULL;
+    params->rate = 0;
+    params->burst = DEFAULT_BURST;
+    params->rate_hw = false;
+    params->window = DEFAULT_MPI_WINDOW;
+    params->persistent = false;
+    params->collectives = NULL;
+    params->rma = RMA_NONE;
+    params->thread_multiple = false;
+    params->digest = DEFAULT_DIGEST;
+    params->backend = DEFAULT_BACKEND;
+    params->shm_name = DEFAULT_SHM_NAME;
     params->verbose = false;
 
     while (true) {
 #define OPT_MR_COUNT 1001
 #define OPT_DIRECTION 1002
 #define OPT_TOS 1003
+#define OPT_ATOMIC_WORDS 1004
+#define OPT_SGE 1005
+#define OPT_SGE_COPY 1006
+#define OPT_TRANSPORT 1007
+#define OPT_PEERS 1008
+#define OPT_HOSTS 1009
+#define OPT_THREADS 1010
+#define OPT_DEVICE 1011
+#define OPT_GID_INDEX 1012
+#define OPT_SCHEDULE 1013
+#define OPT_SLOT_PERIOD 1014
+#define OPT_SLOT_UPTIME 1015
+#define OPT_SLOT_GUARD 1016
+#define OPT_SLOT_PHASE 1017
+#define OPT_SLOTS 1018
+#define OPT_SLOT 1019
+#define OPT_ROTOR 1020
+#define OPT_MATCHING 1021
+#define OPT_PACE_SPIN 1022
+#define OPT_ARRIVAL 1023
+#define OPT_LOAD 1024
+#define OPT_ON_TIME 1025
+#define OPT_OFF_TIME 1026
+#define OPT_PATTERN 1027
+#define OPT_TRAFFIC_MATRIX 1028
+#define OPT_FANIN 1029
+#define OPT_SIZES 1030
+#define OPT_SEED 1031
+#define OPT_CLASSES 1032
+#define OPT_RATE 1033
+#define OPT_BURST 1034
+#define OPT_HW_RATE 1035
+#define OPT_WINDOW 1036
+#define OPT_PERSISTENT 1037
+#define OPT_COLLECTIVE 1038
+#define OPT_RMA 1039
+#define OPT_THREAD_MULTIPLE 1040
+#define OPT_DIGEST 1041
+#define OPT_BACKEND 1042
+#define OPT_SHM_NAME 1043
         static struct option long_options[] = {
             { "block_size", required_argument, 0, 'b' },
             { "mr_count", required_argument, 0, OPT_MR_COUNT },
@@ -338,6 +520,46 @@ void parse_args(int argc, char *argv[], struct dccs_parameters *params) {
             { "direction", required_argument, 0, OPT_DIRECTION },
             { "index", required_argument, 0, 'i' },
             { "tos", required_argument, 0, OPT_TOS },
+            { "atomic_words", required_argument, 0, OPT_ATOMIC_WORDS },
+            { "sge", required_argument, 0, OPT_SGE },
+            { "sge_copy", no_argument, 0, OPT_SGE_COPY },
+            { "transport", required_argument, 0, OPT_TRANSPORT },
+            { "peers", required_argument, 0, OPT_PEERS },
+            { "hosts", required_argument, 0, OPT_HOSTS },
+            { "threads", required_argument, 0, OPT_THREADS },
+            { "device", required_argument, 0, OPT_DEVICE },
+            { "gid_index", required_argument, 0, OPT_GID_INDEX },
+            { "schedule", no_argument, 0, OPT_SCHEDULE },
+            { "slot_period", required_argument, 0, OPT_SLOT_PERIOD },
+            { "slot_uptime", required_argument, 0, OPT_SLOT_UPTIME },
+            { "slot_guard", required_argument, 0, OPT_SLOT_GUARD },
+            { "slot_phase", required_argument, 0, OPT_SLOT_PHASE },
+            { "slots", required_argument, 0, OPT_SLOTS },
+            { "slot", required_argument, 0, OPT_SLOT },
+            { "rotor", no_argument, 0, OPT_ROTOR },
+            { "matching", required_argument, 0, OPT_MATCHING },
+            { "pace_spin", required_argument, 0, OPT_PACE_SPIN },
+            { "arrival", required_argument, 0, OPT_ARRIVAL },
+            { "load", required_argument, 0, OPT_LOAD },
+            { "on_time", required_argument, 0, OPT_ON_TIME },
+            { "off_time", required_argument, 0, OPT_OFF_TIME },
+            { "pattern", required_argument, 0, OPT_PATTERN },
+            { "traffic_matrix", required_argument, 0, OPT_TRAFFIC_MATRIX },
+            { "fanin", required_argument, 0, OPT_FANIN },
+            { "sizes", required_argument, 0, OPT_SIZES },
+            { "seed", required_argument, 0, OPT_SEED },
+            { "classes", required_argument, 0, OPT_CLASSES },
+            { "rate", required_argument, 0, OPT_RATE },
+            { "burst", required_argument, 0, OPT_BURST },
+            { "hw_rate", no_argument, 0, OPT_HW_RATE },
+            { "window", required_argument, 0, OPT_WINDOW },
+            { "persistent", no_argument, 0, OPT_PERSISTENT },
+            { "collective", required_argument, 0, OPT_COLLECTIVE },
+            { "rma", required_argument, 0, OPT_RMA },
+            { "thread_multiple", no_argument, 0, OPT_THREAD_MULTIPLE },
+            { "digest", required_argument, 0, OPT_DIGEST },
+            { "backend", required_argument, 0, OPT_BACKEND },
+            { "shm", required_argument, 0, OPT_SHM_NAME },
             { "verbose", no_argument, 0, 'V' },
             { "help", no_argument, 0, 'h' }
         };
@@ -352,6 +574,7 @@ void parse_args(int argc, char *argv[], struct dccs_parameters *params) {
                     goto invalid;
                 }
 
+                length_set = true;
                 break;
             case 'c':
                 if (sscanf(optarg, "%zu", &(params->count)) != 1) {
@@ -364,8 +587,14 @@ void parse_args(int argc, char *argv[], struct dccs_parameters *params) {
                     params->verb = Read;
                 } else if (strcmp(optarg, "write") == 0) {
                     params->verb = Write;
+                } else if (strcmp(optarg, "write_imm") == 0) {
+                    params->verb = WriteImm;
+                } else if (strcmp(optarg, "fadd") == 0) {
+                    params->verb = FetchAdd;
+                } else if (strcmp(optarg, "cas") == 0) {
+                    params->verb = CompSwap;
                 } else {
-                    dccs_validate(false, argv, "verb must be 'read' or 'write'.\n");
+                    dccs_validate(false, argv, "verb must be 'read', 'write', 'write_imm', 'fadd' or 'cas'.\n");
                 }
 
                 break;
@@ -377,8 +606,10 @@ void parse_args(int argc, char *argv[], struct dccs_parameters *params) {
                     params->mode = MODE_LATENCY;
                 } else if (strcmp(optarg, "throughput") == 0) {
                     params->mode = MODE_THROUGHPUT;
+                } else if (strcmp(optarg, "open") == 0) {
+                    params->mode = MODE_OPEN_LOOP;
                 } else {
-                    dccs_validate(false, argv, "mode must be 'latency' or 'throughput'.\n");
+                    dccs_validate(false, argv, "mode must be 'latency', 'throughput' or 'open'.\n");
                 }
 
                 break;
@@ -423,6 +654,238 @@ void parse_args(int argc, char *argv[], struct dccs_parameters *params) {
                     goto invalid;
                 }
 
+                break;
+            case OPT_ATOMIC_WORDS:
+                if (sscanf(optarg, "%zu", &(params->atomic_words)) != 1) {
+                    goto invalid;
+                }
+
+                break;
+            case OPT_SGE:
+                if (sscanf(optarg, "%zu", &(params->sge)) != 1) {
+                    goto invalid;
+                }
+
+                break;
+            case OPT_SGE_COPY:
+                params->sge_copy = true;
+                break;
+            case OPT_TRANSPORT:
+                if (strcmp(optarg, "rc") == 0) {
+                    params->transport = TRANSPORT_RC;
+                } else if (strcmp(optarg, "ud") == 0) {
+                    params->transport = TRANSPORT_UD;
+                } else {
+                    dccs_validate(false, argv, "transport must be 'rc' or 'ud'.\n");
+                }
+
+                break;
+            case OPT_PEERS:
+                if (sscanf(optarg, "%zu", &(params->peers)) != 1) {
+                    goto invalid;
+                }
+
+                break;
+            case OPT_HOSTS:
+                if (sscanf(optarg, "%zu", &(params->hosts)) != 1) {
+                    goto invalid;
+                }
+
+                break;
+            case OPT_THREADS:
+                if (sscanf(optarg, "%zu", &(params->threads)) != 1) {
+                    goto invalid;
+                }
+
+                break;
+            case OPT_DEVICE:
+                params->device = optarg;
+                break;
+            case OPT_GID_INDEX:
+                if (sscanf(optarg, "%d", &(params->gid_index)) != 1) {
+                    goto invalid;
+                }
+
+                break;
+            case OPT_SCHEDULE:
+                params->scheduled = true;
+                break;
+            case OPT_SLOT_PERIOD:
+                if (sscanf(optarg, "%lf", &(params->slot_period)) != 1) {
+                    goto invalid;
+                }
+
+                break;
+            case OPT_SLOT_UPTIME:
+                if (sscanf(optarg, "%lf", &(params->slot_uptime)) != 1) {
+                    goto invalid;
+                }
+
+                break;
+            case OPT_SLOT_GUARD:
+                if (sscanf(optarg, "%lf", &(params->slot_guard)) != 1) {
+                    goto invalid;
+                }
+
+                break;
+            case OPT_SLOT_PHASE:
+                if (sscanf(optarg, "%lf", &(params->slot_phase)) != 1) {
+                    goto invalid;
+                }
+
+                break;
+            case OPT_SLOTS:
+                if (sscanf(optarg, "%zu", &(params->slots)) != 1) {
+                    goto invalid;
+                }
+
+                break;
+            case OPT_SLOT:
+                if (sscanf(optarg, "%" SCNu8, &(params->slot)) != 1) {
+                    goto invalid;
+                }
+
+                break;
+            case OPT_ROTOR:
+                params->rotor = true;
+                break;
+            case OPT_MATCHING:
+                params->matching = optarg;
+                params->rotor = true;
+                break;
+            case OPT_PACE_SPIN:
+                if (sscanf(optarg, "%lf", &(params->pace_spin)) != 1) {
+                    goto invalid;
+                }
+
+                break;
+            case OPT_ARRIVAL:
+                if (strcmp(optarg, "constant") == 0) {
+                    params->arrival = ARRIVAL_CONSTANT;
+                } else if (strcmp(optarg, "poisson") == 0) {
+                    params->arrival = ARRIVAL_POISSON;
+                } else if (strcmp(optarg, "onoff") == 0) {
+                    params->arrival = ARRIVAL_ON_OFF;
+                } else {
+                    dccs_validate(false, argv, "arrival must be 'constant', 'poisson' or 'onoff'.\n");
+                }
+
+                break;
+            case OPT_LOAD:
+                params->load = optarg;
+                break;
+            case OPT_ON_TIME:
+                if (sscanf(optarg, "%lf", &(params->on_time)) != 1) {
+                    goto invalid;
+                }
+
+                break;
+            case OPT_OFF_TIME:
+                if (sscanf(optarg, "%lf", &(params->off_time)) != 1) {
+                    goto invalid;
+                }
+
+                break;
+            case OPT_PATTERN:
+                if (strcmp(optarg, "permutation") == 0) {
+                    params->pattern = PATTERN_PERMUTATION;
+                } else if (strcmp(optarg, "incast") == 0) {
+                    params->pattern = PATTERN_INCAST;
+                } else if (strcmp(optarg, "shuffle") == 0) {
+                    params->pattern = PATTERN_SHUFFLE;
+                } else {
+                    dccs_validate(false, argv, "pattern must be 'permutation', 'incast' or 'shuffle'.\n");
+                }
+
+                break;
+            case OPT_TRAFFIC_MATRIX:
+                params->traffic_file = optarg;
+                params->pattern = PATTERN_FILE;
+                break;
+            case OPT_FANIN:
+                if (sscanf(optarg, "%zu", &(params->fanin)) != 1) {
+                    goto invalid;
+                }
+
+                break;
+            case OPT_SIZES:
+                params->sizes = optarg;
+                break;
+            case OPT_SEED:
+                if (sscanf(optarg, "%lu", &(params->seed)) != 1) {
+                    goto invalid;
+                }
+
+                break;
+            case OPT_CLASSES:
+                params->classes = optarg;
+                break;
+            case OPT_RATE:
+                if (sscanf(optarg, "%lf", &(params->rate)) != 1) {
+                    goto invalid;
+                }
+
+                break;
+            case OPT_BURST:
+                if (sscanf(optarg, "%zu", &(params->burst)) != 1) {
+                    goto invalid;
+                }
+
+                break;
+            case OPT_HW_RATE:
+                params->rate_hw = true;
+                break;
+            case OPT_WINDOW:
+                if (sscanf(optarg, "%zu", &(params->window)) != 1) {
+                    goto invalid;
+                }
+
+                break;
+            case OPT_PERSISTENT:
+                params->persistent = true;
+                break;
+            case OPT_COLLECTIVE:
+                params->collectives = optarg;
+                break;
+            case OPT_RMA:
+                if (strcmp(optarg, "fence") == 0) {
+                    params->rma = RMA_FENCE;
+                } else if (strcmp(optarg, "pscw") == 0) {
+                    params->rma = RMA_PSCW;
+                } else if (strcmp(optarg, "passive") == 0) {
+                    params->rma = RMA_PASSIVE;
+                } else {
+                    dccs_validate(false, argv, "RMA synchronization must be 'fence', 'pscw' or 'passive'.\n");
+                }
+
+                break;
+            case OPT_THREAD_MULTIPLE:
+                params->thread_multiple = true;
+                break;
+            case OPT_DIGEST:
+                if (strcmp(optarg, "sha1") == 0) {
+                    params->digest = DIGEST_SHA1;
+                } else if (strcmp(optarg, "crc32c") == 0) {
+                    params->digest = DIGEST_CRC32C;
+                } else {
+                    dccs_validate(false, argv, "digest must be 'sha1' or 'crc32c'.\n");
+                }
+
+                break;
+            case OPT_BACKEND:
+                if (strcmp(optarg, "verbs") == 0) {
+                    params->backend = BACKEND_VERBS;
+                } else if (strcmp(optarg, "mpi") == 0) {
+                    params->backend = BACKEND_MPI;
+                } else if (strcmp(optarg, "daemon") == 0) {
+                    params->backend = BACKEND_DAEMON;
+                } else {
+                    dccs_validate(false, argv, "backend must be 'verbs', 'mpi' or 'daemon'.\n");
+                }
+
+                break;
+            case OPT_SHM_NAME:
+                params->shm_name = optarg;
                 break;
             case 'V':
                 params->verbose = true;
@@ -440,6 +903,13 @@ void parse_args(int argc, char *argv[], struct dccs_parameters *params) {
     if (params->mode == MODE_THROUGHPUT)
         params->count += params->warmup_count;
 
+    if (is_atomic_verb(params->verb) && params->length != ATOMIC_OPERAND_LENGTH) {
+        if (length_set)
+            log_warning("Atomic verbs operate on %d-byte words, ignoring block size %zu.\n",
+                        ATOMIC_OPERAND_LENGTH, params->length);
+        params->length = ATOMIC_OPERAND_LENGTH;
+    }
+
     if (optind + 1 == argc) {
         params->server = argv[optind];
     }
@@ -450,6 +920,52 @@ void parse_args(int argc, char *argv[], struct dccs_parameters *params) {
     dccs_validate(params->mr_count > 0, argv, "mr count must be a positive integer.\n");
     dccs_validate(params->count % params->mr_count == 0, argv, "count must be a multiple of MR count.\n");
     dccs_validate(params->repeat > 0, argv, "repeat must be a positive integer.\n");
+    dccs_validate(params->atomic_words <= params->count, argv, "atomic words must not exceed count.\n");
+    dccs_validate(params->sge > 0 && params->sge <= MAX_SGE, argv, "sge must be between 1 and %d.\n", MAX_SGE);
+    dccs_validate(params->sge <= params->length, argv, "sge must not exceed length.\n");
+    dccs_validate(params->sge == 1 || !is_atomic_verb(params->verb), argv, "atomic verbs take a single segment.\n");
+    // A READ lands in the staging buffer after completion, which is not tracked per request.
+    dccs_validate(!params->sge_copy || params->verb != Read, argv, "sge_copy does not support read.\n");
+    dccs_validate(params->peers > 0, argv, "peers must be a positive integer.\n");
+    dccs_validate(params->hosts > 0, argv, "hosts must be a positive integer.\n");
+    dccs_validate(params->transport != TRANSPORT_UD || (params->verb == Send && params->sge == 1), argv,
+                  "UD transport only supports single-segment sends.\n");
+    dccs_validate(params->slot_period > 0 && params->slot_uptime > 0 && params->slot_uptime <= params->slot_period, argv,
+                  "slot up time must be positive and within the slot period.\n");
+    dccs_validate(params->slot_guard >= 0 && 2 * params->slot_guard < params->slot_uptime, argv,
+                  "slot guard bands must leave part of the up time open.\n");
+    dccs_validate(params->slot_phase >= 0, argv, "slot phase must not be negative.\n");
+    dccs_validate(params->pace_spin >= 0, argv, "pace spin must not be negative.\n");
+    dccs_validate(params->slots > 0 && params->slot < params->slots, argv, "slot must be below the number of slots.\n");
+    dccs_validate(!params->scheduled || params->transport == TRANSPORT_RC, argv,
+                  "slot scheduling requires the RC transport.\n");
+    dccs_validate(params->mode != MODE_OPEN_LOOP || params->load != NULL, argv,
+                  "open-loop mode requires an offered load.\n");
+    dccs_validate(params->mode != MODE_OPEN_LOOP || (params->transport == TRANSPORT_RC && !params->scheduled &&
+                  (params->verb == Read || params->verb == Write || is_atomic_verb(params->verb))), argv,
+                  "open-loop mode requires one-sided verbs over RC, without slot scheduling.\n");
+    dccs_validate(params->classes == NULL || (params->transport == TRANSPORT_RC && !params->scheduled &&
+                  params->mode != MODE_OPEN_LOOP && (params->verb == Read || params->verb == Write)), argv,
+                  "traffic classes require RDMA reads or writes over RC, in latency or throughput mode.\n");
+    dccs_validate(params->rate >= 0, argv, "rate must not be negative.\n");
+    dccs_validate(params->rate == 0 || (params->transport == TRANSPORT_RC && !params->scheduled &&
+                  params->mode != MODE_OPEN_LOOP && params->classes == NULL), argv,
+                  "rate limiting applies to plain RC runs, without scheduling, open-loop mode or classes.\n");
+    dccs_validate(params->window > 0, argv, "MPI window must be positive.\n");
+    // N-N ranks post a receive and then a send per peer: a window of one would
+    // hold only the receive, and every rank would wait for a send never posted.
+    dccs_validate(params->window > 1 || params->direction != DIR_BOTH, argv,
+                  "MPI window must be at least 2 for N-N traffic.\n");
+    dccs_validate(params->shm_name[0] == '/' && strchr(params->shm_name + 1, '/') == NULL, argv,
+                  "shared memory segment name must be '/' followed by a name without '/'.\n");
+    dccs_validate(params->collectives == NULL || params->pattern == PATTERN_NONE, argv,
+                  "collectives and traffic patterns are separate benchmarks.\n");
+    dccs_validate(params->rma == RMA_NONE || ((params->verb == Read || params->verb == Write ||
+                  params->verb == FetchAdd) && params->mode != MODE_OPEN_LOOP && params->collectives == NULL &&
+                  params->pattern == PATTERN_NONE), argv,
+                  "RMA mode requires read, write or fadd, in latency or throughput mode.\n");
+    dccs_validate(params->on_time > 0 && params->off_time >= 0, argv,
+                  "on time must be positive and off time must not be negative.\n");
 
     return;
 
@@ -495,6 +1011,11 @@ void *malloc_random(size_t size) {
 
 /* OpenSSL hashing functions */
 
+struct dccs_segment {
+    const void *addr;
+    size_t length;
+};
+
 /**
  * Calculate the SHA1 digest of the given data.
  */
@@ -516,5 +1037,18 @@ void sha1sum_array(const void *array[], size_t count, size_t length, unsigned ch
     SHA1_Final(digest, &ctx);
 }
 
+/**
+ * Calculate the SHA1 digest of the concatenation of the given segments.
+ */
+void sha1sum_segments(const struct dccs_segment *segments, size_t count, unsigned char digest[SHA_DIGEST_LENGTH]) {
+    EVP_MD_CTX *ctx = EVP_MD_CTX_new();
+    EVP_DigestInit_ex(ctx, EVP_sha1(), NULL);
+    for (size_t n = 0; n < count; n++)
+        EVP_DigestUpdate(ctx, segments[n].addr, segments[n].length);
+
+    EVP_DigestFinal_ex(ctx, digest, NULL);
+    EVP_MD_CTX_free(ctx);
+}
+
 #endif // DCCS_UTIL_H
 
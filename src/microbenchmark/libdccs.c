@@ -0,0 +1,191 @@
+// libdccs: the transport interface behind a socket-like API (see libdccs.h).
+// Built with hidden visibility, so only the API leaves the library and the
+// header-defined helpers it compiles in cannot clash with an application's.
+
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "dccs_parameters.h"
+#include "dccs_utils.h"
+#include "dccs_rdma.h"
+#include "dccs_transport.h"
+#include "dccs_transport_daemon.h"
+#include "dccs_transport_mpi.h"
+#include "dccs_transport_verbs.h"
+#include "libdccs.h"
+
+uint64_t clock_rate = 0;    // Clock ticks per second
+
+struct libdccs {
+    struct dccs_parameters params;     // Only what the backends read is set
+    struct dccs_transport t;
+};
+
+struct libdccs *libdccs_open(const struct libdccs_config *config) {
+    struct libdccs *d = calloc(1, sizeof(struct libdccs));
+    const char *backend = config->backend != NULL ? config->backend : "daemon";
+
+    if (strcmp(backend, "daemon") == 0) {
+        d->params.backend = BACKEND_DAEMON;
+        d->t.ops = &daemon_transport_ops;
+    } else if (strcmp(backend, "verbs") == 0) {
+        d->params.backend = BACKEND_VERBS;
+        d->t.ops = &verbs_transport_ops;
+    } else if (strcmp(backend, "mpi") == 0) {
+        d->params.backend = BACKEND_MPI;
+        d->t.ops = &mpi_transport_ops;
+    } else {
+        log_error("Unknown backend %s.\n", backend);
+        free(d);
+        return NULL;
+    }
+
+    d->params.shm_name = (char *)(config->shm_name != NULL ? config->shm_name : DEFAULT_SHM_NAME);
+    d->params.server = (char *)config->server;
+    d->params.port = (char *)(config->port != NULL ? config->port : DEFAULT_PORT);
+    d->params.peers = config->peers > 0 ? config->peers : DEFAULT_PEER_COUNT;
+    d->params.tos = DEFAULT_TOS;
+    d->t.params = &d->params;
+    if (clock_rate == 0)
+        clock_rate = get_clock_rate();
+
+    if (d->t.ops->init(&d->t, config->argc, config->argv) != 0) {
+        if (d->t.state != NULL)
+            d->t.ops->disconnect(&d->t);
+        free(d);
+        return NULL;
+    }
+
+    return d;
+}
+
+int libdccs_is_server(struct libdccs *d) {
+    return d->t.server;
+}
+
+int libdccs_listen(struct libdccs *d) {
+    return d->t.ops->listen(&d->t, d->params.port);
+}
+
+int libdccs_accept(struct libdccs *d) {
+    return d->t.ops->accept(&d->t);
+}
+
+int libdccs_connect(struct libdccs *d) {
+    return d->t.ops->connect(&d->t, d->params.server, d->params.port);
+}
+
+void libdccs_disconnect(struct libdccs *d) {
+    if (d->t.state != NULL)
+        d->t.ops->disconnect(&d->t);
+    free(d);
+}
+
+/**
+ * A buffer of the daemon's where it fits one, so that it travels without a
+ * copy; otherwise heap memory, registered by the backend on first use.
+ */
+void *libdccs_malloc(struct libdccs *d, size_t length) {
+    void *buf = NULL;
+
+    if (d->params.backend == BACKEND_DAEMON && (buf = daemon_transport_alloc(&d->t, length)) != NULL)
+        return buf;
+    if (posix_memalign(&buf, CACHE_LINE_SIZE, length) != 0) {
+        log_perror("posix_memalign");
+        return NULL;
+    }
+
+    return buf;
+}
+
+void libdccs_free(struct libdccs *d, void *buf) {
+    if (d->params.backend == BACKEND_DAEMON && daemon_transport_free(&d->t, buf))
+        return;
+
+    if (d->t.ops->deregister_buffer != NULL)
+        d->t.ops->deregister_buffer(&d->t, buf);
+    free(buf);
+}
+
+int libdccs_isend(struct libdccs *d, int peer, void *buf, size_t length, struct libdccs_handle *handle) {
+    handle->done = 0;
+    handle->status = 0;
+    handle->length = length;
+    handle->peer = peer;
+    return d->t.ops->isend(&d->t, peer, buf, length, (uint64_t)(uintptr_t)handle);
+}
+
+int libdccs_irecv(struct libdccs *d, int peer, void *buf, size_t length, struct libdccs_handle *handle) {
+    handle->done = 0;
+    handle->status = 0;
+    handle->length = 0;
+    handle->peer = peer;
+    return d->t.ops->irecv(&d->t, peer, buf, length, (uint64_t)(uintptr_t)handle);
+}
+
+/**
+ * Reap completions into their handles.
+ */
+int libdccs_poll(struct libdccs *d) {
+    struct dccs_completion completions[TRANSPORT_POLL_BATCH];
+    int rv = d->t.ops->poll(&d->t, completions, TRANSPORT_POLL_BATCH);
+
+    for (int k = 0; k < rv; k++) {
+        struct libdccs_handle *handle = (struct libdccs_handle *)(uintptr_t)completions[k].wr_id;
+        if (!completions[k].is_send)
+            handle->length = completions[k].length;
+        handle->status = completions[k].ok ? 0 : -EIO;
+        handle->done = 1;
+    }
+
+    return rv;
+}
+
+int libdccs_test(struct libdccs *d, struct libdccs_handle *handle) {
+    int rv;
+
+    if (handle->done)
+        return 1;
+    if ((rv = libdccs_poll(d)) < 0)
+        return rv;
+
+    return handle->done;
+}
+
+int libdccs_wait(struct libdccs *d, struct libdccs_handle *handle) {
+    int rv;
+
+    while (!handle->done) {
+        if ((rv = libdccs_poll(d)) < 0)
+            return rv;
+    }
+
+    return handle->status;
+}
+
+ssize_t libdccs_send(struct libdccs *d, int peer, void *buf, size_t length) {
+    struct libdccs_handle handle;
+    int rv;
+
+    if ((rv = libdccs_isend(d, peer, buf, length, &handle)) != 0 || (rv = libdccs_wait(d, &handle)) != 0)
+        return rv < 0 ? rv : -EIO;
+
+    return (ssize_t)handle.length;
+}
+
+ssize_t libdccs_recv(struct libdccs *d, int peer, void *buf, size_t length) {
+    struct libdccs_handle handle;
+    int rv;
+
+    if ((rv = libdccs_irecv(d, peer, buf, length, &handle)) != 0 || (rv = libdccs_wait(d, &handle)) != 0)
+        return rv < 0 ? rv : -EIO;
+
+    return (ssize_t)handle.length;
+}
+
+int libdccs_barrier(struct libdccs *d) {
+    return d->t.ops->barrier(&d->t);
+}
@@ -0,0 +1,65 @@
+/**
+ * libdccs: socket-like messaging over the transport daemon, or directly over
+ * RDMA verbs or MPI, following docs/transport_daemon.md.
+ *
+ * Memory registration and queue pairs stay inside the library: any buffer
+ * may be sent or received into, and buffers from libdccs_malloc() travel
+ * without a copy through the daemon. Operations complete out of order into
+ * caller-owned handles, which libdccs_test(), libdccs_wait() and
+ * libdccs_poll() fill.
+ *
+ * As in the transport underneath, a receive must be posted before its
+ * message can arrive, and nothing may be outstanding across
+ * libdccs_barrier().
+ */
+
+#ifndef LIBDCCS_H
+#define LIBDCCS_H
+
+#include <stddef.h>
+#include <sys/types.h>
+
+#define LIBDCCS_API __attribute__((visibility("default")))
+
+struct libdccs;
+
+struct libdccs_config {
+    const char *backend;    // "daemon", "verbs" or "mpi"; NULL for "daemon"
+    const char *shm_name;   // daemon: its segment; NULL for the default
+    const char *server;     // verbs: the server, or NULL to be it
+    const char *port;       // verbs: NULL for the default
+    size_t peers;           // verbs server: peers to accept; 0 for 1
+    int *argc;              // mpi: the command line, for MPI_Init()
+    char ***argv;
+};
+
+struct libdccs_handle {
+    volatile int done;
+    int status;             // 0, or a negative errno
+    size_t length;          // Bytes moved
+    int peer;
+};
+
+/* Set up and tear down */
+LIBDCCS_API struct libdccs *libdccs_open(const struct libdccs_config *config);
+LIBDCCS_API int libdccs_is_server(struct libdccs *d);
+LIBDCCS_API int libdccs_listen(struct libdccs *d);
+LIBDCCS_API int libdccs_accept(struct libdccs *d);      // New peer, or negative
+LIBDCCS_API int libdccs_connect(struct libdccs *d);     // Server peer, or negative
+LIBDCCS_API void libdccs_disconnect(struct libdccs *d);
+
+/* Buffers */
+LIBDCCS_API void *libdccs_malloc(struct libdccs *d, size_t length);
+LIBDCCS_API void libdccs_free(struct libdccs *d, void *buf);
+
+/* Data transfer */
+LIBDCCS_API int libdccs_isend(struct libdccs *d, int peer, void *buf, size_t length, struct libdccs_handle *handle);
+LIBDCCS_API int libdccs_irecv(struct libdccs *d, int peer, void *buf, size_t length, struct libdccs_handle *handle);
+LIBDCCS_API ssize_t libdccs_send(struct libdccs *d, int peer, void *buf, size_t length);
+LIBDCCS_API ssize_t libdccs_recv(struct libdccs *d, int peer, void *buf, size_t length);
+LIBDCCS_API int libdccs_poll(struct libdccs *d);                                // Handles completed, or negative
+LIBDCCS_API int libdccs_test(struct libdccs *d, struct libdccs_handle *handle); // 1 if done, 0, or negative
+LIBDCCS_API int libdccs_wait(struct libdccs *d, struct libdccs_handle *handle); // The handle's status
+LIBDCCS_API int libdccs_barrier(struct libdccs *d);
+
+#endif // LIBDCCS_H
@@ -0,0 +1,200 @@
+// libdccs benchmark: rdma_exec's Send workload through the socket-like library,
+// over the transport daemon, verbs or MPI
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "dccs_parameters.h"
+#include "dccs_utils.h"
+#include "dccs_rdma.h"
+#include "libdccs.h"
+
+uint64_t clock_rate = 0;    // Clock ticks per second
+
+/*
+ * Workload: as rdma_exec with -v send. The client sends count messages, one
+ * at a time until its send completes in latency mode and with up to a window
+ * in flight otherwise; the server keeps a window of receives posted per peer.
+ */
+
+static int client_run(struct libdccs *d, struct dccs_parameters *params, struct dccs_request *requests,
+                      struct libdccs_handle *handles, void **bufs, size_t window) {
+    size_t sent = 0, done = 0;
+    int failed_count = 0, rv;
+
+    while (done < params->count) {
+        while (sent < params->count && sent - done < window) {
+            requests[sent].start = get_cycles();
+            if (libdccs_isend(d, 0, bufs[sent % window], params->length, handles + sent) != 0)
+                return -1;
+            sent++;
+        }
+
+        if ((rv = libdccs_poll(d)) < 0)
+            return rv;
+        if (rv == 0)
+            continue;
+
+        uint64_t now = get_cycles();
+        for (; done < sent && handles[done].done; done++) {
+            requests[done].end = now;
+            if (handles[done].status != 0)
+                failed_count++;
+        }
+    }
+
+    return -failed_count;
+}
+
+static int server_run(struct libdccs *d, struct dccs_parameters *params, size_t peers,
+                      struct libdccs_handle *handles, void **bufs, size_t window) {
+    size_t expected = peers * params->count, received = 0, bytes = 0;
+    size_t *posted = calloc(peers, sizeof(size_t));
+    int failed_count = 0, rv = 0;
+
+    // handles and bufs hold a window per peer.
+    for (size_t p = 0; p < peers; p++) {
+        for (; posted[p] < window && posted[p] < params->count; posted[p]++) {
+            size_t k = p * window + posted[p];
+            if (libdccs_irecv(d, (int)p, bufs[k], params->length, handles + k) != 0) {
+                rv = -1;
+                goto out;
+            }
+        }
+    }
+
+    while (received < expected) {
+        if ((rv = libdccs_poll(d)) < 0)
+            goto out;
+
+        for (size_t k = 0; k < peers * window; k++) {
+            if (!handles[k].done)
+                continue;
+
+            size_t p = k / window;
+            received++;
+            bytes += handles[k].length;
+            if (handles[k].status != 0)
+                failed_count++;
+
+            handles[k].done = 0;
+            if (posted[p] < params->count) {
+                if (libdccs_irecv(d, (int)p, bufs[k], params->length, handles + k) != 0) {
+                    rv = -1;
+                    goto out;
+                }
+                posted[p]++;
+            }
+        }
+    }
+
+    log_info("Received %zu bytes from %zu peer(s).\n", bytes, peers);
+    rv = -failed_count;
+
+out:
+    free(posted);
+    return rv;
+}
+
+int run(struct libdccs *d, struct dccs_parameters *params) {
+    size_t peers = 1, window = params->mode == MODE_LATENCY ? 1 : params->window;
+    struct dccs_request *requests = NULL;
+    struct libdccs_handle *handles = NULL;
+    void **bufs = NULL;
+    int rv = 0;
+
+    if (libdccs_is_server(d)) {
+        if ((rv = libdccs_listen(d)) != 0)
+            return rv;
+        for (peers = 0; peers < params->peers; peers++) {
+            if (libdccs_accept(d) < 0) {
+                log_error("Failed to accept peer %zu.\n", peers);
+                return -1;
+            }
+        }
+    } else if (libdccs_connect(d) < 0) {
+        return -1;
+    }
+
+    // A verbs receive queue holds MAX_WR receives; a daemon channel leaves
+    // buffers for the barrier.
+    if (window > MAX_WR - 1)
+        window = MAX_WR - 1;
+    if (params->backend == BACKEND_DAEMON && window > SHM_SLOTS / 2 / peers)
+        window = SHM_SLOTS / 2 / peers;
+    if (window > params->count)
+        window = params->count;
+
+    bufs = calloc(peers * window, sizeof(void *));
+    for (size_t k = 0; k < peers * window; k++) {
+        if ((bufs[k] = libdccs_malloc(d, params->length)) == NULL) {
+            rv = -1;
+            goto out;
+        }
+        memset(bufs[k], (int)(k & 0xff), params->length);
+    }
+    if (libdccs_is_server(d)) {
+        handles = calloc(peers * window, sizeof(struct libdccs_handle));
+    } else {
+        handles = calloc(params->count, sizeof(struct libdccs_handle));
+        requests = calloc(params->count, sizeof(struct dccs_request));
+    }
+
+    for (size_t r = 0; r < params->repeat && rv == 0; r++) {
+        if ((rv = libdccs_barrier(d)) != 0) {
+            log_error("Barrier failed.\n");
+            break;
+        }
+
+        if (libdccs_is_server(d)) {
+            rv = server_run(d, params, peers, handles, bufs, window);
+        } else {
+            rv = client_run(d, params, requests, handles, bufs, window);
+            if (rv == 0 && params->mode == MODE_LATENCY)
+                print_latency_report(params, requests);
+            else if (rv == 0)
+                print_throughput_report(params, requests);
+        }
+        if (rv != 0)
+            log_error("Round %zu failed.\n", r);
+    }
+
+out:
+    for (size_t k = 0; bufs != NULL && k < peers * window; k++) {
+        if (bufs[k] != NULL)
+            libdccs_free(d, bufs[k]);
+    }
+    free(bufs);
+    free(handles);
+    free(requests);
+    return rv;
+}
+
+int main(int argc, char *argv[]) {
+    struct dccs_parameters params;
+    struct libdccs_config config;
+    struct libdccs *d;
+    int rv;
+
+    parse_args(argc, argv, &params);
+    print_parameters(&params);
+    dccs_init();
+
+    memset(&config, 0, sizeof config);
+    config.backend = params.backend == BACKEND_MPI ? "mpi" : params.backend == BACKEND_DAEMON ? "daemon" : "verbs";
+    config.shm_name = params.shm_name;
+    config.server = params.server;
+    config.port = params.port;
+    config.peers = params.peers;
+    config.argc = &argc;
+    config.argv = &argv;
+    if ((d = libdccs_open(&config)) == NULL)
+        return EXIT_FAILURE;
+
+    rv = run(d, &params);
+    libdccs_disconnect(d);
+
+    return rv == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
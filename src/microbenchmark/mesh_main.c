@@ -0,0 +1,317 @@
+// All-to-all RC mesh bootstrap tool
+// Without a server argument, runs the bootstrap coordinator for --hosts members.
+// With one, joins the coordinator at that address as member --index, builds an RC QP
+// to every other member, and reports how long each setup phase took.
+// With --rotor, members then replay rotor traffic over the mesh; with
+// --pattern or --traffic_matrix, they replay a traffic matrix instead.
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+
+#include "dccs_parameters.h"
+#include "dccs_utils.h"
+#include "dccs_bootstrap.h"
+#include "dccs_mesh.h"
+#include "dccs_rotor.h"
+#include "dccs_traffic.h"
+
+uint64_t clock_rate = 0;    // Clock ticks per second
+
+static inline double elapsed_msec(uint64_t start, uint64_t end) {
+    return (double)(end - start) * 1e3 / (double)clock_rate;
+}
+
+int run_coordinator(struct dccs_parameters params) {
+    struct dccs_bootstrap bs;
+    int rv;
+
+    log_info("Coordinating %zu hosts on port %s ...\n", params.hosts, params.port);
+    if ((rv = dccs_bootstrap_coordinate(&bs, params.port, params.hosts, sizeof(struct dccs_qp_info))) != 0)
+        goto out;
+
+    uint64_t start = get_cycles();
+    if ((rv = dccs_bootstrap_route(&bs)) != 0) {
+        log_error("Failed to route endpoint records.\n");
+        goto out;
+    }
+    uint64_t routed = get_cycles();
+
+    // Members are done with their transitions, then with verification.
+    if ((rv = dccs_bootstrap_coordinate_barrier(&bs)) != 0 ||
+            (rv = dccs_bootstrap_coordinate_barrier(&bs)) != 0 ||
+            (rv = dccs_bootstrap_coordinate_barrier(&bs)) != 0)
+        goto out;
+    uint64_t end = get_cycles();
+
+    log_info("Coordinator: route = %.3f ms, until all connected and verified = %.3f ms.\n",
+             elapsed_msec(start, routed), elapsed_msec(start, end));
+out:
+    dccs_bootstrap_close(&bs);
+    return rv;
+}
+
+/**
+ * Replay the rotor schedule, round-robin unless a matching file is given.
+ */
+int run_rotor(struct dccs_mesh *mesh, struct dccs_parameters *params) {
+    struct dccs_rotor rotor;
+    struct dccs_schedule schedule;
+    struct dccs_rotor_message *messages;
+    bool active = false;
+    int rv = 0;
+
+    if (params->matching == NULL) {
+        dccs_rotor_round_robin(&rotor, params->hosts);
+    } else if ((rv = dccs_rotor_load(&rotor, params->matching, params->hosts)) != 0) {
+        log_error("Failed to load matching schedule %s.\n", params->matching);
+        goto out;
+    }
+
+    for (size_t slot = 0; slot < rotor.slots; slot++)
+        active |= dccs_rotor_peer(&rotor, slot, mesh->rank) >= 0;
+    if (!active) {
+        log_info("Rank %zu is idle in every slot.\n", mesh->rank);
+        goto out;
+    }
+
+    // Every slot of the cycle is one matching.
+    params->slots = rotor.slots;
+    dccs_schedule_init(&schedule, params);
+
+    for (size_t n = 0; n < params->repeat; n++) {
+        log_info("Round %zu.\n", n + 1);
+        messages = malloc(params->count * sizeof(struct dccs_rotor_message));
+        if ((rv = rotor_send_messages(mesh, &rotor, &schedule, params, messages)) < 0)
+            log_error("Failed to send %d rotor message(s).\n", -rv);
+        print_rotor_report(params, &rotor, &schedule, mesh->rank, messages);
+        free(messages);
+    }
+
+out:
+    dccs_rotor_free(&rotor);
+    return rv;
+}
+
+struct traffic_flow {
+    size_t messages;        // To send in a round
+    size_t posted;
+    size_t completed;
+    size_t inflight;
+    size_t bytes;
+    uint64_t start;
+    uint64_t end;
+};
+
+/**
+ * Send every flow of this rank as RDMA writes into the destinations' landing
+ * regions, cycling over destinations with up to MAX_WR writes in flight each.
+ */
+int traffic_send_messages(struct dccs_mesh *mesh, struct dccs_sizes *sizes, struct traffic_flow *flows) {
+    struct ibv_wc wc[SCHED_POLL_BATCH];
+    size_t remaining = 0;
+    int failed_count = 0;
+
+    for (size_t peer = 0; peer < mesh->hosts; peer++)
+        remaining += flows[peer].messages;
+
+    while (remaining > 0) {
+        for (size_t peer = 0; peer < mesh->hosts; peer++) {
+            struct traffic_flow *flow = flows + peer;
+            if (flow->posted == flow->messages || flow->inflight == MAX_WR)
+                continue;
+
+            size_t length = dccs_sizes_next(sizes);
+            if (flow->posted == 0)
+                flow->start = get_cycles();
+            flow->posted++;
+            if (dccs_mesh_write(mesh, peer, length, peer) != 0) {
+                flow->completed++;
+                failed_count++;
+                remaining--;
+                continue;
+            }
+            flow->inflight++;
+            flow->bytes += length;
+        }
+
+        int rv = ibv_poll_cq(mesh->send_cq, SCHED_POLL_BATCH, wc);
+        if (rv < 0) {
+            log_error("ibv_poll_cq() failed, error = %d.\n", rv);
+            failed_count += (int)remaining;
+            break;
+        }
+
+        uint64_t t = get_cycles();
+        for (int k = 0; k < rv; k++) {
+            struct traffic_flow *flow = flows + wc[k].wr_id;
+            flow->inflight--;
+            flow->completed++;
+            flow->end = t;
+            remaining--;
+            if (wc[k].status != IBV_WC_SUCCESS) {
+                log_error("Failed status %s (%d) for write to %d\n",
+                    ibv_wc_status_str(wc[k].status), wc[k].status, (int)wc[k].wr_id);
+                failed_count++;
+            }
+        }
+    }
+
+    return -failed_count;
+}
+
+void print_traffic_report(struct dccs_parameters *params, struct dccs_mesh *mesh, struct traffic_flow *flows,
+                          uint64_t start, uint64_t end) {
+    double elapsed = (double)(end - start) / (double)clock_rate;
+    size_t total = 0;
+
+    log_info("=====================\n");
+    log_info("Traffic Report\n");
+    log_info("Pattern: %s, rank %zu of %zu.\n", pattern_name(params->pattern), mesh->rank, mesh->hosts);
+    log_info("peer, messages, bytes, completion (µsec), goodput (Gbps)\n");
+    for (size_t peer = 0; peer < mesh->hosts; peer++) {
+        struct traffic_flow *flow = flows + peer;
+        if (flow->messages == 0)
+            continue;
+
+        double fct = (double)(flow->end - flow->start) / (double)clock_rate;
+        log_info("%zu, %zu, %zu, %.3f, %.3f\n", peer, flow->completed, flow->bytes, fct * MILLION,
+                 (double)flow->bytes * 8 / fct / BILLION);
+        total += flow->bytes;
+    }
+
+    log_info("Elapsed: %.3f µsec, goodput: %.3f Gbps.\n", elapsed * MILLION, (double)total * 8 / elapsed / BILLION);
+    log_info("=====================\n\n");
+}
+
+/**
+ * Replay the traffic matrix; receivers stay passive, so ranks without
+ * outgoing flows have nothing to do.
+ */
+int run_traffic(struct dccs_mesh *mesh, struct dccs_sizes *sizes, struct dccs_parameters *params) {
+    struct dccs_traffic traffic;
+    struct traffic_flow *flows = calloc(mesh->hosts, sizeof(struct traffic_flow));
+    bool active = false;
+    int rv;
+
+    if ((rv = dccs_traffic_init(&traffic, params, mesh->hosts)) != 0) {
+        log_error("Failed to set up traffic pattern.\n");
+        goto out;
+    }
+
+    for (size_t peer = 0; peer < mesh->hosts; peer++)
+        active |= dccs_traffic_weight(&traffic, mesh->rank, peer) > 0;
+    if (!active) {
+        log_info("Rank %zu has no outgoing flows.\n", mesh->rank);
+        goto out;
+    }
+
+    for (size_t n = 0; n < params->repeat; n++) {
+        log_info("Round %zu.\n", n + 1);
+        memset(flows, 0, mesh->hosts * sizeof(struct traffic_flow));
+        for (size_t peer = 0; peer < mesh->hosts; peer++)
+            flows[peer].messages = dccs_traffic_weight(&traffic, mesh->rank, peer) * params->count;
+
+        uint64_t start = get_cycles();
+        if ((rv = traffic_send_messages(mesh, sizes, flows)) < 0)
+            log_error("Failed to send %d message(s).\n", -rv);
+        print_traffic_report(params, mesh, flows, start, get_cycles());
+    }
+
+out:
+    dccs_traffic_free(&traffic);
+    free(flows);
+    return rv;
+}
+
+int run_member(struct dccs_parameters params) {
+    struct dccs_bootstrap bs;
+    struct dccs_mesh mesh;
+    struct dccs_sizes sizes = {0};
+    size_t rank = params.index;
+    size_t threads = params.threads;
+    int rv;
+
+    memset(&bs, 0, sizeof bs);
+    bs.fd = bs.listen_fd = -1;
+
+    if (threads == 0)
+        threads = (size_t)sysconf(_SC_NPROCESSORS_ONLN);
+    if (threads > params.hosts - 1)
+        threads = params.hosts - 1;
+
+    // Landing regions must hold the largest message.
+    if (params.pattern != PATTERN_NONE && (rv = dccs_sizes_init(&sizes, &params, rank)) != 0) {
+        log_error("Failed to load message sizes.\n");
+        dccs_sizes_free(&sizes);
+        return rv;
+    }
+
+    log_info("Joining mesh as rank %zu of %zu ...\n", rank, params.hosts);
+    uint64_t start = get_cycles();
+    if ((rv = dccs_mesh_open(&mesh, params.device, rank, params.hosts, params.gid_index, params.tos)) != 0 ||
+            (rv = dccs_mesh_register_buffer(&mesh, params.pattern != PATTERN_NONE ? sizes.max : params.length)) != 0 ||
+            (rv = dccs_mesh_create_qps(&mesh)) != 0) {
+        log_error("Failed to create mesh QPs.\n");
+        goto out;
+    }
+    uint64_t created = get_cycles();
+
+    if ((rv = dccs_bootstrap_join(&bs, params.server, params.port, rank, params.hosts, sizeof(struct dccs_qp_info))) != 0 ||
+            (rv = dccs_bootstrap_exchange(&bs, mesh.local, mesh.remote)) != 0) {
+        log_error("Failed to exchange endpoint records.\n");
+        goto out;
+    }
+    uint64_t exchanged = get_cycles();
+
+    if ((rv = dccs_mesh_connect_all(&mesh, threads)) != 0) {
+        log_error("Failed to connect %d QP(s).\n", -rv);
+        goto out;
+    }
+    uint64_t connected = get_cycles();
+
+    if ((rv = dccs_bootstrap_barrier(&bs)) != 0)
+        goto out;
+    uint64_t ready = get_cycles();
+
+    log_info("=====================\n");
+    log_info("Mesh Setup Report\n");
+    log_info("rank, hosts, threads, create (ms), exchange (ms), transition (ms), barrier (ms), total (ms)\n");
+    log_info("%zu, %zu, %zu, %.3f, %.3f, %.3f, %.3f, %.3f\n", rank, params.hosts, threads,
+             elapsed_msec(start, created), elapsed_msec(created, exchanged),
+             elapsed_msec(exchanged, connected), elapsed_msec(connected, ready), elapsed_msec(start, ready));
+    log_info("=====================\n\n");
+
+    if ((rv = dccs_mesh_verify(&mesh, &bs)) != 0)
+        log_error("Mesh verification failed.\n");
+    else
+        log_info("Mesh verified with %zu peers.\n", params.hosts - 1);
+
+    if (rv == 0 && params.rotor)
+        rv = run_rotor(&mesh, &params);
+    else if (rv == 0 && params.pattern != PATTERN_NONE)
+        rv = run_traffic(&mesh, &sizes, &params);
+
+    // Do not tear down QPs while peers may still be using them.
+    dccs_bootstrap_barrier(&bs);
+out:
+    dccs_bootstrap_close(&bs);
+    dccs_mesh_close(&mesh);
+    dccs_sizes_free(&sizes);
+    return rv;
+}
+
+int main(int argc, char *argv[]) {
+    struct dccs_parameters params;
+
+    parse_args(argc, argv, &params);
+    print_parameters(&params);
+    dccs_init();
+
+    if (params.server == NULL)
+        return run_coordinator(params);
+
+    dccs_validate(params.hosts > 1 && params.index < params.hosts, argv,
+                  "index must be a rank below hosts, with at least 2 hosts.\n");
+    return run_member(params);
+}
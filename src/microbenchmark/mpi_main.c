@@ -3,6 +3,7 @@
 #define _GNU_SOURCE
 
 #include <mpi.h>
+#include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <time.h>
@@ -14,6 +15,9 @@
 #define MPI_USE_WAIT 0          // Whether to use wait (or test)
 
 #include "dccs_utils.h"
+#include "dccs_rdma.h"
+#include "dccs_digest.h"
+#include "dccs_traffic.h"
 
 uint64_t clock_rate = 0;    // Clock ticks per second
 
@@ -30,144 +34,425 @@ void wait_for_gdb(int rank) {
         sleep(5);
 }
 
-int verify_checksum(const void *buf, size_t buffer_size, int rank, int size) {
-    unsigned char digest[SHA_DIGEST_LENGTH];
-    sha1sum(buf, buffer_size, digest);
-    char *digest_hex = bin_to_hex_string(digest, SHA_DIGEST_LENGTH);
+/**
+ * Check that every rank holds the same buffer. One MPI_Allreduce(MAX) of
+ * the digest and its complement tells every rank whether all digests agree
+ * (the maximum and the complement of the minimum coincide); the digests are
+ * only gathered, to name the ranks that differ, on a mismatch.
+ */
+int verify_checksum(const void *buf, size_t buffer_size, int rank, int size, Digest kind) {
+    uint64_t digest = dccs_digest_buffer(kind, buf, buffer_size);
+    uint64_t local[2] = { digest, ~digest }, global[2];
+
+    MPI_Allreduce(local, global, 2, MPI_UINT64_T, MPI_MAX, MPI_COMM_WORLD);
+    if (global[0] == ~global[1])
+        return 0;
+
+    uint64_t *digests = rank == 0 ? malloc((size_t)size * sizeof(uint64_t)) : NULL;
+    MPI_Gather(&digest, 1, MPI_UINT64_T, digests, 1, MPI_UINT64_T, 0, MPI_COMM_WORLD);
     if (rank == 0) {
-        //log_info("Verifying checksum ...\n");
-        MPI_Status status;
         for (int src = 1; src < size; src++) {
-            unsigned char remote_digest[SHA_DIGEST_LENGTH];
-            MPI_Recv(remote_digest, SHA_DIGEST_LENGTH, MPI_CHAR, src, 0, MPI_COMM_WORLD, &status);
-            if (strncmp((const void *)digest, (const void *)remote_digest, SHA_DIGEST_LENGTH) != 0) {
-                log_error("Incorrect SHA sum from rank %d.\n", src);
-                return -1;
-            }
+            if (digests[src] != digests[0])
+                log_error("Incorrect %s digest from rank %d.\n", digest_name(kind), src);
         }
-
-        //log_info("Checksum verified.\n");
-    } else {
-        MPI_Send(digest, SHA_DIGEST_LENGTH, MPI_CHAR, 0, 0, MPI_COMM_WORLD);
+        free(digests);
     }
 
-    free(digest_hex);
-    return 0;
+    return -1;
 }
 
 #define HOST_ALL -1
 #define HOST_NOSELF - 2
+#define HOST_NONE -3
 
-int send_messages(int size, int rank, const void *buf, struct dccs_parameters params, int to, size_t *bytes_sent) {
-    if (to != HOST_ALL && to != HOST_NOSELF && (to < 0 || to >= size)) {
-        log_error("Invalid send destination %d.\n", to);
-        return -1;
-    }
+/**
+ * Heap-backed pool of in-flight requests. Slots are handed out until the
+ * window is full; then completed requests are retired with MPI_Waitsome (or
+ * MPI_Testsome) and their slots reused.
+ */
+struct mpi_pool {
+    MPI_Request *requests;
+    bool *is_send;          // Kind of the request in every slot
+    int *indices;           // Completed slots, from Waitsome/Testsome
+    int *free_slots;
+    size_t free_count;
+    size_t window;
 
-#if MPI_USE_ASYNC_VERB
-    size_t request_count = 1;
-    if (to == HOST_ALL)
-        request_count = (size_t)size;
-    else if (to == HOST_NOSELF)
-        request_count = (size_t)(size - 1);
-    MPI_Request requests[request_count * params.count];
-    int request_sent = 0;
-#endif
+    // Time the last send and the last receive completed
+    uint64_t send_end;
+    uint64_t recv_end;
 
-    int length = (int)params.length;
-    void *sendbuf;
-    for (size_t n = 0; n < params.count; n++) {
-        sendbuf = (void *)((uint8_t *)buf + n * params.length);
-        for (int dest = 0; dest < size; dest++) {
-            if (to == HOST_NOSELF && dest == rank)
-                continue;
-            else if (to != HOST_ALL && to != HOST_NOSELF && dest != to)
-                continue;
+    // Software overhead of posting
+    size_t posted;
+    uint64_t post_cycles;
+};
 
-#if MPI_USE_ASYNC_VERB
-            MPI_Isend(sendbuf, length, MPI_BYTE, dest, 0, MPI_COMM_WORLD, requests + request_sent);
-#if MPI_FIRE_AND_FORGET
-            MPI_Request_free(requests + request_sent);
-#endif
-            request_sent++;
-#else
-            MPI_Send(sendbuf, length, MPI_BYTE, dest, 0, MPI_COMM_WORLD);
-#endif
-            *bytes_sent += params.length;
-        }
+void mpi_pool_init(struct mpi_pool *pool, size_t window) {
+    pool->window = window;
+    pool->requests = malloc(window * sizeof(MPI_Request));
+    pool->is_send = malloc(window * sizeof(bool));
+    pool->indices = malloc(window * sizeof(int));
+    pool->free_slots = malloc(window * sizeof(int));
+    for (size_t k = 0; k < window; k++) {
+        pool->requests[k] = MPI_REQUEST_NULL;
+        pool->free_slots[k] = (int)(window - 1 - k);
     }
+    pool->free_count = window;
+    pool->send_end = pool->recv_end = 0;
+    pool->posted = 0;
+    pool->post_cycles = 0;
+}
+
+void mpi_pool_free(struct mpi_pool *pool) {
+    free(pool->requests);
+    free(pool->is_send);
+    free(pool->indices);
+    free(pool->free_slots);
+}
+
+/**
+ * Retire at least one completed request.
+ */
+static void mpi_pool_retire(struct mpi_pool *pool) {
+    int completed = 0;
 
-#if MPI_USE_ASYNC_VERB && !MPI_FIRE_AND_FORGET
 #if MPI_USE_WAIT
-    MPI_Waitall(request_count * params.count, requests, MPI_STATUSES_IGNORE);
+    MPI_Waitsome((int)pool->window, pool->requests, &completed, pool->indices, MPI_STATUSES_IGNORE);
 #else
-    int done = 0;
-    while (!done) {
-        MPI_Testall(request_count * params.count, requests, &done, MPI_STATUSES_IGNORE);
-    }
-#endif
+    while (completed == 0)
+        MPI_Testsome((int)pool->window, pool->requests, &completed, pool->indices, MPI_STATUSES_IGNORE);
 #endif
 
-    return 0;
+    uint64_t t = get_cycles();
+    for (int k = 0; k < completed; k++) {
+        int slot = pool->indices[k];
+        if (pool->is_send[slot])
+            pool->send_end = t;
+        else
+            pool->recv_end = t;
+        pool->free_slots[pool->free_count++] = slot;
+    }
+}
+
+/**
+ * Get a free slot for a request of the given kind, waiting for one if the
+ * window is full.
+ */
+static inline MPI_Request *mpi_pool_acquire(struct mpi_pool *pool, bool is_send) {
+    if (pool->free_count == 0)
+        mpi_pool_retire(pool);
+
+    int slot = pool->free_slots[--pool->free_count];
+    pool->is_send[slot] = is_send;
+    return pool->requests + slot;
 }
 
-int recv_messages(int size, int rank, const void *buf, struct dccs_parameters params, int from, size_t *bytes_recvd) {
-    if (from != HOST_ALL && from != HOST_NOSELF && (from < 0 || from >= size)) {
+static void mpi_pool_drain(struct mpi_pool *pool) {
+    while (pool->free_count < pool->window)
+        mpi_pool_retire(pool);
+}
+
+/**
+ * End of a round: the later of its last send and last receive, of those this
+ * rank took part in.
+ */
+static inline uint64_t mpi_round_end(bool sent, bool received, uint64_t send_end, uint64_t recv_end) {
+    if (!received)
+        return send_end;
+    if (!sent)
+        return recv_end;
+    return send_end > recv_end ? send_end : recv_end;
+}
+
+static inline bool mpi_peer_selected(int peer, int selector, int rank) {
+    if (selector == HOST_ALL)
+        return true;
+    if (selector == HOST_NOSELF)
+        return peer != rank;
+    return peer == selector;
+}
+
+/**
+ * Send count messages from send_buf to every rank selected by to, and receive
+ * count messages into recv_buf from every rank selected by from (HOST_ALL,
+ * HOST_NOSELF, a rank, or HOST_NONE). Receives and sends are posted
+ * interleaved, in the same order on every rank, so that with a window of at
+ * least two a full window on one rank only ever waits for operations its
+ * peers have already posted.
+ */
+int transfer_messages(int size, int rank, void *send_buf, void *recv_buf, struct dccs_parameters params, int to,
+                      int from, struct mpi_pool *pool, size_t *bytes_sent, size_t *bytes_recvd) {
+    bool should_send = to != HOST_NONE, should_recv = from != HOST_NONE;
+
+    if (should_send && to != HOST_ALL && to != HOST_NOSELF && to >= size) {
+        log_error("Invalid send destination %d.\n", to);
+        return -1;
+    }
+    if (should_recv && from != HOST_ALL && from != HOST_NOSELF && from >= size) {
         log_error("Invalid receive source %d.\n", from);
         return -1;
     }
 
-#if MPI_USE_ASYNC_VERB
-    size_t request_count = 1;
-    if (from == HOST_ALL)
-        request_count = (size_t)size;
-    else if (from == HOST_NOSELF)
-        request_count = (size_t)(size - 1);
-    MPI_Request requests[request_count * params.count];
-    int request_sent = 0;
-#endif
-
     int length = (int)params.length;
-    void *recvbuf;
+    uint64_t t;
     for (size_t n = 0; n < params.count; n++) {
-        recvbuf = (void *)((uint8_t *)buf + n * params.length);
-        for (int src = 0; src < size; src++) {
-            if (from == HOST_NOSELF && src == rank)
-                continue;
-            else if (from != HOST_ALL && from != HOST_NOSELF && src != from)
-                continue;
+        void *send_msg = (uint8_t *)send_buf + n * params.length;
+        void *recv_msg = (uint8_t *)recv_buf + n * params.length;
+        for (int peer = 0; peer < size; peer++) {
+            if (should_recv && mpi_peer_selected(peer, from, rank)) {
+#if MPI_USE_ASYNC_VERB
+                MPI_Request *request = mpi_pool_acquire(pool, false);
+                t = get_cycles();
+                MPI_Irecv(recv_msg, length, MPI_BYTE, peer, 0, MPI_COMM_WORLD, request);
+                pool->post_cycles += get_cycles() - t;
+#else
+                t = get_cycles();
+                MPI_Recv(recv_msg, length, MPI_BYTE, peer, 0, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+                pool->recv_end = get_cycles();
+                pool->post_cycles += pool->recv_end - t;
+#endif
+                pool->posted++;
+                *bytes_recvd += params.length;
+            }
 
+            if (should_send && mpi_peer_selected(peer, to, rank)) {
 #if MPI_USE_ASYNC_VERB
-            MPI_Irecv(recvbuf, length, MPI_BYTE, src, 0, MPI_COMM_WORLD, requests + request_sent);
-            request_sent++;
+                MPI_Request *request = mpi_pool_acquire(pool, true);
+                t = get_cycles();
+                MPI_Isend(send_msg, length, MPI_BYTE, peer, 0, MPI_COMM_WORLD, request);
+                pool->post_cycles += get_cycles() - t;
 #else
-            MPI_Recv(recvbuf, length, MPI_BYTE, src, 0, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+                t = get_cycles();
+                MPI_Send(send_msg, length, MPI_BYTE, peer, 0, MPI_COMM_WORLD);
+                pool->send_end = get_cycles();
+                pool->post_cycles += pool->send_end - t;
 #endif
-            *bytes_recvd += params.length;
+                pool->posted++;
+                *bytes_sent += params.length;
+            }
         }
     }
 
-#if MPI_USE_ASYNC_VERB
+    mpi_pool_drain(pool);
+    return 0;
+}
+
+/**
+ * Persistent requests for the transfer of transfer_messages(), built once
+ * with MPI_Recv_init/MPI_Send_init and re-armed every round with
+ * MPI_Startall, so that matching setup is paid once rather than per message.
+ */
+struct mpi_plan {
+    MPI_Request *requests;
+    bool *is_send;
+    int *indices;
+    size_t count;
+    size_t bytes_sent;
+    size_t bytes_recvd;
+
+    // Last round
+    uint64_t post_cycles;
+    uint64_t send_end;
+    uint64_t recv_end;
+};
+
+void mpi_plan_init(struct mpi_plan *plan, int size, int rank, void *send_buf, void *recv_buf,
+                   struct dccs_parameters params, int to, int from) {
+    bool should_send = to != HOST_NONE, should_recv = from != HOST_NONE;
+    size_t capacity = 2 * params.count * (size_t)size;
+    int length = (int)params.length;
+
+    memset(plan, 0, sizeof *plan);
+    plan->requests = malloc(capacity * sizeof(MPI_Request));
+    plan->is_send = malloc(capacity * sizeof(bool));
+    plan->indices = malloc(capacity * sizeof(int));
+
+    // Same order as transfer_messages()
+    for (size_t n = 0; n < params.count; n++) {
+        void *send_msg = (uint8_t *)send_buf + n * params.length;
+        void *recv_msg = (uint8_t *)recv_buf + n * params.length;
+        for (int peer = 0; peer < size; peer++) {
+            if (should_recv && mpi_peer_selected(peer, from, rank)) {
+                plan->is_send[plan->count] = false;
+                MPI_Recv_init(recv_msg, length, MPI_BYTE, peer, 0, MPI_COMM_WORLD, plan->requests + plan->count++);
+                plan->bytes_recvd += params.length;
+            }
+
+            if (should_send && mpi_peer_selected(peer, to, rank)) {
+                plan->is_send[plan->count] = true;
+                MPI_Send_init(send_msg, length, MPI_BYTE, peer, 0, MPI_COMM_WORLD, plan->requests + plan->count++);
+                plan->bytes_sent += params.length;
+            }
+        }
+    }
+}
+
+/**
+ * Start every request of the plan and wait for all of them. Completed
+ * persistent requests stay allocated, inactive, until the next round.
+ */
+void mpi_plan_run(struct mpi_plan *plan) {
+    size_t remaining = plan->count;
+    int completed;
+
+    uint64_t start = get_cycles();
+    MPI_Startall((int)plan->count, plan->requests);
+    plan->post_cycles = get_cycles() - start;
+
+    while (remaining > 0) {
 #if MPI_USE_WAIT
-    MPI_Waitall(request_count * params.count, requests, MPI_STATUSES_IGNORE);
+        MPI_Waitsome((int)plan->count, plan->requests, &completed, plan->indices, MPI_STATUSES_IGNORE);
 #else
-    int done = 0;
-    while (!done) {
-        int total_count = (int)(request_count * params.count);
-        MPI_Testall(total_count, requests, &done, MPI_STATUSES_IGNORE);
-    }
-#endif
+        completed = 0;
+        while (completed == 0)
+            MPI_Testsome((int)plan->count, plan->requests, &completed, plan->indices, MPI_STATUSES_IGNORE);
 #endif
+        if (completed == MPI_UNDEFINED)
+            break;
 
-    return 0;
+        uint64_t t = get_cycles();
+        for (int k = 0; k < completed; k++) {
+            if (plan->is_send[plan->indices[k]])
+                plan->send_end = t;
+            else
+                plan->recv_end = t;
+        }
+        remaining -= (size_t)completed;
+    }
+}
+
+void mpi_plan_free(struct mpi_plan *plan) {
+    for (size_t k = 0; k < plan->count; k++)
+        MPI_Request_free(plan->requests + k);
+    free(plan->requests);
+    free(plan->is_send);
+    free(plan->indices);
+}
+
+/**
+ * Print, per path, the software cost of posting a message and the time to
+ * complete a round, averaged over rounds.
+ */
+void print_persistent_report(int rank, size_t rounds, size_t messages, size_t bytes, uint64_t pool_post,
+                             uint64_t pool_round, uint64_t plan_post, uint64_t plan_round) {
+    double scale = (double)rounds * (double)messages;
+    double pool_elapsed = (double)pool_round / (double)rounds / (double)clock_rate;
+    double plan_elapsed = (double)plan_round / (double)rounds / (double)clock_rate;
+
+    log_info("=====================\n");
+    log_info("Persistent Request Report, rank %d\n", rank);
+    log_info("path, messages, post (nsec/message), round (µsec), throughput (Gbps)\n");
+    log_info("isend, %zu, %.1f, %.3f, %.3f\n", messages, (double)pool_post * BILLION / (double)clock_rate / scale,
+             pool_elapsed * MILLION, (double)bytes * 8 / pool_elapsed / BILLION);
+    log_info("persistent, %zu, %.1f, %.3f, %.3f\n", messages, (double)plan_post * BILLION / (double)clock_rate / scale,
+             plan_elapsed * MILLION, (double)bytes * 8 / plan_elapsed / BILLION);
+    log_info("=====================\n\n");
+}
+
+/**
+ * Replay a traffic matrix: rank src sends count * weight messages to every
+ * rank dst, with sizes drawn from the size distribution. Messages go out in
+ * rounds, one per flow and round, so that the receives of a flow never
+ * overlap in its landing region; receivers learn sizes from the status.
+ */
+int run_traffic(int size, int rank, struct dccs_parameters params) {
+    struct dccs_traffic traffic;
+    struct dccs_sizes sizes = {0};
+    size_t hosts = (size_t)size, me = (size_t)rank;
+    size_t rounds = 0, flows_out = 0, flows_in = 0;
+    int rv;
+
+    if ((rv = dccs_traffic_init(&traffic, &params, hosts)) != 0 ||
+            (rv = dccs_sizes_init(&sizes, &params, me)) != 0) {
+        log_error("Failed to set up traffic pattern.\n");
+        goto out;
+    }
+
+    for (size_t peer = 0; peer < hosts; peer++) {
+        size_t out = dccs_traffic_weight(&traffic, me, peer), in = dccs_traffic_weight(&traffic, peer, me);
+        flows_out += out > 0;
+        flows_in += in > 0;
+        if (out * params.count > rounds)
+            rounds = out * params.count;
+        if (in * params.count > rounds)
+            rounds = in * params.count;
+    }
+
+    void *sendbuf = malloc_random(sizes.max);
+    void *recvbuf = malloc(hosts * sizes.max);
+    MPI_Request *requests = malloc(2 * hosts * sizeof(MPI_Request));
+    MPI_Status *statuses = malloc(2 * hosts * sizeof(MPI_Status));
+
+    for (size_t r = 0; r < params.repeat; r++) {
+        size_t messages_sent = 0, bytes_sent = 0, bytes_recvd = 0;
+
+        MPI_Barrier(MPI_COMM_WORLD);
+        uint64_t start = get_cycles();
+        for (size_t round = 0; round < rounds; round++) {
+            int request_count = 0, recv_count = 0;
+            for (size_t peer = 0; peer < hosts; peer++) {
+                if (round < dccs_traffic_weight(&traffic, peer, me) * params.count) {
+                    MPI_Irecv((uint8_t *)recvbuf + peer * sizes.max, (int)sizes.max, MPI_BYTE, (int)peer, 0,
+                              MPI_COMM_WORLD, requests + request_count++);
+                    recv_count++;
+                }
+            }
+            for (size_t peer = 0; peer < hosts; peer++) {
+                if (round < dccs_traffic_weight(&traffic, me, peer) * params.count) {
+                    size_t length = dccs_sizes_next(&sizes);
+                    MPI_Isend(sendbuf, (int)length, MPI_BYTE, (int)peer, 0, MPI_COMM_WORLD, requests + request_count++);
+                    messages_sent++;
+                    bytes_sent += length;
+                }
+            }
+
+            MPI_Waitall(request_count, requests, statuses);
+            for (int k = 0; k < recv_count; k++) {
+                int length;
+                MPI_Get_count(statuses + k, MPI_BYTE, &length);
+                bytes_recvd += (size_t)length;
+            }
+        }
+        uint64_t end = get_cycles();
+
+        double elapsed = (double)(end - start) / (double)clock_rate;
+        log_info("round = %zu, rank = %d, flows out = %zu, flows in = %zu, messages sent = %zu, bytes sent = %zu, "
+                 "bytes recv'd = %zu, elapsed = %.3fµsec, throughput = %.3f gbits.\n", r, rank, flows_out, flows_in,
+                 messages_sent, bytes_sent, bytes_recvd, elapsed * 1e6, (double)bytes_recvd * 8 / elapsed / BILLION);
+
+        // Aggregate goodput: all bytes over the slowest rank's time
+        double slowest;
+        unsigned long long total, local = bytes_recvd;
+        MPI_Reduce(&elapsed, &slowest, 1, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD);
+        MPI_Reduce(&local, &total, 1, MPI_UNSIGNED_LONG_LONG, MPI_SUM, 0, MPI_COMM_WORLD);
+        if (rank == 0) {
+            log_info("=====================\n");
+            log_info("Traffic Report\n");
+            log_info("pattern, ranks, bytes, elapsed (µsec), aggregate goodput (Gbps)\n");
+            log_info("%s, %d, %llu, %.3f, %.3f\n", pattern_name(params.pattern), size, total, slowest * 1e6,
+                     (double)total * 8 / slowest / BILLION);
+            log_info("=====================\n\n");
+        }
+    }
+
+    free(sendbuf);
+    free(recvbuf);
+    free(requests);
+    free(statuses);
+out:
+    dccs_sizes_free(&sizes);
+    dccs_traffic_free(&traffic);
+    return rv;
 }
 
 int run(int size, int rank, struct dccs_parameters params) {
     int rv = 0;
-    void *buf;
-    uint64_t start, end;
+    void *buf, *recv_buf;
+    uint64_t start;
     bool should_send, should_recv;
     int send_target, recv_source;
+    struct mpi_pool pool;
+    uint64_t pool_round = 0;
 
     size_t bytes_sent, bytes_recvd;
 
@@ -179,8 +464,10 @@ int run(int size, int rank, struct dccs_parameters params) {
     params.length = strlen(SYNC_PACKET_HEADER) + sizeof slot;
 #endif
 
+    // Receives land apart from the messages being sent, which MPI must not see modified.
     size_t buffer_size = params.length * params.count;
     buf = malloc_random(buffer_size);
+    recv_buf = malloc(buffer_size);
 
 #if TEST_SYNC_PACKET
     strcpy(buf, SYNC_PACKET_HEADER);
@@ -215,40 +502,73 @@ int run(int size, int rank, struct dccs_parameters params) {
             break;
     }
 
+    if (!should_send)
+        send_target = HOST_NONE;
+    if (!should_recv)
+        recv_source = HOST_NONE;
+
     //MPI_Barrier(MPI_COMM_WORLD);
     //start = get_cycles();
 
+    mpi_pool_init(&pool, params.window);
     for (size_t r = 0; r < params.repeat; r++) {
         MPI_Barrier(MPI_COMM_WORLD);
 
         //buf = malloc_random(buffer_size);
         bytes_sent = bytes_recvd = 0;
 
-        if (should_send) {
-            //start = get_cycles();
-            send_messages(size, rank, buf, params, send_target, &bytes_sent);
-            //end = get_cycles();
-        }
+        // Senders are done once their last send completed, not when it was posted.
+        start = get_cycles();
+        if ((rv = transfer_messages(size, rank, buf, recv_buf, params, send_target, recv_source, &pool,
+                                    &bytes_sent, &bytes_recvd)) != 0)
+            break;
 
-        if (should_recv) {
-            start = get_cycles();
-            recv_messages(size, rank, buf, params, recv_source, &bytes_recvd);
-            end = get_cycles();
+        if (should_send) {
+            double elapsed = (double)(pool.send_end - start) / (double)clock_rate;
+            double elapsed_usec = elapsed * 1e6;
+            double throughput_gbits = (double)bytes_sent * 8 / elapsed / (1024 * 1024 * 1024);
+            log_info("round = %zu, rank = %d, bytes sent = %zu, elapsed = %.3fµsec, throughput = %.3f gbits.\n", r, rank, bytes_sent, elapsed_usec, throughput_gbits);
         }
 
         if (should_recv) {
-            double elapsed = (double)(end - start) / (double)clock_rate;
+            double elapsed = (double)(pool.recv_end - start) / (double)clock_rate;
             double elapsed_usec = elapsed * 1e6;
             double throughput_gbits = (double)bytes_recvd * 8 / elapsed / (1024 * 1024 * 1024);
             log_info("round = %zu, rank = %d, bytes recv'd = %zu, elapsed = %.3fµsec, throughput = %.3f gbits.\n", r, rank, bytes_recvd, elapsed_usec, throughput_gbits);
         }
 
+        pool_round += mpi_round_end(should_send, should_recv, pool.send_end, pool.recv_end) - start;
+
         //verify_checksum(buf, buffer_size, rank, size);
         //free(buf);
     }
 
-    verify_checksum(buf, buffer_size, rank, size);
+    // Same transfer again, set up once and restarted every round
+    if (params.persistent && rv == 0) {
+        struct mpi_plan plan;
+        uint64_t plan_post = 0, plan_round = 0;
+
+        mpi_plan_init(&plan, size, rank, buf, recv_buf, params, send_target, recv_source);
+        for (size_t r = 0; r < params.repeat; r++) {
+            MPI_Barrier(MPI_COMM_WORLD);
+            start = get_cycles();
+            mpi_plan_run(&plan);
+            plan_post += plan.post_cycles;
+            plan_round += mpi_round_end(should_send, should_recv, plan.send_end, plan.recv_end) - start;
+        }
+
+        if (plan.count > 0)
+            print_persistent_report(rank, params.repeat, plan.count, plan.bytes_sent + plan.bytes_recvd,
+                                    pool.post_cycles, pool_round, plan_post, plan_round);
+        mpi_plan_free(&plan);
+    }
+    mpi_pool_free(&pool);
+
+    // Every rank checks what it received, or what it sent if it only sends.
+    if (verify_checksum(should_recv ? recv_buf : buf, buffer_size, rank, size, params.digest) != 0 && rv == 0)
+        rv = -1;
     free(buf);
+    free(recv_buf);
 
 /*
     end = get_cycles();
@@ -261,6 +581,433 @@ int run(int size, int rank, struct dccs_parameters params) {
     return rv;
 }
 
+typedef enum { COLL_ALLTOALL, COLL_ALLREDUCE, COLL_BCAST, COLL_COUNT } Collective;
+
+static const char *collective_names[COLL_COUNT] = { "alltoall", "allreduce", "bcast" };
+
+/**
+ * Run one collective over comm and wait for it. Alltoall exchanges length
+ * bytes with every rank, allreduce sums length / 8 doubles (at least one),
+ * and bcast sends length bytes from rank 0. The non-blocking variants are
+ * waited for right away, so their extra cost shows against the blocking ones.
+ */
+static void collective_call(Collective c, bool nonblocking, void *sendbuf, void *recvbuf, size_t length,
+                            MPI_Comm comm) {
+    MPI_Request request;
+    int n = (int)length;
+    int doubles = length < sizeof(double) ? 1 : (int)(length / sizeof(double));
+
+    switch (c) {
+        case COLL_ALLTOALL:
+            if (nonblocking)
+                MPI_Ialltoall(sendbuf, n, MPI_BYTE, recvbuf, n, MPI_BYTE, comm, &request);
+            else
+                MPI_Alltoall(sendbuf, n, MPI_BYTE, recvbuf, n, MPI_BYTE, comm);
+            break;
+        case COLL_ALLREDUCE:
+            if (nonblocking)
+                MPI_Iallreduce(sendbuf, recvbuf, doubles, MPI_DOUBLE, MPI_SUM, comm, &request);
+            else
+                MPI_Allreduce(sendbuf, recvbuf, doubles, MPI_DOUBLE, MPI_SUM, comm);
+            break;
+        case COLL_BCAST:
+            if (nonblocking)
+                MPI_Ibcast(recvbuf, n, MPI_BYTE, 0, comm, &request);
+            else
+                MPI_Bcast(recvbuf, n, MPI_BYTE, 0, comm);
+            break;
+        default:
+            return;
+    }
+
+    if (nonblocking)
+        MPI_Wait(&request, MPI_STATUS_IGNORE);
+}
+
+/**
+ * Time count calls of one collective on comm, each after a barrier, and
+ * print on its rank 0 the spread of per-rank means (min/avg/max) and the
+ * percentiles of every call on every rank.
+ */
+static void collective_measure(Collective c, bool nonblocking, void *sendbuf, void *recvbuf, size_t length,
+                               MPI_Comm comm, struct dccs_parameters *params) {
+    int ranks, rank;
+    MPI_Comm_size(comm, &ranks);
+    MPI_Comm_rank(comm, &rank);
+
+    for (size_t n = 0; n < params->warmup_count; n++)
+        collective_call(c, nonblocking, sendbuf, recvbuf, length, comm);
+
+    double *latencies = malloc(params->count * sizeof(double));
+    double sum = 0;
+    for (size_t n = 0; n < params->count; n++) {
+        MPI_Barrier(comm);
+        uint64_t start = get_cycles();
+        collective_call(c, nonblocking, sendbuf, recvbuf, length, comm);
+        latencies[n] = (double)(get_cycles() - start) * MILLION / (double)clock_rate;
+        sum += latencies[n];
+    }
+
+    double mean = sum / (double)params->count, min, max, total;
+    double *all = rank == 0 ? malloc((size_t)ranks * params->count * sizeof(double)) : NULL;
+    MPI_Reduce(&mean, &min, 1, MPI_DOUBLE, MPI_MIN, 0, comm);
+    MPI_Reduce(&mean, &max, 1, MPI_DOUBLE, MPI_MAX, 0, comm);
+    MPI_Reduce(&mean, &total, 1, MPI_DOUBLE, MPI_SUM, 0, comm);
+    MPI_Gather(latencies, (int)params->count, MPI_DOUBLE, all, (int)params->count, MPI_DOUBLE, 0, comm);
+
+    if (rank == 0) {
+        size_t samples = (size_t)ranks * params->count;
+        sort_latencies(all, samples);
+        log_info("%s, %s, %d, %zu, %.3f, %.3f, %.3f, %.3f, %.3f, %.3f\n", collective_names[c],
+                 nonblocking ? "non-blocking" : "blocking", ranks, length, min, total / ranks, max,
+                 all[samples / 2], all[(size_t)((double)samples * 0.99)], all[samples - 1]);
+    }
+
+    free(latencies);
+    free(all);
+}
+
+/**
+ * Benchmark the listed collectives, blocking and non-blocking, on
+ * communicators of 2, 4, 8, ... ranks and all ranks, for message lengths
+ * doubling from COLLECTIVE_MIN_LENGTH up to the block size.
+ */
+int run_collectives(int size, int rank, struct dccs_parameters params) {
+    bool selected[COLL_COUNT] = { false };
+    char *list = strdup(params.collectives), *saveptr = NULL;
+    int rv = 0;
+
+    for (char *name = strtok_r(list, ",", &saveptr); name != NULL; name = strtok_r(NULL, ",", &saveptr)) {
+        int c = 0;
+        while (c < COLL_COUNT && strcmp(name, collective_names[c]) != 0)
+            c++;
+        if (c == COLL_COUNT) {
+            if (rank == 0)
+                log_error("Unknown collective '%s'.\n", name);
+            rv = -1;
+            goto out;
+        }
+        selected[c] = true;
+    }
+
+    // Alltoall needs a block per rank; allreduce sums whole doubles.
+    size_t buffer_size = (params.length * (size_t)size + sizeof(double) - 1) / sizeof(double) * sizeof(double);
+    double *sendbuf = malloc(buffer_size), *recvbuf = malloc(buffer_size);
+    for (size_t k = 0; k < buffer_size / sizeof(double); k++)
+        sendbuf[k] = recvbuf[k] = 1.0;
+
+    if (rank == 0) {
+        log_info("=====================\n");
+        log_info("Collective Report\n");
+        log_info("collective, variant, ranks, length, min (µsec), avg (µsec), max (µsec), median (µsec), "
+                 "percent99 (µsec), max call (µsec)\n");
+    }
+
+    int ranks = size < 2 ? size : 2;
+    while (true) {
+        MPI_Comm comm;
+        MPI_Comm_split(MPI_COMM_WORLD, rank < ranks ? 0 : MPI_UNDEFINED, rank, &comm);
+        if (comm != MPI_COMM_NULL) {
+            for (int c = 0; c < COLL_COUNT; c++) {
+                if (!selected[c])
+                    continue;
+
+                size_t length = params.length < COLLECTIVE_MIN_LENGTH ? params.length : COLLECTIVE_MIN_LENGTH;
+                while (true) {
+                    collective_measure((Collective)c, false, sendbuf, recvbuf, length, comm, &params);
+                    collective_measure((Collective)c, true, sendbuf, recvbuf, length, comm, &params);
+                    if (length == params.length)
+                        break;
+                    length = length * 2 < params.length ? length * 2 : params.length;
+                }
+            }
+            MPI_Comm_free(&comm);
+        }
+
+        if (ranks == size)
+            break;
+        ranks = ranks * 2 < size ? ranks * 2 : size;
+    }
+
+    if (rank == 0)
+        log_info("=====================\n\n");
+
+    free(sendbuf);
+    free(recvbuf);
+out:
+    free(list);
+    return rv;
+}
+
+/**
+ * Issue one RMA operation of length bytes to offset 0 of target: MPI_Get for
+ * reads, MPI_Put for writes, and an MPI_Accumulate summing 64-bit words for
+ * fetch-and-add.
+ */
+static inline void rma_issue(Verb verb, void *buf, size_t length, int target, MPI_Win win) {
+    int n = (int)length;
+    int words = length < sizeof(uint64_t) ? 1 : (int)(length / sizeof(uint64_t));
+
+    switch (verb) {
+        case Read:
+            MPI_Get(buf, n, MPI_BYTE, target, 0, n, MPI_BYTE, win);
+            break;
+        case Write:
+            MPI_Put(buf, n, MPI_BYTE, target, 0, n, MPI_BYTE, win);
+            break;
+        case FetchAdd:
+            MPI_Accumulate(buf, words, MPI_UINT64_T, target, 0, words, MPI_UINT64_T, MPI_SUM, win);
+            break;
+        default:
+            break;
+    }
+}
+
+/**
+ * MPI-3 one-sided counterpart of rdma_exec: rank 0 issues count operations
+ * to the windows of the other ranks in turn, in batches of one (latency
+ * mode) or MAX_WR (throughput mode), and every batch is completed with the
+ * configured synchronization:
+ *  - fence: every rank calls MPI_Win_fence around every batch;
+ *  - pscw: rank 0 opens an access epoch (MPI_Win_start/MPI_Win_complete)
+ *    while the targets post and wait for an exposure epoch;
+ *  - passive: rank 0 locks every window once (MPI_Win_lock_all) and flushes
+ *    (MPI_Win_flush_all) after every batch; targets only wait.
+ * Every operation of a batch completes when the batch does.
+ */
+int run_rma(int size, int rank, struct dccs_parameters params) {
+    size_t length = params.verb == FetchAdd ? sizeof(uint64_t) : params.length;
+    size_t depth = params.mode == MODE_LATENCY ? 1 : MAX_WR;
+    size_t batches = (params.count + depth - 1) / depth;
+    struct dccs_request *requests = NULL;
+    MPI_Group world, origin, targets;
+    void *base, *buf;
+    MPI_Win win;
+
+    if (size < 2) {
+        log_error("RMA mode needs at least 2 ranks.\n");
+        return -1;
+    }
+
+    MPI_Win_allocate((MPI_Aint)length, 1, MPI_INFO_NULL, MPI_COMM_WORLD, &base, &win);
+    memset(base, 0, length);
+    buf = malloc_random(length);
+    if (rank == 0)
+        requests = calloc(params.count, sizeof(struct dccs_request));
+
+    int zero = 0;
+    MPI_Comm_group(MPI_COMM_WORLD, &world);
+    MPI_Group_incl(world, 1, &zero, &origin);
+    MPI_Group_excl(world, 1, &zero, &targets);
+
+    MPI_Barrier(MPI_COMM_WORLD);
+    if (params.rma == RMA_FENCE)
+        MPI_Win_fence(MPI_MODE_NOPRECEDE, win);
+    else if (params.rma == RMA_PASSIVE && rank == 0)
+        MPI_Win_lock_all(0, win);
+
+    for (size_t b = 0; b < batches; b++) {
+        size_t first = b * depth, last = first + depth < params.count ? first + depth : params.count;
+
+        if (rank == 0) {
+            if (params.rma == RMA_PSCW)
+                MPI_Win_start(targets, 0, win);
+
+            for (size_t n = first; n < last; n++) {
+                requests[n].start = get_cycles();
+                rma_issue(params.verb, buf, length, (int)(n % (size_t)(size - 1)) + 1, win);
+            }
+
+            if (params.rma == RMA_PSCW)
+                MPI_Win_complete(win);
+            else if (params.rma == RMA_PASSIVE)
+                MPI_Win_flush_all(win);
+        } else if (params.rma == RMA_PSCW) {
+            MPI_Win_post(origin, 0, win);
+            MPI_Win_wait(win);
+        }
+
+        if (params.rma == RMA_FENCE)
+            MPI_Win_fence(b == batches - 1 ? MPI_MODE_NOSUCCEED : 0, win);
+
+        if (rank == 0) {
+            uint64_t end = get_cycles();
+            for (size_t n = first; n < last; n++)
+                requests[n].end = end;
+        }
+    }
+
+    if (params.rma == RMA_PASSIVE && rank == 0)
+        MPI_Win_unlock_all(win);
+    MPI_Barrier(MPI_COMM_WORLD);
+
+    if (rank == 0) {
+        params.length = length;
+        if (params.mode == MODE_LATENCY)
+            print_latency_report(&params, requests);
+        else
+            print_throughput_report(&params, requests);
+    }
+
+    MPI_Group_free(&targets);
+    MPI_Group_free(&origin);
+    MPI_Group_free(&world);
+    MPI_Win_free(&win);
+    free(buf);
+    free(requests);
+    return 0;
+}
+
+struct mpi_thread {
+    MPI_Comm comm;          // Duplicate of MPI_COMM_WORLD, private to the thread
+    int peer;
+    bool sender;
+    size_t cpu;
+    struct dccs_parameters *params;
+    pthread_t thread;
+    pthread_barrier_t *barrier;
+
+    // Last run
+    uint64_t begin;
+    uint64_t end;
+};
+
+/**
+ * Stream count messages to the peer, window at a time, or receive them;
+ * the receiver acknowledges the last window so that the sender's time
+ * covers delivery.
+ */
+static void *mpi_thread_worker(void *arg) {
+    struct mpi_thread *t = arg;
+    struct dccs_parameters *params = t->params;
+    size_t window = params->window < params->count ? params->window : params->count;
+    int length = (int)params->length;
+    cpu_set_t set;
+
+    CPU_ZERO(&set);
+    CPU_SET(t->cpu, &set);
+    if (pthread_setaffinity_np(pthread_self(), sizeof set, &set) != 0)
+        log_warning("Failed to pin thread to CPU %zu.\n", t->cpu);
+
+    void *buf = malloc_random(params->length * window);
+    MPI_Request *requests = malloc(window * sizeof(MPI_Request));
+
+    pthread_barrier_wait(t->barrier);
+    t->begin = get_cycles();
+    for (size_t n = 0; n < params->count; n += window) {
+        int batch = (int)(n + window < params->count ? window : params->count - n);
+        for (int k = 0; k < batch; k++) {
+            void *msgbuf = (uint8_t *)buf + (size_t)k * params->length;
+            if (t->sender)
+                MPI_Isend(msgbuf, length, MPI_BYTE, t->peer, 0, t->comm, requests + k);
+            else
+                MPI_Irecv(msgbuf, length, MPI_BYTE, t->peer, 0, t->comm, requests + k);
+        }
+        MPI_Waitall(batch, requests, MPI_STATUSES_IGNORE);
+    }
+
+    if (t->sender)
+        MPI_Recv(NULL, 0, MPI_BYTE, t->peer, 1, t->comm, MPI_STATUS_IGNORE);
+    else
+        MPI_Send(NULL, 0, MPI_BYTE, t->peer, 1, t->comm);
+    t->end = get_cycles();
+
+    free(requests);
+    free(buf);
+    return NULL;
+}
+
+/**
+ * Message rate with 1, 2, 4, ... up to --threads pinned threads per rank
+ * under MPI_THREAD_MULTIPLE. Even ranks stream to the next odd rank, every
+ * thread on its own duplicated communicator; threads of the ranks sharing a
+ * host are spread over distinct CPUs where there are enough.
+ */
+int run_threads(int size, int rank, struct dccs_parameters params) {
+    size_t threads = params.threads;
+    int peer = rank ^ 1, local_rank, cpus = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    MPI_Comm node;
+
+    if (size < 2) {
+        log_error("Thread scaling needs at least 2 ranks.\n");
+        return -1;
+    }
+
+    MPI_Comm_split_type(MPI_COMM_WORLD, MPI_COMM_TYPE_SHARED, rank, MPI_INFO_NULL, &node);
+    MPI_Comm_rank(node, &local_rank);
+    MPI_Comm_free(&node);
+    if (threads == 0)
+        threads = (size_t)cpus;
+
+    struct mpi_thread *workers = calloc(threads, sizeof(struct mpi_thread));
+    for (size_t k = 0; k < threads; k++) {
+        MPI_Comm_dup(MPI_COMM_WORLD, &workers[k].comm);
+        workers[k].peer = peer;
+        workers[k].sender = rank % 2 == 0;
+        workers[k].cpu = ((size_t)local_rank * threads + k) % (size_t)cpus;
+        workers[k].params = &params;
+    }
+
+    if (rank == 0) {
+        log_info("=====================\n");
+        log_info("Thread Scaling Report\n");
+        log_info("threads, pairs, length, messages, aggregate rate (Mmsg/s), rate per thread (Mmsg/s), "
+                 "throughput (Gbps)\n");
+    }
+
+    size_t active = 1;
+    while (true) {
+        pthread_barrier_t barrier;
+        double rate = 0, total;
+
+        MPI_Barrier(MPI_COMM_WORLD);
+        if (peer < size) {
+            pthread_barrier_init(&barrier, NULL, (unsigned int)active);
+            for (size_t k = 0; k < active; k++) {
+                workers[k].barrier = &barrier;
+                if (pthread_create(&workers[k].thread, NULL, mpi_thread_worker, workers + k) != 0) {
+                    // The barrier can no longer be reached; this is unrecoverable.
+                    log_perror("pthread_create");
+                    MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+                }
+            }
+
+            uint64_t begin = UINT64_MAX, end = 0;
+            for (size_t k = 0; k < active; k++) {
+                pthread_join(workers[k].thread, NULL);
+                if (workers[k].begin < begin)
+                    begin = workers[k].begin;
+                if (workers[k].end > end)
+                    end = workers[k].end;
+            }
+            pthread_barrier_destroy(&barrier);
+
+            if (workers[0].sender)
+                rate = (double)(active * params.count) / ((double)(end - begin) / (double)clock_rate);
+        }
+
+        MPI_Reduce(&rate, &total, 1, MPI_DOUBLE, MPI_SUM, 0, MPI_COMM_WORLD);
+        if (rank == 0) {
+            size_t pairs = (size_t)size / 2;
+            log_info("%zu, %zu, %zu, %zu, %.3f, %.3f, %.3f\n", active, pairs, params.length,
+                     active * pairs * params.count, total / MILLION, total / (double)(active * pairs) / MILLION,
+                     total * (double)params.length * 8 / BILLION);
+        }
+
+        if (active == threads)
+            break;
+        active = active * 2 < threads ? active * 2 : threads;
+    }
+
+    if (rank == 0)
+        log_info("=====================\n\n");
+
+    for (size_t k = 0; k < threads; k++)
+        MPI_Comm_free(&workers[k].comm);
+    free(workers);
+    return 0;
+}
+
 int main(int argc, char *argv[]) {
     int size, rank, rv;
     struct dccs_parameters params;
@@ -269,13 +1016,32 @@ int main(int argc, char *argv[]) {
     print_parameters(&params);
     dccs_init();
 
-    MPI_Init(&argc, &argv);
+    if (params.thread_multiple) {
+        int provided;
+        MPI_Init_thread(&argc, &argv, MPI_THREAD_MULTIPLE, &provided);
+        if (provided < MPI_THREAD_MULTIPLE) {
+            log_error("The MPI library does not support MPI_THREAD_MULTIPLE.\n");
+            MPI_Finalize();
+            return EXIT_FAILURE;
+        }
+    } else {
+        MPI_Init(&argc, &argv);
+    }
     MPI_Comm_size(MPI_COMM_WORLD, &size);
     MPI_Comm_rank(MPI_COMM_WORLD, &rank);
 
     //wait_for_gdb(rank);
 
-    rv = run(size, rank, params);
+    if (params.thread_multiple)
+        rv = run_threads(size, rank, params);
+    else if (params.rma != RMA_NONE)
+        rv = run_rma(size, rank, params);
+    else if (params.collectives != NULL)
+        rv = run_collectives(size, rank, params);
+    else if (params.pattern != PATTERN_NONE)
+        rv = run_traffic(size, rank, params);
+    else
+        rv = run(size, rank, params);
 
     MPI_Finalize();
 
@@ -9,12 +9,24 @@
 #include "dccs_parameters.h"
 #include "dccs_utils.h"
 #include "dccs_rdma.h"
+#include "dccs_digest.h"
+#include "dccs_ud.h"
+#include "dccs_schedule.h"
+#include "dccs_load.h"
+#include "dccs_class.h"
+#include "dccs_rate.h"
 
 uint64_t clock_rate = 0;    // Clock ticks per second
 
 int run(struct dccs_parameters params) {
     struct rdma_cm_id *listen_id = NULL, *id;
     struct dccs_request *requests;
+    struct dccs_schedule schedule;
+    struct dccs_sched_queue *queues = NULL;
+    struct dccs_load_point *points = NULL;
+    struct dccs_rate rate;
+    double *loads = NULL;
+    int load_count = 0;
     int rv = 0;
 
     Role role = params.server == NULL ? ROLE_SERVER : ROLE_CLIENT;
@@ -24,11 +36,16 @@ int run(struct dccs_parameters params) {
         log_info("Running in server mode ...\n");
 
     if (role == ROLE_CLIENT) {
-        if ((rv = dccs_connect(&id, params.server, params.port, params.tos)) != 0)
+        if ((rv = dccs_connect(&id, params.server, params.port, params.tos, (uint32_t)params.sge)) != 0)
             goto end;
     } else {    // role == ROLE_SERVER
-        if ((rv = dccs_listen(&listen_id, &id, params.port)) != 0)
+        if ((rv = dccs_listen(&listen_id, &id, params.port, (uint32_t)params.sge)) != 0)
             goto end;
+
+        // One-sided responders expose a contiguous target for each request;
+        // segments only apply to the requester's local buffers.
+        if (params.verb != Send)
+            params.sge = 1;
     }
 
     log_debug("Allocating buffer ...\n");
@@ -47,7 +64,13 @@ int run(struct dccs_parameters params) {
     memcpy((char *)requests[0].buf + 22, &slot, sizeof slot);
 #endif
 
-    if (params.verb == Read || params.verb == Write) {
+    if (role == ROLE_SERVER && params.verb == WriteImm) {
+        // Post receives before the requester learns where to write.
+        if ((rv = post_imm_recv_ring(id)) != 0)
+            goto out_deallocate_buffer;
+    }
+
+    if (params.verb == Read || params.verb == Write || params.verb == WriteImm || is_atomic_verb(params.verb)) {
         if (role == ROLE_CLIENT) {
             log_debug("Getting remote MR info ...\n");
             rv = get_remote_mr_info(id, requests, params.count);
@@ -56,6 +79,9 @@ int run(struct dccs_parameters params) {
                 log_error("Failed to get remote MR info.\n");
                 goto out_deallocate_buffer;
             }
+
+            if (is_atomic_verb(params.verb))
+                assign_atomic_targets(requests, params);
         } else {    // role == ROLE_SERVER
             log_debug("Sending local MR info ...\n");
             rv = send_local_mr_info(id, requests, params.count);
@@ -66,6 +92,25 @@ int run(struct dccs_parameters params) {
         }
     }
 
+    if (role == ROLE_CLIENT && params.scheduled) {
+        // The connection is a single destination, reachable in its own slot.
+        size_t slot = params.slot;
+        dccs_schedule_init(&schedule, &params);
+        queues = dccs_sched_create_queues(&id, &slot, 1, params.count);
+    }
+
+    if (role == ROLE_CLIENT && params.mode == MODE_OPEN_LOOP) {
+        if ((load_count = dccs_load_parse(params.load, &loads)) < 0) {
+            log_error("Invalid offered load list '%s'.\n", params.load);
+            rv = -1;
+            goto out_deallocate_buffer;
+        }
+        points = calloc((size_t)load_count, sizeof(struct dccs_load_point));
+    }
+
+    if (role == ROLE_CLIENT && params.rate > 0)
+        dccs_rate_init(&rate, id->qp, params.rate, params.burst, params.length, params.rate_hw);
+
     for (size_t n = 0; n < params.repeat; n++) {
         log_info("Round %zu.\n", n + 1);
 
@@ -86,16 +131,45 @@ int run(struct dccs_parameters params) {
             }
  */
 
-            log_info("Sending and waiting for RDMA requests ...\n");
-            if ((rv = send_and_wait_requests(id, requests, &params)) < 0) {
-                log_error("Failed to send and send comp all requests.\n");
-                goto out_end_request;
+            if (params.mode == MODE_OPEN_LOOP) {
+                log_info("Sweeping %d offered load(s) ...\n", load_count);
+                if ((rv = load_sweep(id, requests, &params, loads, (size_t)load_count, points)) < 0) {
+                    log_error("Failed to send and send comp all open-loop requests.\n");
+                    goto out_end_request;
+                }
+            } else if (params.rate > 0) {
+                log_info("Sending RDMA requests at %.3f Gbps ...\n", params.rate);
+                if ((rv = rate_send_requests(id, requests, &params, &rate)) < 0) {
+                    log_error("Failed to send and send comp all rate-limited requests.\n");
+                    goto out_end_request;
+                }
+            } else if (params.scheduled) {
+                log_info("Sending RDMA requests in slot %u of %zu ...\n", params.slot, params.slots);
+                if ((rv = sched_send_requests(queues, 1, requests, &params, &schedule)) < 0) {
+                    log_error("Failed to send and send comp all scheduled requests.\n");
+                    goto out_end_request;
+                }
+            } else {
+                log_info("Sending and waiting for RDMA requests ...\n");
+                if ((rv = send_and_wait_requests(id, requests, &params)) < 0) {
+                    log_error("Failed to send and send comp all requests.\n");
+                    goto out_end_request;
+                }
             }
         } else {    // role == ROLE_SERVER
             switch (params.verb) {
                 case Read:
                 case Write:
+                case FetchAdd:
+                case CompSwap:
                     // Server is passive in RDMA experiments, i.e. responder.
+                    break;
+                case WriteImm:
+                    if ((rv = recv_imm_requests(id, requests, &params)) < 0) {
+                        log_error("Failed to receive all immediates.\n");
+                        goto out_end_request;
+                    }
+
                     break;
                 case Send:
                     if ((rv = recv_requests(id, requests, &params)) < 0) {
@@ -121,12 +195,29 @@ out_end_request:
                 case MODE_THROUGHPUT:
                     print_throughput_report(&params, requests);
                     break;
+                case MODE_OPEN_LOOP:
+                    print_load_report(&params, points, (size_t)load_count);
+                    break;
             }
+
+            if (params.rate > 0)
+                print_rate_report(&params, requests, &rate);
+            if (params.scheduled)
+                print_schedule_report(&params, &schedule, queues, 1, requests);
+            if (is_atomic_verb(params.verb))
+                print_atomic_report(&params, requests, role);
+            print_copy_report(&params, requests);
+        } else if (params.verb == WriteImm) {
+            print_delivery_report(&params, requests);
+        } else if (params.verb == Send) {
+            print_copy_report(&params, requests);
         }
     }
 
     // Synchronize end of a round
-    if (role == ROLE_CLIENT) {
+    if (params.verb == WriteImm) {
+        // The responder already saw every write complete through its immediates.
+    } else if (role == ROLE_CLIENT) {
         log_debug("Sending terminating message ...\n");
         char buf[SYNC_END_MESSAGE_LENGTH] = SYNC_END_MESSAGE;
         if ((rv = send_message(id, buf, SYNC_END_MESSAGE_LENGTH)) < 0) {
@@ -143,10 +234,16 @@ out_end_request:
     }
 
     // Print stats
-    print_sha1sum(requests, params.count);
+    print_digest(&params, requests, params.count);
+    if (role == ROLE_SERVER && is_atomic_verb(params.verb))
+        print_atomic_report(&params, requests, role);
 
 out_deallocate_buffer:
     log_debug("de-allocating buffer\n");
+    if (queues != NULL)
+        dccs_sched_free_queues(queues, 1);
+    free(loads);
+    free(points);
     deallocate_buffer(requests, params);
 out_disconnect:
     log_debug("Disconnecting\n");
@@ -158,6 +255,193 @@ end:
     return rv;
 }
 
+/**
+ * Traffic class benchmark: one connection per class, all to the same server
+ * port, set up one after the other so both sides agree on which is which.
+ * The server is passive; the client runs all classes at once every round.
+ */
+int run_classes(struct dccs_parameters params) {
+    struct rdma_cm_id *listen_id = NULL;
+    struct dccs_class *classes;
+    size_t connected = 0, allocated = 0;
+    int rv = 0;
+
+    int class_count = dccs_class_parse(params.classes, &params, &classes);
+    if (class_count < 0)
+        return -1;
+
+    Role role = params.server == NULL ? ROLE_SERVER : ROLE_CLIENT;
+    log_info("Running %d traffic classes in %s mode ...\n", class_count, role == ROLE_CLIENT ? "client" : "server");
+
+    for (size_t k = 0; k < (size_t)class_count; k++) {
+        struct dccs_class *c = classes + k;
+
+        if (role == ROLE_CLIENT)
+            rv = dccs_connect(&c->id, params.server, params.port, c->params.tos, 1);
+        else if (k == 0)
+            rv = dccs_listen(&listen_id, &c->id, params.port, 1);
+        else
+            rv = dccs_accept(listen_id, &c->id);
+        if (rv != 0)
+            goto out_deallocate_buffer;
+        connected++;
+
+        c->requests = calloc(c->params.count, sizeof(struct dccs_request));
+        if ((rv = allocate_buffer(c->id, c->requests, c->params)) != 0) {
+            log_error("Failed to allocate buffers.\n");
+            goto out_deallocate_buffer;
+        }
+        allocated++;
+
+        if (role == ROLE_CLIENT)
+            rv = get_remote_mr_info(c->id, c->requests, c->params.count);
+        else
+            rv = send_local_mr_info(c->id, c->requests, c->params.count);
+        if (rv < 0) {
+            log_error("Failed to exchange MR info of class %zu.\n", k);
+            goto out_deallocate_buffer;
+        }
+        rv = 0;
+    }
+
+    for (size_t n = 0; n < params.repeat && role == ROLE_CLIENT; n++) {
+        log_info("Round %zu.\n", n + 1);
+        if ((rv = dccs_class_run(classes, (size_t)class_count)) < 0)
+            log_error("Failed to send and send comp %d request(s).\n", -rv);
+
+        for (size_t k = 0; k < (size_t)class_count; k++) {
+            if (classes[k].params.mode == MODE_LATENCY) {
+                log_info("Class %zu:\n", k);
+                print_latency_report(&classes[k].params, classes[k].requests);
+            }
+        }
+        print_class_report(classes, (size_t)class_count);
+    }
+
+    // Synchronize end of a round on every connection.
+    for (size_t k = 0; k < (size_t)class_count; k++) {
+        char buf[SYNC_END_MESSAGE_LENGTH] = SYNC_END_MESSAGE;
+        if (role == ROLE_CLIENT)
+            rv = send_message(classes[k].id, buf, SYNC_END_MESSAGE_LENGTH);
+        else
+            rv = recv_message(classes[k].id, buf, SYNC_END_MESSAGE_LENGTH);
+        if (rv < 0) {
+            log_error("Failed to exchange terminating message.\n");
+            goto out_deallocate_buffer;
+        }
+        rv = 0;
+    }
+
+out_deallocate_buffer:
+    log_debug("de-allocating buffer\n");
+    for (size_t k = 0; k < allocated; k++)
+        deallocate_buffer(classes[k].requests, classes[k].params);
+    for (size_t k = 0; k < (size_t)class_count; k++)
+        free(classes[k].requests);
+
+    log_debug("Disconnecting\n");
+    for (size_t k = 0; k < connected; k++) {
+        if (role == ROLE_CLIENT)
+            dccs_client_disconnect(classes[k].id);
+        else if (k > 0)
+            dccs_client_disconnect(classes[k].id);
+    }
+    if (role == ROLE_SERVER && connected > 0)
+        dccs_server_disconnect(classes[0].id, listen_id);
+
+    free(classes);
+    return rv;
+}
+
+/**
+ * UD benchmark: the client sends datagrams to its servers in turn. In latency
+ * mode each datagram is echoed back and the round trip is measured; in
+ * throughput mode the servers report what arrived, including losses.
+ */
+int run_ud(struct dccs_parameters params) {
+    struct dccs_ud_context ctx;
+    struct dccs_request *requests = NULL;
+    int rv = 0;
+
+    Role role = params.server == NULL ? ROLE_SERVER : ROLE_CLIENT;
+    if (role == ROLE_CLIENT) {
+        log_info("Running in UD client mode ...\n");
+        rv = dccs_ud_connect(&ctx, params.server, params.port);
+    } else {    // role == ROLE_SERVER
+        log_info("Running in UD server mode ...\n");
+        rv = dccs_ud_listen(&ctx, params.port, params.peers);
+    }
+
+    if (rv != 0)
+        goto out_disconnect;
+
+    if (params.length > ctx.mtu) {
+        log_error("UD messages must fit in the path MTU (%u bytes).\n", ctx.mtu);
+        rv = -1;
+        goto out_disconnect;
+    }
+
+    if ((rv = dccs_ud_setup_ring(&ctx, params.length)) != 0) {
+        log_error("Failed to set up UD receive ring.\n");
+        goto out_disconnect;
+    }
+
+    log_debug("UD handshake with %zu peer(s) ...\n", ctx.peer_count);
+    if (role == ROLE_CLIENT)
+        rv = dccs_ud_handshake_client(&ctx, params.count);
+    else    // role == ROLE_SERVER
+        rv = dccs_ud_handshake_server(&ctx);
+    if (rv != 0) {
+        log_error("UD handshake failed.\n");
+        goto out_disconnect;
+    }
+
+    // The server keeps an arrival slot for every datagram of every peer, as
+    // many as each peer announced in its greeting.
+    struct dccs_parameters server_params = params;
+    server_params.count = role == ROLE_SERVER ? dccs_ud_expected(&ctx) : params.count;
+    requests = calloc(role == ROLE_CLIENT ? params.count : server_params.count, sizeof(struct dccs_request));
+    if (role == ROLE_CLIENT && (rv = allocate_buffer(ctx.qp_id, requests, params)) != 0) {
+        log_error("Failed to allocate buffers.\n");
+        goto out_disconnect;
+    }
+
+    for (size_t n = 0; n < params.repeat; n++) {
+        log_info("Round %zu.\n", n + 1);
+
+        if (role == ROLE_CLIENT) {
+            if ((rv = dccs_ud_send_requests(&ctx, requests, &params)) < 0)
+                log_error("Failed to send and send comp all datagrams.\n");
+
+            switch (params.mode) {
+                case MODE_LATENCY:
+                    print_ud_latency_report(&params, requests);
+                    break;
+                case MODE_THROUGHPUT:
+                    print_throughput_report(&params, requests);
+                    break;
+                case MODE_OPEN_LOOP:    // Rejected for UD by parse_args()
+                    break;
+            }
+        } else {    // role == ROLE_SERVER
+            if ((rv = dccs_ud_serve_requests(&ctx, requests, &params)) < 0) {
+                log_error("Failed to receive datagrams.\n");
+                break;
+            }
+
+            print_delivery_report(&server_params, requests);
+        }
+    }
+
+    if (role == ROLE_CLIENT)
+        deallocate_buffer(requests, params);
+out_disconnect:
+    log_debug("Disconnecting\n");
+    free(requests);
+    dccs_ud_disconnect(&ctx);
+    return rv;
+}
+
 int main(int argc, char *argv[]) {
     struct dccs_parameters params;
 
@@ -165,6 +449,10 @@ int main(int argc, char *argv[]) {
     print_parameters(&params);
     dccs_init();
 
+    if (params.transport == TRANSPORT_UD)
+        return run_ud(params);
+    if (params.classes != NULL)
+        return run_classes(params);
     return run(params);
 }
 
@@ -0,0 +1,262 @@
+// Byte stream benchmark: messages over an RDMA WRITE stream (-v write) or as
+// SENDs into posted receives (the default), in latency or throughput mode
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "dccs_parameters.h"
+#include "dccs_utils.h"
+#include "dccs_rdma.h"
+#include "dccs_stream.h"
+
+#define STREAM_ACK_LENGTH 8
+
+uint64_t clock_rate = 0;    // Clock ticks per second
+
+/*
+ * Workload, the same on either path. Latency: the client sends a message and
+ * the server echoes it, one at a time; a message ends when its echo is in.
+ * Throughput: the client sends count messages back to back, and the last
+ * ends when the server, having received them all, acknowledges.
+ */
+
+struct send_path {
+    struct rdma_cm_id *id;
+    uint8_t *bufs;          // Server: one receive buffer per posted receive
+    struct ibv_mr *mr;
+    size_t depth;           // Receives kept posted by the server
+    size_t window;          // Sends in flight, at most the server's depth
+    size_t outstanding;     // Sends not yet complete
+};
+
+static int send_post_recv(struct send_path *p, size_t k, size_t length) {
+    int rv;
+    if ((rv = rdma_post_recv(p->id, (void *)(uintptr_t)k, p->bufs + k * length, length, p->mr)) != 0)
+        log_perror("rdma_post_recv");
+
+    return rv;
+}
+
+static int send_wait_recv(struct send_path *p, size_t *k) {
+    struct ibv_wc wc;
+
+    if (dccs_rdma_recv_comp(p->id, &wc) < 0)
+        return -1;
+    if (k != NULL)
+        *k = wc.wr_id;
+
+    return 0;
+}
+
+/**
+ * Reap send completions until at most limit sends are outstanding.
+ */
+static int send_retire(struct send_path *p, size_t limit) {
+    struct ibv_wc wc[STREAM_POLL_BATCH];
+
+    while (p->outstanding > limit) {
+        int rv = ibv_poll_cq(p->id->send_cq, STREAM_POLL_BATCH, wc);
+        if (rv < 0) {
+            log_error("ibv_poll_cq() failed, error = %d.\n", rv);
+            return -1;
+        }
+        for (int k = 0; k < rv; k++) {
+            if (wc[k].status != IBV_WC_SUCCESS) {
+                log_error("Failed status %s (%d)\n", ibv_wc_status_str(wc[k].status), wc[k].status);
+                return -1;
+            }
+        }
+        p->outstanding -= (size_t)rv;
+    }
+
+    return 0;
+}
+
+static int send_client(struct send_path *p, struct dccs_parameters *params, struct dccs_request *requests,
+                       void *buf, struct ibv_mr *mr) {
+    for (size_t n = 0; n < params->count; n++) {
+        // The echo, or the final ack, lands in receive buffer 0.
+        if ((params->mode == MODE_LATENCY || n == 0) &&
+                send_post_recv(p, 0, params->mode == MODE_LATENCY ? params->length : STREAM_ACK_LENGTH) != 0)
+            return -1;
+
+        requests[n].start = get_cycles();
+        if (send_retire(p, p->window - 1) != 0 || dccs_rdma_send(p->id, buf, params->length, mr) != 0)
+            return -1;
+        p->outstanding++;
+
+        if (params->mode == MODE_LATENCY) {
+            if (send_wait_recv(p, NULL) != 0)
+                return -1;
+        }
+        requests[n].end = get_cycles();
+    }
+
+    if (send_retire(p, 0) != 0)
+        return -1;
+    if (params->mode != MODE_LATENCY) {
+        if (send_wait_recv(p, NULL) != 0)
+            return -1;
+        requests[params->count - 1].end = get_cycles();
+    }
+
+    return 0;
+}
+
+static int send_server(struct send_path *p, struct dccs_parameters *params, void *buf, struct ibv_mr *mr) {
+    size_t k;
+
+    for (size_t n = 0; n < params->count; n++) {
+        if (send_wait_recv(p, &k) != 0 || send_post_recv(p, k, params->length) != 0)
+            return -1;
+
+        if (params->mode == MODE_LATENCY) {
+            if (send_retire(p, MAX_WR - 1) != 0 || dccs_rdma_send(p->id, buf, params->length, mr) != 0)
+                return -1;
+            p->outstanding++;
+        }
+    }
+
+    if (params->mode != MODE_LATENCY) {
+        if (dccs_rdma_send(p->id, buf, STREAM_ACK_LENGTH, mr) != 0)
+            return -1;
+        p->outstanding++;
+    }
+
+    return send_retire(p, 0);
+}
+
+static int stream_client(struct dccs_stream *s, struct dccs_parameters *params, struct dccs_request *requests,
+                         void *buf, struct ibv_mr *mr) {
+    for (size_t n = 0; n < params->count; n++) {
+        requests[n].start = get_cycles();
+        if (dccs_stream_write_all(s, buf, params->length, mr) != 0)
+            return -1;
+        if (params->mode == MODE_LATENCY && dccs_stream_read_all(s, NULL, params->length) != 0)
+            return -1;
+        requests[n].end = get_cycles();
+    }
+
+    if (params->mode != MODE_LATENCY) {
+        if (dccs_stream_read_all(s, NULL, STREAM_ACK_LENGTH) != 0)
+            return -1;
+        requests[params->count - 1].end = get_cycles();
+    }
+
+    return dccs_stream_flush(s);
+}
+
+static int stream_server(struct dccs_stream *s, struct dccs_parameters *params, void *buf, struct ibv_mr *mr) {
+    for (size_t n = 0; n < params->count; n++) {
+        // Messages are consumed in place, as SENDs land in place.
+        if (dccs_stream_read_all(s, NULL, params->length) != 0)
+            return -1;
+        if (params->mode == MODE_LATENCY && dccs_stream_write_all(s, buf, params->length, mr) != 0)
+            return -1;
+    }
+
+    if (params->mode != MODE_LATENCY && dccs_stream_write_all(s, buf, STREAM_ACK_LENGTH, mr) != 0)
+        return -1;
+
+    return dccs_stream_flush(s);
+}
+
+int run(struct rdma_cm_id *id, struct dccs_parameters *params, bool server) {
+    size_t length = params->length > STREAM_ACK_LENGTH ? params->length : STREAM_ACK_LENGTH;
+    struct dccs_request *requests = NULL;
+    struct send_path p = { .id = id };
+    struct dccs_stream s;
+    struct ibv_mr *mr = NULL;
+    void *buf;
+    int rv = 0;
+
+    memset(&s, 0, sizeof s);
+    buf = malloc_random(length);
+    if ((mr = dccs_reg_msgs(id, buf, length)) == NULL) {
+        rv = -1;
+        goto out;
+    }
+
+    if (params->verb == Write) {
+        if ((rv = dccs_stream_init(&s, id)) != 0)
+            goto out;
+    } else {
+        // The server keeps a window of receives posted; the client needs one.
+        p.window = params->window < MAX_WR ? params->window : MAX_WR;
+        p.depth = server ? p.window : 1;
+        p.bufs = malloc_random(p.depth * length);
+        if ((p.mr = dccs_reg_msgs(id, p.bufs, p.depth * length)) == NULL) {
+            rv = -1;
+            goto out;
+        }
+        for (size_t k = 0; server && k < p.depth; k++) {
+            if ((rv = send_post_recv(&p, k, params->length)) != 0)
+                goto out;
+        }
+    }
+
+    if (!server)
+        requests = calloc(params->count, sizeof(struct dccs_request));
+
+    for (size_t r = 0; r < params->repeat && rv == 0; r++) {
+        if (params->verb == Write)
+            rv = server ? stream_server(&s, params, buf, mr) : stream_client(&s, params, requests, buf, mr);
+        else
+            rv = server ? send_server(&p, params, buf, mr) : send_client(&p, params, requests, buf, mr);
+
+        if (rv != 0)
+            log_error("Round %zu failed.\n", r);
+        else if (!server && params->mode == MODE_LATENCY)
+            print_latency_report(params, requests);
+        else if (!server)
+            print_throughput_report(params, requests);
+    }
+
+out:
+    if (params->verb == Write)
+        dccs_stream_free(&s);
+    if (p.mr != NULL)
+        dccs_dereg_mr(p.mr);
+    if (mr != NULL)
+        dccs_dereg_mr(mr);
+    free(p.bufs);
+    free(buf);
+    free(requests);
+    return rv;
+}
+
+int main(int argc, char *argv[]) {
+    struct rdma_cm_id *listen_id = NULL, *id = NULL;
+    struct dccs_parameters params;
+    bool server;
+    int rv;
+
+    parse_args(argc, argv, &params);
+    print_parameters(&params);
+    dccs_init();
+    if (params.verb != Send && params.verb != Write) {
+        log_error("The stream benchmark compares write (the stream) and send.\n");
+        return EXIT_FAILURE;
+    }
+
+    server = params.server == NULL;
+    if (server)
+        rv = dccs_listen(&listen_id, &id, params.port, 1);
+    else
+        rv = dccs_connect(&id, params.server, params.port, params.tos, 1);
+    if (rv != 0) {
+        log_error("Failed to set up the connection.\n");
+        return EXIT_FAILURE;
+    }
+
+    rv = run(id, &params, server);
+
+    if (server)
+        dccs_server_disconnect(id, listen_id);
+    else
+        dccs_client_disconnect(id);
+
+    return rv == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
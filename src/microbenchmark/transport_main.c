@@ -0,0 +1,232 @@
+// Transport benchmark: one workload over the verbs or MPI transport backend
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "dccs_parameters.h"
+#include "dccs_utils.h"
+#include "dccs_rdma.h"
+#include "dccs_transport.h"
+#include "dccs_transport_daemon.h"
+#include "dccs_transport_mpi.h"
+#include "dccs_transport_verbs.h"
+
+#define TRANSPORT_ACK_WR_ID (UINT64_MAX - 1)
+#define TRANSPORT_ACK_LENGTH 8
+
+uint64_t clock_rate = 0;    // Clock ticks per second
+
+/*
+ * Workload: every client streams count messages to the server in windows
+ * (one message per window in latency mode). The server posts the receives of
+ * a window and then releases it with an ack, which in latency mode is as
+ * long as a message, so that receives always precede their messages on
+ * either backend. A message ends when the ack after its window arrives: a
+ * round trip in latency mode, and flow-controlled streaming otherwise.
+ */
+
+static int client_run(struct dccs_transport *t, struct dccs_parameters *params, struct dccs_request *requests,
+                      void *buf, void *ack, size_t ack_length, size_t window) {
+    struct dccs_completion completions[TRANSPORT_POLL_BATCH];
+    size_t windows = (params->count + window - 1) / window;
+    size_t acks = 0, sent = 0, send_done = 0;
+    int failed_count = 0;
+
+    // The first ack releases the first window.
+    if (t->ops->irecv(t, 0, ack, ack_length, TRANSPORT_ACK_WR_ID) != 0)
+        return -1;
+
+    while (acks < windows + 1 || send_done < sent) {
+        int rv = dccs_transport_wait(t, completions, TRANSPORT_POLL_BATCH);
+        if (rv < 0)
+            return rv;
+
+        uint64_t now = get_cycles();
+        for (int k = 0; k < rv; k++) {
+            struct dccs_completion *c = completions + k;
+            if (!c->ok)
+                failed_count++;
+            if (c->is_send) {
+                send_done++;
+                continue;
+            }
+
+            // Window acks - 1 is through, and window acks may go.
+            if (acks > 0) {
+                for (size_t n = (acks - 1) * window; n < acks * window && n < params->count; n++)
+                    requests[n].end = now;
+            }
+            acks++;
+            if (acks > windows)
+                continue;
+
+            if (t->ops->irecv(t, 0, ack, ack_length, TRANSPORT_ACK_WR_ID) != 0)
+                return -1;
+            for (size_t n = (acks - 1) * window; n < acks * window && n < params->count; n++) {
+                void *msgbuf = (uint8_t *)buf + (n % window) * params->length;
+                requests[n].start = get_cycles();
+                if (t->ops->isend(t, 0, msgbuf, params->length, n) != 0)
+                    return -1;
+                sent++;
+            }
+        }
+    }
+
+    return -failed_count;
+}
+
+static int server_post_window(struct dccs_transport *t, int peer, void *buf, size_t first, size_t window,
+                              size_t count, size_t length) {
+    for (size_t n = first; n < first + window && n < count; n++) {
+        if (t->ops->irecv(t, peer, (uint8_t *)buf + (n % window) * length, length, n) != 0)
+            return -1;
+    }
+
+    return 0;
+}
+
+static int server_run(struct dccs_transport *t, struct dccs_parameters *params, void **bufs, void *ack,
+                      size_t ack_length, size_t window) {
+    struct dccs_completion completions[TRANSPORT_POLL_BATCH];
+    size_t peers = t->peer_count, windows = (params->count + window - 1) / window;
+    size_t *received = calloc(peers, sizeof(size_t));
+    size_t acks_done = 0, bytes = 0;
+    int failed_count = 0, rv = 0;
+
+    for (size_t p = 0; p < peers; p++) {
+        if (server_post_window(t, (int)p, bufs[p], 0, window, params->count, params->length) != 0 ||
+                t->ops->isend(t, (int)p, ack, ack_length, TRANSPORT_ACK_WR_ID) != 0) {
+            rv = -1;
+            goto out;
+        }
+    }
+
+    while (acks_done < peers * (windows + 1)) {
+        if ((rv = dccs_transport_wait(t, completions, TRANSPORT_POLL_BATCH)) < 0)
+            goto out;
+
+        for (int k = 0; k < rv; k++) {
+            struct dccs_completion *c = completions + k;
+            if (!c->ok)
+                failed_count++;
+            if (c->is_send) {
+                acks_done++;
+                continue;
+            }
+
+            size_t n = ++received[c->peer];
+            bytes += c->length;
+            if (n % window != 0 && n != params->count)
+                continue;
+
+            // Window through: post the next one before releasing it.
+            if (server_post_window(t, c->peer, bufs[c->peer], n, window, params->count, params->length) != 0 ||
+                    t->ops->isend(t, c->peer, ack, ack_length, TRANSPORT_ACK_WR_ID) != 0) {
+                rv = -1;
+                goto out;
+            }
+        }
+    }
+
+    log_info("Received %zu bytes from %zu peer(s).\n", bytes, peers);
+    rv = -failed_count;
+
+out:
+    free(received);
+    return rv;
+}
+
+int run(struct dccs_transport *t, struct dccs_parameters *params) {
+    size_t window = params->mode == MODE_LATENCY ? 1 : params->window;
+    size_t ack_length = params->mode == MODE_LATENCY ? params->length : TRANSPORT_ACK_LENGTH;
+    struct dccs_request *requests = NULL;
+    void **bufs = NULL, *ack = NULL;
+    int rv = 0;
+
+    if (t->server) {
+        if ((rv = t->ops->listen(t, params->port)) != 0)
+            return rv;
+        for (size_t p = 0; p < t->expected_peers; p++) {
+            if (t->ops->accept(t) < 0) {
+                log_error("Failed to accept peer %zu.\n", p);
+                return -1;
+            }
+        }
+    } else if (t->ops->connect(t, params->server, params->port) < 0) {
+        return -1;
+    }
+
+    // A window plus its ack must fit in a verbs receive queue, and every
+    // peer's in a daemon channel, leaving buffers for the barrier.
+    if (window > MAX_WR - 1)
+        window = MAX_WR - 1;
+    if (params->backend == BACKEND_DAEMON && window > SHM_SLOTS / 2 / t->peer_count - 1)
+        window = SHM_SLOTS / 2 / t->peer_count - 1;
+    if (window > params->count)
+        window = params->count;
+
+    ack = malloc_random(ack_length);
+    if (t->server) {
+        bufs = calloc(t->peer_count, sizeof(void *));
+        for (size_t p = 0; p < t->peer_count; p++)
+            bufs[p] = malloc_random(window * params->length);
+    } else {
+        bufs = calloc(1, sizeof(void *));
+        bufs[0] = malloc_random(window * params->length);
+        requests = calloc(params->count, sizeof(struct dccs_request));
+    }
+
+    for (size_t r = 0; r < params->repeat && rv == 0; r++) {
+        if ((rv = t->ops->barrier(t)) != 0) {
+            log_error("Barrier failed.\n");
+            break;
+        }
+
+        if (t->server) {
+            rv = server_run(t, params, bufs, ack, ack_length, window);
+        } else {
+            rv = client_run(t, params, requests, bufs[0], ack, ack_length, window);
+            if (rv == 0 && params->mode == MODE_LATENCY)
+                print_latency_report(params, requests);
+            else if (rv == 0)
+                print_throughput_report(params, requests);
+        }
+        if (rv != 0)
+            log_error("Round %zu failed over %s.\n", r, t->ops->name);
+    }
+
+    for (size_t p = 0; p < (t->server ? t->peer_count : 1); p++)
+        free(bufs[p]);
+    free(bufs);
+    free(ack);
+    free(requests);
+    return rv;
+}
+
+int main(int argc, char *argv[]) {
+    struct dccs_parameters params;
+    struct dccs_transport t;
+    int rv;
+
+    parse_args(argc, argv, &params);
+    print_parameters(&params);
+    dccs_init();
+
+    memset(&t, 0, sizeof t);
+    if (params.backend == BACKEND_MPI)
+        t.ops = &mpi_transport_ops;
+    else if (params.backend == BACKEND_DAEMON)
+        t.ops = &daemon_transport_ops;
+    else
+        t.ops = &verbs_transport_ops;
+    t.params = &params;
+    if ((rv = t.ops->init(&t, &argc, &argv)) == 0)
+        rv = run(&t, &params);
+
+    if (t.state != NULL)
+        t.ops->disconnect(&t);
+
+    return rv == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}